@@ -0,0 +1,603 @@
+/////////////////////////////////////////////////////////////////////
+// Benchmark.cpp - Loopback throughput and latency of Channel      //
+// ver 1.0                                                         //
+// Language:      Visual C++, 2011                                 //
+// Platform:      Studio 1558, Windows 7 Pro SP1                   //
+// Application:   CIS 687 / Project 3, Sp13                        //
+/////////////////////////////////////////////////////////////////////
+/*
+
+Module Operations:
+==================
+Benchmark sends messages between Channels over loopback and reports
+throughput and latency, one result per setting of a sweep over message
+size, block size, number of concurrently sending channels, ACK on/off and
+transport: TCP loopback with blocking socket calls, the shared memory rings
+same-host channels use, or TCP loopback with overlapped I/O through IoEngine
+("iocp").  A long --senders list, e.g. 1,16,64, compares the transports at
+high connection counts.  --options sweeps the TCP socket options profile
+every channel in a run uses, e.g. default,latency,bulk: the system
+defaults, "latency" (no Nagle delay, immediate ACKs) or "bulk" (4 MB
+socket buffers); small sizes with ACK on show the first, large sizes the
+second.
+
+Every run uses fresh channels on two fresh ports.  The sending channels
+share one receiving channel, whose ACKs, when enabled, go to a reply
+channel.  Each message carries the performance counter value of its send()
+call in its first bytes, and its latency is the time until the receiving
+listen callback sees it.  A run ends when every message has arrived and,
+with ACK on, every ACK has come back; throughput is counted over that time.
+
+The receiving end reports its latencies to the reply channel when the run
+is over.  With --process it runs in a child process started for each run,
+otherwise in a thread.  The performance counter is system wide, so send
+stamps compare across processes.
+
+Messages are held in memory whole, and copied for each send.  Sizes above
+--max-size, or above what size_t holds on Win32, are reported as skipped.
+
+Usage:
+======
+Benchmark [--sizes 64,1K,16K,256K,4M,64M,1G,4G] [--blocks 1K,64K]
+          [--senders 1,4] [--ack on,off] [--transport tcp,shm,iocp]
+          [--options default]
+          [--bytes 64M] [--count 10000]
+          [--max-size 256M] [--process] [--format csv|json] [--out file]
+          [--port 9300] [--timeout 120]
+
+A run sends --bytes / size messages, at most --count and at least one.
+Sizes take K, M and G suffixes, powers of 1024.  Results go to stdout, or
+to --out, as CSV or JSON with the fields:
+
+mode, transport, options, size, block, senders, ack, messages, seconds, msgs_per_sec,
+mb_per_sec (10^6 bytes), p50_us, p99_us, p999_us, status
+
+status is "ok", "skipped", "timeout" or a failure reason.
+
+Build Process:
+==============
+Required Files:
+Channel.h, Message.h, HttpWrapper.h, ObjectStore.h, Sockets.h, Sockets.cpp,
+Locks.h, Locks.cpp, Threads.h, Threads.cpp, BlockingQueue.h, BlockingQueue.cpp,
+HiResTimer.h, CRC32C.h, CRC32C.cpp, LZ4.h, LZ4.cpp, SHA256.h, SHA256.cpp,
+Delta.h, Delta.cpp, Metrics.h, Metrics.cpp, Trace.h, Trace.cpp,
+SharedMemory.h, SharedMemory.cpp, IoEngine.h, IoEngine.cpp, RateLimit.h,
+RateLimit.cpp
+
+Maintenance History:
+====================
+- Oct 19, 2026 : initial version
+- Oct 19, 2026 : transport sweep, TCP or shared memory
+- Oct 19, 2026 : iocp transport, TCP through IoEngine
+- Oct 19, 2026 : socket options profile sweep
+
+*/
+
+#include "../Comm/Channel.h"
+#include "../HiResTimer/HiResTimer.h"
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+
+typedef HRTimer::HiResTimer Timer;
+
+/////////////////////////////////////////////////////////////////////
+// Settings struct
+// what to sweep and how, from the command line
+struct Settings {
+	std::vector<unsigned long long> sizes;	// message sizes, bytes
+	std::vector<unsigned long long> blocks;	// block sizes, bytes
+	std::vector<size_t> senders;	// concurrently sending channels
+	std::vector<bool> acks;	// ACK settings
+	std::vector<std::string> transports;	// "tcp", "shm" or "iocp"
+	std::vector<std::string> profiles;	// socket options, "default", "latency" or "bulk"
+	unsigned long long bytes;	// bytes sent per run
+	size_t count;	// most messages sent per run
+	unsigned long long maxSize;	// larger messages are skipped
+	bool process;	// receive in a child process
+	bool json;	// JSON instead of CSV
+	std::string out;	// result file, empty for stdout
+	size_t port;	// first port, each run takes two
+	DWORD timeout;	// milliseconds a run may take
+
+	Settings() : bytes(64ull << 20), count(10000), maxSize(256ull << 20), process(false), json(false), port(9300), timeout(120000) {}
+};
+
+/////////////////////////////////////////////////////////////////////
+// Result struct
+// one row of output
+struct Result {
+	unsigned long long size;
+	unsigned long long block;
+	size_t senders;
+	bool ack;
+	std::string transport;
+	std::string options;	// socket options profile
+	size_t messages;
+	double seconds;
+	double p50, p99, p999;	// microseconds
+	std::string status;
+
+	Result() : size(0), block(0), senders(0), ack(false), messages(0), seconds(0), p50(0), p99(0), p999(0) {}
+};
+
+/////////////////////////////////////////////////////////////////////
+// Recorder class
+// listen callback of the receiving channel, keeps each message's latency
+class Recorder {
+	size_t expected;	// messages in this run
+	std::vector<__int64> latencies;	// counter ticks from send() to callback
+	__int64 last;	// counter value when the last message arrived
+	HANDLE done;	// set when every message has arrived
+public:
+	Recorder(size_t _expected) : expected(_expected), last(0), done(::CreateEventA(NULL, TRUE, FALSE, NULL)) {
+		latencies.reserve(expected);
+	}
+	~Recorder() {
+		::CloseHandle(done);
+	}
+	void operator()(Message& msg) {
+		__int64 now = Timer::Now();
+		__int64 sent;
+		if (msg.size() == 0 || msg.begin()->size() < sizeof(sent)) return;
+		::memcpy(&sent, msg.begin()->data(), sizeof(sent));
+		latencies.push_back(now - sent);
+		last = now;
+		if (latencies.size() == expected) ::SetEvent(done);
+	}
+	///////////////////////////////////////////////////
+	// wait for every message, false on timeout
+	bool wait(DWORD milliseconds) {
+		return ::WaitForSingleObject(done, milliseconds) == WAIT_OBJECT_0;
+	}
+	///////////////////////////////////////////////////
+	// last arrival time followed by the latencies, in counter ticks
+	std::vector<__int64> report() {
+		std::vector<__int64> r(1, last);
+		r.insert(r.end(), latencies.begin(), latencies.end());
+		return r;
+	}
+};
+
+/////////////////////////////////////////////////////////////////////
+// Replies class
+// listen callback of the reply channel, collects the ACKs, and the
+// receiving end's ready notice and latency report
+class Replies {
+	size_t expectedAcks;
+	size_t acks;
+	__int64 lastAck;	// counter value when the last ACK arrived
+	std::vector<__int64> report;	// as made by Recorder::report()
+	HANDLE ready, acked, reported;
+public:
+	Replies(size_t _expectedAcks) : expectedAcks(_expectedAcks), acks(0), lastAck(0),
+		ready(::CreateEventA(NULL, TRUE, FALSE, NULL)),
+		acked(::CreateEventA(NULL, TRUE, _expectedAcks == 0, NULL)),
+		reported(::CreateEventA(NULL, TRUE, FALSE, NULL)) {}
+	~Replies() {
+		::CloseHandle(ready);
+		::CloseHandle(acked);
+		::CloseHandle(reported);
+	}
+	void operator()(Message& msg) {
+		if (msg.isACK()) {
+			lastAck = Timer::Now();
+			if (++acks == expectedAcks) ::SetEvent(acked);
+			return;
+		}
+		if (!msg.isBinary()) {
+			::SetEvent(ready);
+			return;
+		}
+		std::ostringstream os;
+		msg.to(os);
+		std::string body = os.str();
+		report.resize(body.size() / sizeof(__int64));
+		if (!report.empty())
+			::memcpy(&report[0], body.data(), report.size() * sizeof(__int64));
+		::SetEvent(reported);
+	}
+	bool waitReady(DWORD milliseconds) {
+		return ::WaitForSingleObject(ready, milliseconds) == WAIT_OBJECT_0;
+	}
+	///////////////////////////////////////////////////
+	// wait for the latency report and every ACK, false on timeout
+	bool waitDone(DWORD milliseconds) {
+		return ::WaitForSingleObject(reported, milliseconds) == WAIT_OBJECT_0
+			&& ::WaitForSingleObject(acked, milliseconds) == WAIT_OBJECT_0;
+	}
+	__int64 lastArrival() {
+		return report.empty() ? 0 : report[0];
+	}
+	__int64 lastACK() {
+		return lastAck;
+	}
+	std::vector<__int64> latencies() {
+		return report.empty() ? report : std::vector<__int64>(report.begin() + 1, report.end());
+	}
+};
+
+///////////////////////////////////////////////////
+// runs a channel's listen loop
+template <typename CallBackF>
+class ListenHelperThread : public threadBase {
+	Channel& ch;
+	CallBackF& f;
+	size_t port;
+	void run() {
+		ch.listen<CallBackF>(port, f);
+	}
+public:
+	ListenHelperThread(Channel& _ch, CallBackF& _f, size_t _port) : ch(_ch), f(_f), port(_port) {}
+};
+
+//----< socket options profile by name >---------------------------
+SocketOptions profile(const std::string& name) {
+	if (name == "latency") return SocketOptions::latency();
+	if (name == "bulk") return SocketOptions::bulk();
+	return SocketOptions();
+}
+
+//----< receiving end of a run, in a thread or a child process >----
+bool receive(size_t rxPort, size_t replyPort, bool ack, const std::string& transport, const std::string& options, size_t messages, DWORD timeout) {
+	Channel rx("RX", Peer(rxPort, "127.0.0.1", replyPort));
+	rx.enableLog() = false;
+	rx.enableACK() = ack;
+	rx.enableSharedMemory() = transport == "shm";
+	rx.socketOptions() = profile(options);
+	Recorder recorder(messages);
+	ListenHelperThread<Recorder> listener(rx, recorder, rxPort);
+	listener.start();
+	::Sleep(100);	// let the listener bind
+	Message ready;
+	ready.fromString("ready");
+	rx.send(std::move(ready));
+	bool complete = recorder.wait(timeout);
+	if (complete) {
+		std::vector<__int64> r = recorder.report();
+		Message report("latencies");
+		report.push(DataBlock(reinterpret_cast<const char*>(&r[0]), r.size() * sizeof(__int64)));
+		rx.send(std::move(report));
+	}
+	rx.close();
+	listener.join();
+	return complete;
+}
+
+///////////////////////////////////////////////////
+// receiving end of an in-process run
+class ReceiverHelperThread : public threadBase {
+	size_t rxPort, replyPort;
+	bool ack;
+	std::string transport, options;
+	size_t messages;
+	DWORD timeout;
+	void run() {
+		receive(rxPort, replyPort, ack, transport, options, messages, timeout);
+	}
+public:
+	ReceiverHelperThread(size_t _rxPort, size_t _replyPort, bool _ack, const std::string& _transport, const std::string& _options, size_t _messages, DWORD _timeout) :
+		rxPort(_rxPort), replyPort(_replyPort), ack(_ack), transport(_transport), options(_options), messages(_messages), timeout(_timeout) {}
+};
+
+///////////////////////////////////////////////////
+// sends copies of a message, each stamped with its send time
+class SenderHelperThread : public threadBase {
+	Channel& ch;
+	const Message& msg;
+	std::string prefix;	// file names must differ while under reassembly
+	size_t count;
+	void run() {
+		for (size_t i = 0; i < count; i++) {
+			Message m(msg);
+			std::ostringstream os;
+			os << prefix << i;
+			m.fileName() = os.str();
+			__int64 now = Timer::Now();
+			::memcpy(m.begin()->data(), &now, sizeof(now));
+			ch.send(std::move(m));
+		}
+	}
+public:
+	SenderHelperThread(Channel& _ch, const Message& _msg, const std::string& _prefix, size_t _count) :
+		ch(_ch), msg(_msg), prefix(_prefix), count(_count) {}
+};
+
+//----< start the receiving end of a run in a child process >------
+bool spawn(PROCESS_INFORMATION& child, size_t rxPort, size_t replyPort, bool ack, const std::string& transport, const std::string& options, size_t messages, DWORD timeout) {
+	char path[MAX_PATH];
+	if (::GetModuleFileNameA(NULL, path, MAX_PATH) == 0) return false;
+	std::ostringstream os;
+	os << "\"" << path << "\" --child " << rxPort << " " << replyPort << " " << (ack ? 1 : 0) << " " << transport << " " << options << " " << messages << " " << timeout;
+	std::string line = os.str();
+	std::vector<char> cmd(line.begin(), line.end());
+	cmd.push_back('\0');	// CreateProcess may write to the command line
+	STARTUPINFOA si;
+	::memset(&si, 0, sizeof(si));
+	si.cb = sizeof(si);
+	return ::CreateProcessA(NULL, &cmd[0], NULL, NULL, FALSE, 0, NULL, NULL, &si, &child) != 0;
+}
+
+//----< latency at quantile q of sorted ticks, in microseconds >---
+double percentile(const std::vector<__int64>& sorted, double q) {
+	if (sorted.empty()) return 0;
+	size_t rank = (size_t)(q * sorted.size() + 0.999999);
+	if (rank > 0) rank--;
+	if (rank >= sorted.size()) rank = sorted.size() - 1;
+	return Timer::ToNanoseconds(sorted[rank]) / 1000.0;
+}
+
+//----< one run of the sweep >--------------------------------------
+void run(const Settings& s, size_t index, Result& r) {
+	if (r.size > s.maxSize || r.size > (size_t)-1 || r.block > (size_t)-1) {
+		r.status = "skipped";
+		return;
+	}
+	unsigned long long fit = s.bytes / r.size;
+	r.messages = fit < 1 ? 1 : fit > s.count ? s.count : (size_t)fit;
+	size_t rxPort = s.port + 2 * index;
+	size_t replyPort = rxPort + 1;
+
+	// the message every send copies
+	Message msg("bench");
+	msg.blockSize() = (size_t)r.block;
+	for (size_t done = 0; done < (size_t)r.size; ) {
+		size_t n = (size_t)r.size - done < (size_t)r.block ? (size_t)r.size - done : (size_t)r.block;
+		DataBlock block(n);
+		::memset(block.data(), 'b', n);
+		msg.push(std::move(block));
+		done += n;
+	}
+
+	bool iocp = r.transport == "iocp";
+	if (iocp && !IoEngine::start(2)) {
+		r.status = "could not start IoEngine";
+		return;
+	}
+	Replies replies(r.ack ? r.messages : 0);
+	Channel reply("REPLY", Peer(replyPort, "127.0.0.1", 0));
+	reply.enableLog() = false;
+	reply.enableACK() = false;
+	reply.enableSharedMemory() = r.transport == "shm";
+	reply.socketOptions() = profile(r.options);
+	ListenHelperThread<Replies> replyListener(reply, replies, replyPort);
+	replyListener.start();
+	::Sleep(100);	// let the listener bind
+
+	ReceiverHelperThread* local = 0;
+	PROCESS_INFORMATION child;
+	::memset(&child, 0, sizeof(child));
+	if (s.process) {
+		if (!spawn(child, rxPort, replyPort, r.ack, r.transport, r.options, r.messages, s.timeout))
+			r.status = "could not start receiver process";
+	}
+	else {
+		local = new ReceiverHelperThread(rxPort, replyPort, r.ack, r.transport, r.options, r.messages, s.timeout);
+		local->start();
+	}
+
+	if (r.status.empty() && !replies.waitReady(s.timeout))
+		r.status = "receiver not ready";
+	if (r.status.empty()) {
+		std::vector<Channel*> channels;
+		std::vector<SenderHelperThread*> threads;
+		__int64 start = Timer::Now();
+		for (size_t i = 0; i < r.senders; i++) {
+			std::ostringstream os;
+			os << "TX" << i;
+			Channel* ch = new Channel(os.str(), Peer("127.0.0.1", rxPort));
+			ch->enableLog() = false;
+			ch->enableSharedMemory() = r.transport == "shm";
+			ch->socketOptions() = profile(r.options);
+			os << "-";
+			size_t count = r.messages / r.senders + (i < r.messages % r.senders ? 1 : 0);
+			SenderHelperThread* th = new SenderHelperThread(*ch, msg, os.str(), count);
+			th->start();
+			channels.push_back(ch);
+			threads.push_back(th);
+		}
+		if (replies.waitDone(s.timeout)) {
+			__int64 end = r.ack ? replies.lastACK() : replies.lastArrival();
+			r.seconds = Timer::ToNanoseconds(end - start) / 1e9;
+			std::vector<__int64> latencies = replies.latencies();
+			std::sort(latencies.begin(), latencies.end());
+			r.p50 = percentile(latencies, 0.5);
+			r.p99 = percentile(latencies, 0.99);
+			r.p999 = percentile(latencies, 0.999);
+			r.status = "ok";
+		}
+		else
+			r.status = "timeout";
+		for (size_t i = 0; i < threads.size(); i++) {
+			threads[i]->join();
+			channels[i]->close();
+			delete threads[i];
+			delete channels[i];
+		}
+	}
+
+	if (local) {
+		local->join();
+		delete local;
+	}
+	if (child.hProcess) {
+		if (::WaitForSingleObject(child.hProcess, s.timeout) != WAIT_OBJECT_0)
+			::TerminateProcess(child.hProcess, 1);
+		::CloseHandle(child.hProcess);
+		::CloseHandle(child.hThread);
+	}
+	reply.close();
+	replyListener.join();
+	if (iocp)
+		IoEngine::stop();
+}
+
+//----< "64K" to 65536 >--------------------------------------------
+unsigned long long parseSize(const std::string& text) {
+	std::istringstream is(text);
+	unsigned long long n = 0;
+	char unit = 0;
+	if (!(is >> n) || n == 0) throw std::exception("Bad size");
+	if (is >> unit) {
+		switch (unit) {
+		case 'k': case 'K': n <<= 10; break;
+		case 'm': case 'M': n <<= 20; break;
+		case 'g': case 'G': n <<= 30; break;
+		default: throw std::exception("Bad size unit");
+		}
+	}
+	return n;
+}
+
+//----< comma separated list >--------------------------------------
+std::vector<std::string> split(const std::string& text) {
+	std::vector<std::string> items;
+	std::istringstream is(text);
+	std::string item;
+	while (std::getline(is, item, ','))
+		if (!item.empty()) items.push_back(item);
+	return items;
+}
+
+//----< settings from the command line >----------------------------
+Settings parse(int argc, char* argv[]) {
+	Settings s;
+	std::string sizes("64,1K,16K,256K,4M,64M,1G,4G"), blocks("1K,64K"), senders("1,4"), acks("on,off"), transports("tcp,shm,iocp"), profiles("default");
+	for (int i = 1; i < argc; i++) {
+		std::string arg(argv[i]);
+		std::string value(i + 1 < argc ? argv[i + 1] : "");
+		if (arg == "--process") { s.process = true; continue; }
+		if (value.empty()) throw std::exception("Missing option value");
+		i++;
+		if (arg == "--sizes") sizes = value;
+		else if (arg == "--blocks") blocks = value;
+		else if (arg == "--senders") senders = value;
+		else if (arg == "--ack") acks = value;
+		else if (arg == "--transport") transports = value;
+		else if (arg == "--options") profiles = value;
+		else if (arg == "--bytes") s.bytes = parseSize(value);
+		else if (arg == "--count") s.count = (size_t)parseSize(value);
+		else if (arg == "--max-size") s.maxSize = parseSize(value);
+		else if (arg == "--format") s.json = (value == "json");
+		else if (arg == "--out") s.out = value;
+		else if (arg == "--port") s.port = (size_t)parseSize(value);
+		else if (arg == "--timeout") s.timeout = (DWORD)parseSize(value) * 1000;
+		else throw std::exception("Unknown option");
+	}
+	std::vector<std::string> items = split(sizes);
+	for (size_t i = 0; i < items.size(); i++) {
+		s.sizes.push_back(parseSize(items[i]));
+		if (s.sizes.back() < sizeof(__int64)) throw std::exception("Messages must hold a send stamp");
+	}
+	items = split(blocks);
+	for (size_t i = 0; i < items.size(); i++)
+		s.blocks.push_back(parseSize(items[i]));
+	items = split(senders);
+	for (size_t i = 0; i < items.size(); i++)
+		s.senders.push_back((size_t)parseSize(items[i]));
+	items = split(acks);
+	for (size_t i = 0; i < items.size(); i++)
+		s.acks.push_back(items[i] == "on");
+	items = split(transports);
+	for (size_t i = 0; i < items.size(); i++) {
+		if (items[i] != "tcp" && items[i] != "shm" && items[i] != "iocp") throw std::exception("Unknown transport");
+		s.transports.push_back(items[i]);
+	}
+	items = split(profiles);
+	for (size_t i = 0; i < items.size(); i++) {
+		if (items[i] != "default" && items[i] != "latency" && items[i] != "bulk") throw std::exception("Unknown socket options");
+		s.profiles.push_back(items[i]);
+	}
+	return s;
+}
+
+//----< one result as a CSV line or JSON object >-------------------
+void write(std::ostream& out, const Settings& s, const Result& r, bool first) {
+	double mps = r.seconds > 0 ? r.messages / r.seconds : 0;
+	double mbps = r.seconds > 0 ? r.messages * (double)r.size / r.seconds / 1e6 : 0;
+	const char* mode = s.process ? "process" : "in-process";
+	const std::string& transport = r.transport;
+	std::string status(r.status);
+	std::replace(status.begin(), status.end(), '"', '\'');
+	std::replace(status.begin(), status.end(), ',', ';');
+	out << std::fixed;
+	if (s.json) {
+		out << (first ? "[\n" : ",\n")
+			<< "  {\"mode\": \"" << mode << "\", \"transport\": \"" << transport << "\", \"options\": \"" << r.options << "\", \"size\": " << r.size << ", \"block\": " << r.block
+			<< ", \"senders\": " << r.senders << ", \"ack\": " << (r.ack ? "true" : "false")
+			<< ", \"messages\": " << r.messages << ", \"seconds\": " << std::setprecision(6) << r.seconds
+			<< ", \"msgs_per_sec\": " << std::setprecision(1) << mps << ", \"mb_per_sec\": " << mbps
+			<< ", \"p50_us\": " << r.p50 << ", \"p99_us\": " << r.p99 << ", \"p999_us\": " << r.p999
+			<< ", \"status\": \"" << status << "\"}";
+	}
+	else {
+		if (first)
+			out << "mode,transport,options,size,block,senders,ack,messages,seconds,msgs_per_sec,mb_per_sec,p50_us,p99_us,p999_us,status\n";
+		out << mode << "," << transport << "," << r.options << "," << r.size << "," << r.block << "," << r.senders << "," << (r.ack ? "on" : "off")
+			<< "," << r.messages << "," << std::setprecision(6) << r.seconds
+			<< "," << std::setprecision(1) << mps << "," << mbps
+			<< "," << r.p50 << "," << r.p99 << "," << r.p999 << "," << status << "\n";
+	}
+	out.flush();
+}
+
+//----< program entry >--------------------------------------------
+int main(int argc, char* argv[]) {
+	try {
+		if (argc == 9 && std::string(argv[1]) == "--child")	// receiving end started by spawn()
+		{
+			std::string transport(argv[5]);
+			if (transport == "iocp" && !IoEngine::start(2)) return 1;
+			bool complete = receive(atoi(argv[2]), atoi(argv[3]), atoi(argv[4]) != 0, transport, argv[6], atoi(argv[7]), (DWORD)atol(argv[8]));
+			IoEngine::stop();
+			return complete ? 0 : 1;
+		}
+
+		Settings s = parse(argc, argv);
+		std::ofstream file;
+		if (!s.out.empty()) {
+			file.open(s.out.c_str());
+			if (!file.good()) throw std::exception("Cannot open result file");
+		}
+		std::ostream& out = s.out.empty() ? std::cout : file;
+		size_t index = 0;
+		size_t total = s.sizes.size() * s.blocks.size() * s.senders.size() * s.acks.size() * s.transports.size() * s.profiles.size();
+		for (size_t a = 0; a < s.sizes.size(); a++)
+			for (size_t b = 0; b < s.blocks.size(); b++)
+				for (size_t c = 0; c < s.senders.size(); c++)
+					for (size_t d = 0; d < s.acks.size(); d++)
+						for (size_t e = 0; e < s.transports.size(); e++)
+							for (size_t g = 0; g < s.profiles.size(); g++) {
+								Result r;
+								r.size = s.sizes[a];
+								r.block = s.blocks[b];
+								r.senders = s.senders[c];
+								r.ack = s.acks[d];
+								r.transport = s.transports[e];
+								r.options = s.profiles[g];
+								std::cerr << "\r  run " << index + 1 << " of " << total << "   ";
+								try {
+									run(s, index, r);
+								}
+								catch (std::exception& ex) {
+									r.status = ex.what();
+								}
+								write(out, s, r, index == 0);
+								index++;
+							}
+		if (s.json && index > 0)
+			out << "\n]\n";
+		std::cerr << "\n";
+	}
+	catch (std::exception& ex) {
+		std::cerr << "\n  Benchmark failed: " << ex.what() << "\n";
+		return 1;
+	}
+	return 0;
+}
@@ -11,7 +11,7 @@
 #ifdef TEST_BLOCKINGQUEUE
 
 #include "BlockingQueue.h"
-#include "../NewThreadsAndLocks/Threads.h"
+#include "../Threads/Threads.h"
 #include <string>
 #include <iostream>
 #include <sstream>
@@ -77,8 +77,66 @@ int main()
   }
   q.enQ("quit");
   td.join();
+
+  std::cout << "\n\n  Demonstrating bounded queue, high 3, low 1";
+  std::cout << "\n --------------------------------------------";
+  BlockingQueue<std::string> bq(3, 1);
+  for(size_t i=0; i<4; ++i)
+    std::cout << "\n  tryEnQ #" << i << (bq.tryEnQ("bounded") ? " accepted" : " refused, queue full");
+  bq.deQ();
+  std::cout << "\n  after one deQ, tryEnQ " << (bq.tryEnQ("bounded") ? "accepted" : "refused, not drained to low watermark");
+  bq.deQ();
+  std::cout << "\n  after two deQs, tryEnQ " << (bq.tryEnQ("bounded") ? "accepted" : "refused");
+  bq.enQ("bounded");  // back at high watermark
+  std::cout << "\n  enQFor on full queue timed out: " << std::boolalpha << !bq.enQFor("bounded", 100);
   std::cout << "\n  parent exiting\n\n";
 }
 
 
+#endif
+
+#ifdef BENCH_BLOCKINGQUEUE
+
+#include "BlockingQueue.h"
+#include "../MicroBench/MicroBench.h"
+#include "../Comm/Message.h"
+#include <string>
+#include <iostream>
+
+//----< benchmark: uncontended enQ and deQ >-------------------
+/*
+ * One thread enQs an item and deQs it again, so the lock is never
+ * contended: what is left is locking, the deque node and moving
+ * the item in and out.
+ *
+ *   cl /EHa /O2 /DBENCH_BLOCKINGQUEUE BlockingQueue.cpp ../MicroBench/MicroBench.cpp ../Threads/Locks.cpp
+ */
+int main()
+{
+  const size_t N = 200000;
+  MicroBench::title("BlockingQueue, enQ then deQ on one thread");
+
+  BlockingQueue<std::string> sq;
+  std::string text(100, 'q');
+  MicroBench::report("std::string, copied in", MicroBench::measure(N, [&]() {
+    sq.enQ(text);
+    MicroBench::keep(sq.deQ().size());
+  }));
+  MicroBench::report("std::string, moved in", MicroBench::measure(N, [&]() {
+    sq.enQ(std::move(text));
+    text = sq.deQ();
+    MicroBench::keep(text.size());
+  }));
+
+  BlockingQueue<Message> mq;
+  Message msg;
+  msg.fromString(std::string(4 * BLOCK_SIZE, 'q'));
+  MicroBench::report("4 KB Message, moved in", MicroBench::measure(N, [&]() {
+    mq.enQ(std::move(msg));
+    msg = mq.deQ();
+    MicroBench::keep(msg.length());
+  }));
+  std::cout << "\n\n";
+}
+
 #endif
@@ -2,7 +2,7 @@
 #define BLOCKINGQUEUE_H
 ///////////////////////////////////////////////////////////////////
 // BlockingQueue.h - Thread-safe queue that blocks on empty deQ  //
-// ver 1.1                                                       //
+// ver 1.4                                                       //
 // Language: standard C++                                        //
 // Platform: Dell Dimension T7400, Windows 7, SP #1              //
 // Application: Resource for DO projects                         //
@@ -19,6 +19,22 @@
  *
  * Users don't need to be aware of how this works.  They just use
  * the queue without worrying about locking.
+ *
+ * A queue may be bounded by a high and low watermark.  When it fills
+ * to the high watermark enQ'ers block, or fail for tryEnQ and enQFor,
+ * until deQ'ers have drained it down to the low watermark.  A high
+ * watermark of zero, the default, leaves the queue unbounded.
+ *
+ * Besides the blocking deQ, messages can be taken without waiting,
+ * with a timeout, or in batches of up to N under one lock acquisition.
+ * Messages are moved, not copied, into and out of the queue: enQ
+ * takes its argument by value, so passing an rvalue or std::move'd
+ * message costs only moves, and emplace builds the message in place
+ * from one or two constructor arguments.
+ *
+ * close() wakes every waiter.  A closed queue refuses new messages but
+ * hands out the ones it still holds; after that deQ throws and the
+ * other deQ'ers return false or zero, so consumer loops can end.
  */
 /*
  * Public Interface:
@@ -26,6 +42,18 @@
  * BlockingQueue<int> b;
  * int i = b.deQ();	// de-queue from blocking queue
  * b.enQ(2);	// en-queue to blocking queue
+ * b.emplace(3);	// construct message in place at end of queue
+ * BlockingQueue<std::pair<int,std::string>> p;
+ * p.emplace(1, "one");	// from two constructor arguments
+ * b.setLimits(100, 50);	// block enQ at 100 items until drained to 50
+ * bool ok = b.tryEnQ(3);	// en-queue only if there is room now
+ * ok = b.enQFor(4, 250);	// wait up to 250 millisecs for room
+ * ok = b.tryDeQ(i);	// de-queue only if a message is waiting
+ * ok = b.deQFor(i, 250);	// wait up to 250 millisecs for a message
+ * std::vector<int> v;
+ * size_t n = b.deQBatch(v, 16);	// wait, then take up to 16 messages
+ * b.close();	// wake all waiters, refuse further enQs
+ * bool c = b.isClosed();
  *
  * Required Files:
  * ---------------
@@ -37,6 +65,13 @@
  *
  * Maintenance History:
  * --------------------
+ * ver 1.4 : 19 Oct 2026
+ * - messages are moved into and out of the queue, added emplace of
+ *   one or two arguments
+ * ver 1.3 : 19 Oct 2026
+ * - added tryDeQ, deQFor, deQBatch, close and isClosed
+ * ver 1.2 : 19 Oct 2026
+ * - added high/low watermarks, tryEnQ and enQFor
  * ver 1.1 : 24 Mar 13
  * - small revisions for new threadBase
  * ver 1.0 : 19 Feb 12
@@ -44,6 +79,8 @@
  */
 
 #include <queue>
+#include <vector>
+#include <utility>
 #include <Windows.h>
 #include "../Threads/locks.h"
 
@@ -54,58 +91,245 @@ template <typename Msg>
 class BlockingQueue
 {
 public:
-  BlockingQueue();
+  BlockingQueue(size_t highWater=0, size_t lowWater=0);
   void enQ(Msg msg);
+  bool tryEnQ(Msg msg);
+  bool enQFor(Msg msg, DWORD milliseconds);
+  template <typename A1>
+  void emplace(A1&& a1);
+  template <typename A1, typename A2>
+  void emplace(A1&& a1, A2&& a2);
   Msg deQ();
+  bool tryDeQ(Msg& msg);
+  bool deQFor(Msg& msg, DWORD milliseconds);
+  size_t deQBatch(std::vector<Msg>& out, size_t max);
   size_t size();
+  void setLimits(size_t highWater, size_t lowWater);
+  void close();
+  bool isClosed();
 private:
+  bool waitForRoom(DWORD milliseconds);
+  bool waitForMsg(DWORD milliseconds);
+  void pushed();
+  Msg take();
   std::queue<Msg> _Q;
   CSLock qLock;
   CSConditionVariable qCv;
+  CSConditionVariable roomCv;  // signalled when drained to low watermark
+  size_t _highWater;
+  size_t _lowWater;
+  bool _full;                  // reached high watermark, not yet drained
+  bool _closed;
 };
 //----< Ctor >-------------------------------------------------
 
 template <typename Msg>
-BlockingQueue<Msg>::BlockingQueue()
+BlockingQueue<Msg>::BlockingQueue(size_t highWater, size_t lowWater)
+  : qLock("BlockingQueue"), _highWater(0), _lowWater(0), _full(false), _closed(false)
 {
   qCv.wakeAll();  // clear lock - probably not necessary
+  setLimits(highWater, lowWater);
+}
+//----< set watermarks, highWater of zero means unbounded >----
+
+template <typename Msg>
+void BlockingQueue<Msg>::setLimits(size_t highWater, size_t lowWater)
+{
+  qLock.lock();
+  _highWater = highWater;
+  _lowWater = (lowWater < highWater) ? lowWater : (highWater > 0 ? highWater-1 : 0);
+  _full = (_highWater > 0 && _Q.size() >= _highWater);
+  qLock.unlock();
+  roomCv.wakeAll();
+}
+//----< wait, holding lock, until queue accepts messages >-----
+/*
+ * returns false on timeout or if the queue has been closed
+ */
+template <typename Msg>
+bool BlockingQueue<Msg>::waitForRoom(DWORD milliseconds)
+{
+  DWORD start = ::GetTickCount();
+  while(_full && !_closed)
+  {
+    DWORD waited = ::GetTickCount() - start;
+    if(milliseconds != INFINITE && waited >= milliseconds)
+      return false;
+    roomCv.sleep(qLock, milliseconds == INFINITE ? INFINITE : milliseconds - waited);
+  }
+  return !_closed;
+}
+//----< wait, holding lock, until a message is queued >--------
+/*
+ * returns false on timeout or if the queue is closed and empty
+ */
+template <typename Msg>
+bool BlockingQueue<Msg>::waitForMsg(DWORD milliseconds)
+{
+  DWORD start = ::GetTickCount();
+  while(_Q.size() == 0)
+  {
+    if(_closed)
+      return false;
+    DWORD waited = ::GetTickCount() - start;
+    if(milliseconds != INFINITE && waited >= milliseconds)
+      return false;
+    qCv.sleep(qLock, milliseconds == INFINITE ? INFINITE : milliseconds - waited);
+  }
+  return true;
+}
+//----< after push holding lock, note if high watermark hit >-
+
+template <typename Msg>
+void BlockingQueue<Msg>::pushed()
+{
+  if(_highWater > 0 && _Q.size() >= _highWater)
+    _full = true;
 }
-//----< add a message to queue >-------------------------------
+//----< move front out holding lock, release enQ'ers if drained >
+
+template <typename Msg>
+Msg BlockingQueue<Msg>::take()
+{
+  Msg msg(std::move(_Q.front()));
+  _Q.pop();
+  if(_full && _Q.size() <= _lowWater)
+  {
+    _full = false;
+    roomCv.wakeAll();
+  }
+  return msg;
+}
+//----< add a message to queue, blocks while queue is full >---
 
 template <typename Msg>
 void BlockingQueue<Msg>::enQ(Msg msg)
+{
+  if(!enQFor(std::move(msg), INFINITE))
+    throw std::exception("enQ on closed BlockingQueue");
+}
+//----< add a message only if there is room right now >--------
+
+template <typename Msg>
+bool BlockingQueue<Msg>::tryEnQ(Msg msg)
+{
+  return enQFor(std::move(msg), 0);
+}
+//----< add a message, waiting at most milliseconds for room >-
+
+template <typename Msg>
+bool BlockingQueue<Msg>::enQFor(Msg msg, DWORD milliseconds)
 {
   qLock.lock();
-  _Q.push(msg);
+  if(!waitForRoom(milliseconds))
+  {
+    qLock.unlock();
+    return false;
+  }
+  _Q.push(std::move(msg));
+  pushed();
   qLock.unlock();
   qCv.wake();
+  return true;
 }
-//----< remove a message from queue >--------------------------
+//----< construct a message in place, blocks while full >------
 
+template <typename Msg>
+template <typename A1>
+void BlockingQueue<Msg>::emplace(A1&& a1)
+{
+  qLock.lock();
+  if(!waitForRoom(INFINITE))
+  {
+    qLock.unlock();
+    throw std::exception("emplace on closed BlockingQueue");
+  }
+  _Q.emplace(std::forward<A1>(a1));
+  pushed();
+  qLock.unlock();
+  qCv.wake();
+}
+//----< construct a message in place from two arguments >-----
+/*
+ * fixed arities, VS2012 has no variadic templates
+ */
+template <typename Msg>
+template <typename A1, typename A2>
+void BlockingQueue<Msg>::emplace(A1&& a1, A2&& a2)
+{
+  qLock.lock();
+  if(!waitForRoom(INFINITE))
+  {
+    qLock.unlock();
+    throw std::exception("emplace on closed BlockingQueue");
+  }
+  _Q.emplace(std::forward<A1>(a1), std::forward<A2>(a2));
+  pushed();
+  qLock.unlock();
+  qCv.wake();
+}
+//----< remove a message from queue >--------------------------
+/*
+ * blocks until a message arrives, throws if queue is closed
+ * and empty
+ */
 template <typename Msg>
 Msg BlockingQueue<Msg>::deQ()
 {
-  Msg msg;
   qLock.lock();
-  if(_Q.size() > 0)
+  if(!waitForMsg(INFINITE))
   {
-    msg = _Q.front();
-    _Q.pop();
     qLock.unlock();
-    return msg;
+    throw std::exception("deQ on closed BlockingQueue");
   }
-  // I'm not sure if this loop is necessary
+  Msg msg(take());
+  qLock.unlock();
+  return msg;
+}
+//----< remove a message if one is waiting >-------------------
+
+template <typename Msg>
+bool BlockingQueue<Msg>::tryDeQ(Msg& msg)
+{
+  return deQFor(msg, 0);
+}
+//----< remove a message, waiting at most milliseconds >-------
 
-  while(true)
+template <typename Msg>
+bool BlockingQueue<Msg>::deQFor(Msg& msg, DWORD milliseconds)
+{
+  qLock.lock();
+  if(!waitForMsg(milliseconds))
   {
-    qCv.sleep(qLock);
-    if(_Q.size() == 0)
-      continue;
-    msg = _Q.front();
-    _Q.pop();
     qLock.unlock();
-    return msg;
+    return false;
   }
+  msg = take();
+  qLock.unlock();
+  return true;
+}
+//----< remove up to max messages under one lock >-------------
+/*
+ * - blocks until at least one message is queued
+ * - replaces the contents of out, returns number of messages
+ * - returns zero only when the queue is closed and empty
+ */
+template <typename Msg>
+size_t BlockingQueue<Msg>::deQBatch(std::vector<Msg>& out, size_t max)
+{
+  out.clear();
+  qLock.lock();
+  if(!waitForMsg(INFINITE))
+  {
+    qLock.unlock();
+    return 0;
+  }
+  size_t count = (_Q.size() < max) ? _Q.size() : max;
+  out.reserve(count);
+  for(size_t i=0; i<count; ++i)
+    out.push_back(take());
+  qLock.unlock();
+  return count;
 }
 //----< return number of queueud messages >--------------------
 
@@ -117,5 +341,26 @@ size_t BlockingQueue<Msg>::size()
   qLock.unlock();
   return sz;
 }
+//----< refuse new messages and wake every waiter >------------
+
+template <typename Msg>
+void BlockingQueue<Msg>::close()
+{
+  qLock.lock();
+  _closed = true;
+  qLock.unlock();
+  qCv.wakeAll();
+  roomCv.wakeAll();
+}
+//----< has close been called? >-------------------------------
+
+template <typename Msg>
+bool BlockingQueue<Msg>::isClosed()
+{
+  qLock.lock();
+  bool closed = _closed;
+  qLock.unlock();
+  return closed;
+}
 
 #endif
@@ -0,0 +1,383 @@
+///////////////////////////////////////////////////////////////
+// CRC32C.cpp - Castagnoli CRC for block checksums           //
+// ver 1.0                                                   //
+// Language: standard C++                                    //
+// Platform: Dell Dimension T7400, Windows 7, SP #1          //
+// Application: Resource for DO projects                     //
+///////////////////////////////////////////////////////////////
+
+#include "CRC32C.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define CRC32C_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <nmmintrin.h>
+#define CRC32C_SSE42
+#else
+#include <cpuid.h>
+#include <nmmintrin.h>
+#define CRC32C_SSE42 __attribute__((target("sse4.2")))
+#endif
+#endif
+
+namespace
+{
+  const unsigned int POLY = 0x82f63b78;  // CRC-32C, reflected
+
+  // stream lengths of the hardware kernel, powers of two
+  const size_t LONG_STREAM = 8192;
+  const size_t SHORT_STREAM = 256;
+
+  ///////////////////////////////////////////////////////////////
+  // Tables - lookup tables built once, before main runs
+
+  struct Tables
+  {
+    unsigned int slice[8][256];       // slice-by-8 tables
+    unsigned int longShift[4][256];   // append LONG_STREAM zero bytes
+    unsigned int shortShift[4][256];  // append SHORT_STREAM zero bytes
+    bool hardware;                    // cpu has SSE4.2
+    Tables();
+  };
+
+  //----< multiply a GF(2) 32x32 matrix by a vector >------------
+
+  unsigned int gf2Times(const unsigned int* mat, unsigned int vec)
+  {
+    unsigned int sum = 0;
+    while(vec)
+    {
+      if(vec & 1)
+        sum ^= *mat;
+      vec >>= 1;
+      ++mat;
+    }
+    return sum;
+  }
+  //----< square a GF(2) matrix >--------------------------------
+
+  void gf2Square(unsigned int* square, const unsigned int* mat)
+  {
+    for(int n=0; n<32; ++n)
+      square[n] = gf2Times(mat, mat[n]);
+  }
+  //----< operator appending len zero bytes, len a power of 2 >--
+
+  void zerosOperator(unsigned int* even, size_t len)
+  {
+    unsigned int odd[32];
+    odd[0] = POLY;  // operator for one zero bit
+    unsigned int row = 1;
+    for(int n=1; n<32; ++n)
+    {
+      odd[n] = row;
+      row <<= 1;
+    }
+    gf2Square(even, odd);  // two zero bits
+    gf2Square(odd, even);  // four zero bits
+    // each square doubles the zeros, starting from one byte
+    do
+    {
+      gf2Square(even, odd);
+      len >>= 1;
+      if(len == 0)
+        return;
+      gf2Square(odd, even);
+      len >>= 1;
+    } while(len);
+    for(int n=0; n<32; ++n)
+      even[n] = odd[n];
+  }
+  //----< byte tables for the zeros operator >-------------------
+
+  void zerosTable(unsigned int table[4][256], size_t len)
+  {
+    unsigned int op[32];
+    zerosOperator(op, len);
+    for(unsigned int n=0; n<256; ++n)
+    {
+      table[0][n] = gf2Times(op, n);
+      table[1][n] = gf2Times(op, n << 8);
+      table[2][n] = gf2Times(op, n << 16);
+      table[3][n] = gf2Times(op, n << 24);
+    }
+  }
+  //----< does the cpu support the crc32 instruction? >----------
+
+  bool cpuHasSSE42()
+  {
+#if defined(CRC32C_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 20)) != 0;
+#elif defined(CRC32C_X86)
+    unsigned int eax, ebx, ecx, edx;
+    if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+      return false;
+    return (ecx & bit_SSE4_2) != 0;
+#else
+    return false;
+#endif
+  }
+  //----< build all tables >-------------------------------------
+
+  Tables::Tables()
+  {
+    for(unsigned int n=0; n<256; ++n)
+    {
+      unsigned int crc = n;
+      for(int k=0; k<8; ++k)
+        crc = (crc & 1) ? (crc >> 1) ^ POLY : crc >> 1;
+      slice[0][n] = crc;
+    }
+    for(unsigned int n=0; n<256; ++n)
+    {
+      unsigned int crc = slice[0][n];
+      for(int k=1; k<8; ++k)
+      {
+        crc = slice[0][crc & 0xff] ^ (crc >> 8);
+        slice[k][n] = crc;
+      }
+    }
+    zerosTable(longShift, LONG_STREAM);
+    zerosTable(shortShift, SHORT_STREAM);
+    hardware = cpuHasSSE42();
+  }
+
+  Tables tables;
+
+  //----< append a stream's worth of zeros to crc >--------------
+
+  inline unsigned int shift(unsigned int table[4][256], unsigned int crc)
+  {
+    return table[0][crc & 0xff] ^ table[1][(crc >> 8) & 0xff] ^
+           table[2][(crc >> 16) & 0xff] ^ table[3][crc >> 24];
+  }
+  //----< little endian 8 byte load >----------------------------
+
+  inline unsigned long long load64(const unsigned char* p)
+  {
+    unsigned long long word = 0;
+    for(int i=7; i>=0; --i)
+      word = (word << 8) | p[i];
+    return word;
+  }
+
+#ifdef CRC32C_X86
+
+  //----< crc of one aligned 8 byte word >-----------------------
+
+  CRC32C_SSE42 inline unsigned int step8(unsigned int crc, const unsigned char* p)
+  {
+#if defined(_M_X64) || defined(__x86_64__)
+    return (unsigned int)_mm_crc32_u64(crc, *(const unsigned long long*)p);
+#else
+    crc = _mm_crc32_u32(crc, *(const unsigned int*)p);
+    return _mm_crc32_u32(crc, *(const unsigned int*)(p + 4));
+#endif
+  }
+  //----< three interleaved streams of len bytes each >----------
+
+  CRC32C_SSE42 inline unsigned int streams(
+    unsigned int crc0, const unsigned char*& next, size_t len, unsigned int table[4][256]
+  )
+  {
+    unsigned int crc1 = 0;
+    unsigned int crc2 = 0;
+    const unsigned char* end = next + len;
+    do
+    {
+      crc0 = step8(crc0, next);
+      crc1 = step8(crc1, next + len);
+      crc2 = step8(crc2, next + 2 * len);
+      next += 8;
+    } while(next < end);
+    crc0 = shift(table, crc0) ^ crc1;
+    crc0 = shift(table, crc0) ^ crc2;
+    next += 2 * len;
+    return crc0;
+  }
+
+#endif
+}
+
+//----< slice-by-8 kernel, works everywhere >--------------------
+
+unsigned int CRC32C::software(const void* data, size_t len, unsigned int crc)
+{
+  const unsigned char* next = static_cast<const unsigned char*>(data);
+  crc = ~crc;
+  while(len > 0 && ((size_t)next & 7) != 0)
+  {
+    crc = tables.slice[0][(crc ^ *next++) & 0xff] ^ (crc >> 8);
+    --len;
+  }
+  while(len >= 8)
+  {
+    unsigned long long word = load64(next) ^ crc;
+    crc = tables.slice[7][word & 0xff] ^
+          tables.slice[6][(word >> 8) & 0xff] ^
+          tables.slice[5][(word >> 16) & 0xff] ^
+          tables.slice[4][(word >> 24) & 0xff] ^
+          tables.slice[3][(word >> 32) & 0xff] ^
+          tables.slice[2][(word >> 40) & 0xff] ^
+          tables.slice[1][(word >> 48) & 0xff] ^
+          tables.slice[0][word >> 56];
+    next += 8;
+    len -= 8;
+  }
+  while(len > 0)
+  {
+    crc = tables.slice[0][(crc ^ *next++) & 0xff] ^ (crc >> 8);
+    --len;
+  }
+  return ~crc;
+}
+//----< SSE4.2 kernel, falls back to software without it >-------
+
+#ifdef CRC32C_X86
+
+CRC32C_SSE42 unsigned int CRC32C::hardware(const void* data, size_t len, unsigned int crc)
+{
+  if(!tables.hardware)
+    return software(data, len, crc);
+  const unsigned char* next = static_cast<const unsigned char*>(data);
+  unsigned int crc0 = ~crc;
+  while(len > 0 && ((size_t)next & 7) != 0)
+  {
+    crc0 = _mm_crc32_u8(crc0, *next++);
+    --len;
+  }
+  while(len >= 3 * LONG_STREAM)
+  {
+    crc0 = streams(crc0, next, LONG_STREAM, tables.longShift);
+    len -= 3 * LONG_STREAM;
+  }
+  while(len >= 3 * SHORT_STREAM)
+  {
+    crc0 = streams(crc0, next, SHORT_STREAM, tables.shortShift);
+    len -= 3 * SHORT_STREAM;
+  }
+  while(len >= 8)
+  {
+    crc0 = step8(crc0, next);
+    next += 8;
+    len -= 8;
+  }
+  while(len > 0)
+  {
+    crc0 = _mm_crc32_u8(crc0, *next++);
+    --len;
+  }
+  return ~crc0;
+}
+
+#else
+
+unsigned int CRC32C::hardware(const void* data, size_t len, unsigned int crc)
+{
+  return software(data, len, crc);
+}
+
+#endif
+
+//----< best kernel for this cpu >-------------------------------
+
+unsigned int CRC32C::compute(const void* data, size_t len, unsigned int crc)
+{
+  return tables.hardware ? hardware(data, len, crc) : software(data, len, crc);
+}
+//----< is the SSE4.2 kernel used? >-----------------------------
+
+bool CRC32C::hasHardware()
+{
+  return tables.hardware;
+}
+
+#ifdef TEST_CRC32C
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cstring>
+
+//----< test stub >----------------------------------------------
+
+int main()
+{
+  std::cout << "\n  Demonstrating CRC32C";
+  std::cout << "\n ======================\n";
+
+  const char* check = "123456789";  // standard check value is e3069283
+  std::cout << std::hex;
+  std::cout << "\n  software(\"123456789\") = " << CRC32C::software(check, 9);
+  std::cout << "\n  hardware(\"123456789\") = " << CRC32C::hardware(check, 9);
+  std::cout << "\n  SSE4.2 available     = " << std::boolalpha << CRC32C::hasHardware();
+
+  // kernels must agree on every length and alignment
+  std::vector<unsigned char> buffer(100000 + 8);
+  for(size_t i=0; i<buffer.size(); ++i)
+    buffer[i] = (unsigned char)(i * 131 + 7);
+  size_t bad = 0;
+  const size_t lengths[] = { 0, 1, 7, 8, 63, 767, 768, 769, 24575, 24576, 24577, 100000 };
+  for(size_t a=0; a<8; ++a)
+    for(size_t l=0; l<sizeof(lengths)/sizeof(lengths[0]); ++l)
+    {
+      unsigned int sw = CRC32C::software(&buffer[a], lengths[l]);
+      if(sw != CRC32C::hardware(&buffer[a], lengths[l]))
+        ++bad;
+      // continuing a crc must match computing it in one go
+      size_t half = lengths[l] / 2;
+      unsigned int part = CRC32C::compute(&buffer[a], half);
+      if(sw != CRC32C::compute(&buffer[a] + half, lengths[l] - half, part))
+        ++bad;
+    }
+  std::cout << "\n  mismatches over lengths and alignments = " << std::dec << bad;
+  std::cout << "\n\n";
+}
+
+#endif
+
+#ifdef BENCH_CRC32C
+
+#include "../HiResTimer/HiResTimer.h"
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+//----< GB/s of one kernel over a buffer size >------------------
+
+double rate(unsigned int (*kernel)(const void*, size_t, unsigned int), std::vector<char>& buffer, size_t size)
+{
+  size_t rounds = (256 * 1024 * 1024) / size;  // 256 MB per measurement
+  volatile unsigned int sink = 0;
+  HRTimer::HiResTimer timer;
+  timer.Start();
+  for(size_t i=0; i<rounds; ++i)
+    sink = kernel(&buffer[0], size, sink);
+  timer.Stop();
+  return double(rounds * size) / timer.ElapsedNanoseconds();
+}
+//----< benchmark >----------------------------------------------
+
+int main()
+{
+  std::cout << "\n  CRC32C throughput, GB/s";
+  std::cout << "\n =========================";
+  std::cout << "\n  SSE4.2 available: " << (CRC32C::hasHardware() ? "yes" : "no");
+  std::vector<char> buffer(1024 * 1024);
+  for(size_t i=0; i<buffer.size(); ++i)
+    buffer[i] = (char)i;
+  const size_t sizes[] = { 64, 1024, 8192, 65536, 1024 * 1024 };
+  std::cout << "\n      block  slice-by-8    SSE4.2";
+  for(size_t i=0; i<sizeof(sizes)/sizeof(sizes[0]); ++i)
+  {
+    std::cout << "\n  " << std::setw(9) << sizes[i] << std::fixed << std::setprecision(2)
+              << std::setw(12) << rate(CRC32C::software, buffer, sizes[i])
+              << std::setw(10) << rate(CRC32C::hardware, buffer, sizes[i]);
+  }
+  std::cout << "\n\n";
+}
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+///////////////////////////////////////////////////////////////
+// CRC32C.h - Castagnoli CRC for block checksums             //
+// ver 1.0                                                   //
+// Language: standard C++                                    //
+// Platform: Dell Dimension T7400, Windows 7, SP #1          //
+// Application: Resource for DO projects                     //
+///////////////////////////////////////////////////////////////
+/*
+ * Package Operations:
+ * ===================
+ * CRC32C computes the CRC-32C (Castagnoli) checksum used to verify
+ * data blocks sent by Channel.  Two kernels are provided:
+ *
+ * - hardware uses the SSE4.2 crc32 instruction.  The buffer is cut
+ *   into three interleaved streams so the instruction's three cycle
+ *   latency is hidden, and the stream CRCs are combined with lookup
+ *   tables that append a fixed run of zero bytes to a CRC.
+ * - software is the portable slice-by-8 table method.
+ *
+ * compute() picks the hardware kernel when the cpu supports it.
+ * Both kernels give the same result, and a CRC can be continued by
+ * passing the previous result as the initial value.
+ */
+/*
+ * Public Interface:
+ * =================
+ * unsigned int crc = CRC32C::compute(data, len);  // best kernel
+ * crc = CRC32C::compute(more, moreLen, crc);      // continue a CRC
+ * bool fast = CRC32C::hasHardware();              // SSE4.2 present?
+ * crc = CRC32C::software(data, len);              // force a kernel
+ *
+ * Required Files:
+ * ---------------
+ * CRC32C.h, CRC32C.cpp
+ *
+ * Build Process:
+ * --------------
+ * cl /EHa /DTEST_CRC32C CRC32C.cpp
+ * cl /EHa /O2 /DBENCH_CRC32C CRC32C.cpp      (GB/s of each kernel)
+ *
+ * Maintenance History:
+ * --------------------
+ * ver 1.0 : 19 Oct 2026
+ * - first release
+ */
+
+#include <cstddef>
+
+class CRC32C
+{
+public:
+  static unsigned int compute(const void* data, size_t len, unsigned int crc = 0);
+  static unsigned int software(const void* data, size_t len, unsigned int crc = 0);
+  static unsigned int hardware(const void* data, size_t len, unsigned int crc = 0);
+  static bool hasHardware();
+};
+
+#endif
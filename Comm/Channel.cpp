@@ -83,4 +83,359 @@ void main() {
 	system("pause");
 }
 
-#endif
\ No newline at end of file
+#endif
+
+#ifdef BENCH_MSGID
+
+#include "Channel.h"
+#include "../HiResTimer/HiResTimer.h"
+#include <string>
+#include <iostream>
+
+//----< benchmark: per-block cost of identifying a message >----
+/*
+ * Before, every received block built a Peer from the socket, three
+ * SocketSystem calls, and formatted a string key for MsgSet.  Now the
+ * Peer is filled once per connection and a block only builds a MsgId.
+ *
+ * cl /EHa /DBENCH_MSGID Channel.cpp ../Sockets/Sockets.cpp ../Threads/Locks.cpp ../Threads/Threads.cpp
+ *    ../CRC32C/CRC32C.cpp ../LZ4/LZ4.cpp ../SHA256/SHA256.cpp ../Delta/Delta.cpp
+ *    ../Metrics/Metrics.cpp ../Trace/Trace.cpp ../SharedMemory/SharedMemory.cpp ../IoEngine/IoEngine.cpp
+ *    ../RateLimit/RateLimit.cpp ws2_32.lib
+ */
+void main() {
+	const size_t N = 100000;
+	try {
+		SocketListener listener(9090);
+		Socket sendr;
+		if (!sendr.connect("127.0.0.1", 9090)) {
+			sout << "\n  connect failed\n\n";
+			return;
+		}
+		Socket recvr = listener.waitForConnect();
+		std::string fileName("run.bat");
+
+		Peer once(recvr);
+		std::unordered_map<std::string, Message> oldSet;
+		std::unordered_map<MsgId, Message, MsgId::Hasher> newSet;
+		oldSet[once.toString() +'/'+ fileName] = Message();
+		newSet[MsgId(once.key(), fileName)] = Message();
+
+		HRTimer::HiResTimer timer;
+		size_t found = 0;
+		timer.Start();
+		for (size_t i=0; i<N; i++) {
+			Peer p;	// what the old ClientHandlerThread did per block
+			p.remote = recvr.System().getRemoteIP(&recvr);
+			p.lport = recvr.System().getLocalPort(&recvr);
+			p.rport = recvr.System().getRemotePort(&recvr);
+			std::string msgid(p.toString() +'/'+ fileName);
+			found += oldSet.count(msgid);
+		}
+		timer.Stop();
+		__int64 oldNs = timer.ElapsedNanoseconds();
+
+		timer.Start();
+		for (size_t i=0; i<N; i++) {
+			MsgId msgid(once.key(), fileName);
+			found += newSet.count(msgid);
+		}
+		timer.Stop();
+		__int64 newNs = timer.ElapsedNanoseconds();
+
+		std::cout << "\n  Per-block message id cost, " << N << " blocks";
+		std::cout << "\n ==========================================";
+		std::cout << "\n  Peer per block + string key: " << oldNs / N << " ns/block";
+		std::cout << "\n  Peer per connection + MsgId: " << newNs / N << " ns/block";
+		std::cout << "\n  (" << found << " lookups hit)\n\n";
+		sendr.disconnect();
+		recvr.disconnect();
+	}
+	catch (std::exception& ex) {
+		sout << "\n  " << ex.what() << "\n\n";
+	}
+}
+
+#endif
+
+#ifdef BENCH_BATCHING
+
+#include "Channel.h"
+#include "../HiResTimer/HiResTimer.h"
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+
+//----< benchmark: small messages per second against BatchPolicy >----
+/*
+ * One channel sends N short string messages over loopback to another
+ * channel, once per batch setting, and the time until the receiver has
+ * seen all of them is measured.  maxMessages of 1 is the old behavior,
+ * a connection, header, quit line and disconnect per message.  Shared
+ * memory is off by default, so the messages go over sockets.
+ *
+ * cl /EHa /O2 /DBENCH_BATCHING Channel.cpp ../Sockets/Sockets.cpp ../Threads/Locks.cpp ../Threads/Threads.cpp
+ *    ../CRC32C/CRC32C.cpp ../LZ4/LZ4.cpp ../SHA256/SHA256.cpp ../Delta/Delta.cpp
+ *    ../Metrics/Metrics.cpp ../Trace/Trace.cpp ../SharedMemory/SharedMemory.cpp ../IoEngine/IoEngine.cpp
+ *    ../RateLimit/RateLimit.cpp ws2_32.lib
+ */
+
+///////////////////////////////////////////////////
+// listen callback, counts received messages
+class MessageCounter {
+	volatile long count;
+public:
+	MessageCounter() : count(0) {}
+	void operator()(Message& msg) {
+		::InterlockedIncrement(&count);
+	}
+	long received() {
+		return count;
+	}
+};
+
+///////////////////////////////////////////////////
+// runs the receiving channel's listen loop
+class ListenHelperThread : public threadBase {
+	Channel& ch;
+	MessageCounter& counter;
+	size_t port;
+	void run() {
+		ch.listen<MessageCounter>(port, counter);
+	}
+public:
+	ListenHelperThread(Channel& _ch, MessageCounter& _counter, size_t _port) : ch(_ch), counter(_counter), port(_port) {}
+};
+
+//----< messages per second with one batch setting >-----------
+double run(size_t port, size_t N, const BatchPolicy& policy) {
+	Channel receiver("RX", Peer(port, "127.0.0.1", 0));
+	receiver.enableACK() = false;
+	receiver.enableLog() = false;
+	MessageCounter counter;
+	ListenHelperThread listener(receiver, counter, port);
+	listener.start();
+	::Sleep(100);	// let the listener bind
+
+	Channel sender("TX", Peer("127.0.0.1", port));
+	sender.enableLog() = false;
+	sender.batchPolicy() = policy;
+	HRTimer::HiResTimer timer;
+	timer.Start();
+	for (size_t i = 0; i < N; i++) {
+		std::ostringstream os;
+		os << "Task#" << i;
+		Message m;
+		m.fromString(os.str());
+		sender.send(std::move(m));
+	}
+	while ((size_t)counter.received() < N)
+		::Sleep(1);
+	timer.Stop();
+	sender.close();
+	receiver.close();
+	listener.join();
+	return N * 1000000.0 / timer.ElapsedMicroseconds();
+}
+
+void main() {
+	const size_t N = 2000;
+	struct { size_t maxMessages, maxBytes, lingerMicros; } settings[] = {
+		{ 1, 64*1024, 0 },
+		{ 32, 64*1024, 0 },
+		{ 32, 64*1024, 200 },
+		{ 256, 64*1024, 200 },
+		{ 256, 256*1024, 1000 },
+	};
+	std::cout << "\n  Small message throughput, " << N << " messages per run";
+	std::cout << "\n ================================================";
+	std::cout << "\n  maxMessages  maxBytes  linger(us)     msgs/sec";
+	for (size_t i = 0; i < sizeof(settings) / sizeof(settings[0]); i++) {
+		BatchPolicy policy;
+		policy.maxMessages = settings[i].maxMessages;
+		policy.maxBytes = settings[i].maxBytes;
+		policy.lingerMicros = settings[i].lingerMicros;
+		try {
+			double rate = run(9200 + i, N, policy);
+			std::cout << "\n  " << std::setw(11) << policy.maxMessages << std::setw(10) << policy.maxBytes
+				<< std::setw(12) << policy.lingerMicros << std::setw(13) << std::fixed << std::setprecision(0) << rate;
+		}
+		catch (std::exception& ex) {
+			std::cout << "\n  run failed: " << ex.what();
+		}
+	}
+	std::cout << "\n\n";
+}
+
+#endif
+
+#ifdef BENCH_PEER
+
+#include "Channel.h"
+#include "../MicroBench/MicroBench.h"
+#include <iostream>
+
+//----< benchmark: per call cost of naming a peer >----------------
+/*
+ * toString() formats a string stream on every call, and is still used
+ * for logging; key() is what identifies a connection on the hot path.
+ *
+ * cl /EHa /O2 /DBENCH_PEER Channel.cpp ../MicroBench/MicroBench.cpp ../Sockets/Sockets.cpp ../Threads/Locks.cpp
+ *    ../CRC32C/CRC32C.cpp ../LZ4/LZ4.cpp ../SHA256/SHA256.cpp ../Delta/Delta.cpp
+ *    ../Metrics/Metrics.cpp ../Trace/Trace.cpp ../SharedMemory/SharedMemory.cpp ../IoEngine/IoEngine.cpp
+ *    ../RateLimit/RateLimit.cpp ws2_32.lib
+ */
+void main() {
+	const size_t N = 100000;
+	Peer p(8080, "127.0.0.1", 8081);
+	p.raddr = 0x0100007f;
+	MicroBench::title("Peer");
+	MicroBench::report("Peer::toString", MicroBench::measure(N, [&]() {
+		MicroBench::keep(p.toString().size());
+	}));
+	MicroBench::report("Peer::remoteHost", MicroBench::measure(N, [&]() {
+		MicroBench::keep(p.remoteHost().size());
+	}));
+	MicroBench::report("Peer::key", MicroBench::measure(N, [&]() {
+		MicroBench::keep((size_t)p.key());
+	}));
+	std::cout << "\n\n";
+}
+
+#endif
+
+#ifdef TEST_LOCAL
+
+#include "Channel.h"
+#include "Messenger.h"
+#include <iostream>
+
+///////////////////////////////////////////////////
+// listens on a local path until its channel is closed
+class LocalReceiverThread : public threadBase {
+	Channel& ch;
+	std::string path;
+	void run() {
+		Messenger mess(ch);
+		ch.listen<Messenger>(path, mess);
+	}
+public:
+	LocalReceiverThread(Channel& _ch, const std::string& _path) : ch(_ch), path(_path) {}
+};
+
+//----< test stub: a file handed over on a local path >------------
+/*
+ * the receiver gets a handle to ../run.bat instead of its bytes, and
+ * Messenger saves it to ReceivedFiles, needs Windows 10 1803 or later
+ *
+ * cl /EHa /DTEST_LOCAL Channel.cpp ../Sockets/Sockets.cpp ../Threads/Locks.cpp ../Threads/Threads.cpp
+ *    ../CRC32C/CRC32C.cpp ../LZ4/LZ4.cpp ../SHA256/SHA256.cpp ../Delta/Delta.cpp
+ *    ../Metrics/Metrics.cpp ../Trace/Trace.cpp ../SharedMemory/SharedMemory.cpp ../IoEngine/IoEngine.cpp
+ *    ../RateLimit/RateLimit.cpp ws2_32.lib
+ */
+void main() {
+	try
+	{
+		const std::string path = "channel.sock";
+		Channel rx("LOCAL-RX", Peer());
+		rx.enableACK() = false;
+		LocalReceiverThread listener(rx, path);
+		listener.start();
+		::Sleep(500);	// let it bind the path
+
+		Channel tx("LOCAL-TX", Peer(path));
+		Message m;
+		m.fromFile("../run.bat");
+		tx.send(std::move(m));
+		tx.close();
+		::Sleep(500);	// let the receiver save it
+		rx.close();
+		listener.join();
+	}
+	catch(std::exception& ex) {
+		sout << "\n\n  " << ex.what();
+	}
+	sout << "\n\n";
+}
+
+#endif
+
+#ifdef BENCH_ACCEPT
+
+#include "Channel.h"
+#include "../HiResTimer/HiResTimer.h"
+#include <iostream>
+
+///////////////////////////////////////////////////
+// accepts until its channel is closed, handing messages nowhere
+class AcceptorThread : public threadBase {
+	Channel& ch;
+	size_t port;
+	void run() {
+		auto ignore = [](Message&) {};
+		ch.listen(port, ignore);
+	}
+public:
+	AcceptorThread(Channel& _ch, size_t _port) : ch(_ch), port(_port) {}
+};
+
+///////////////////////////////////////////////////
+// opens short-lived connections, each saying only "quit"
+class ConnectorThread : public threadBase {
+	size_t port, count;
+	void run() {
+		for (size_t i = 0; i < count; i++) {
+			Socket s;
+			if (!s.connect("127.0.0.1", (int)port)) continue;
+			s.writeLine("quit");
+			s.disconnect();
+		}
+	}
+public:
+	ConnectorThread(size_t _port, size_t _count) : port(_port), count(_count) {}
+};
+
+//----< benchmark: connections per second, by accepting threads >-
+/*
+ * 8 threads connect 500 times each, to a port accepted on by 1, 2 and
+ * 4 threads; more acceptors should accept a burst faster
+ *
+ * cl /EHa /O2 /DBENCH_ACCEPT Channel.cpp ../Sockets/Sockets.cpp ../Threads/Locks.cpp ../Threads/Threads.cpp
+ *    ../CRC32C/CRC32C.cpp ../LZ4/LZ4.cpp ../SHA256/SHA256.cpp ../Delta/Delta.cpp
+ *    ../Metrics/Metrics.cpp ../Trace/Trace.cpp ../SharedMemory/SharedMemory.cpp ../IoEngine/IoEngine.cpp
+ *    ../RateLimit/RateLimit.cpp ws2_32.lib
+ */
+void main() {
+	const size_t Connectors = 8, Each = 500;
+	size_t acceptors[] = { 1, 2, 4 };
+	for (size_t a = 0; a < 3; a++) {
+		size_t port = 9400 + a;	// a stopped listener's port is not reused
+		Channel rx("ACCEPT", Peer());
+		rx.enableLog() = false;
+		rx.acceptors() = acceptors[a];
+		AcceptorThread listener(rx, port);
+		listener.start();
+		::Sleep(500);	// let it bind
+
+		std::vector<ConnectorThread*> threads;
+		HRTimer::HiResTimer timer;
+		timer.Start();
+		for (size_t i = 0; i < Connectors; i++) {
+			threads.push_back(new ConnectorThread(port, Each));
+			threads.back()->start();
+		}
+		for (size_t i = 0; i < threads.size(); i++) {
+			threads[i]->join();
+			delete threads[i];
+		}
+		timer.Stop();
+		double secs = timer.ElapsedNanoseconds() / 1e9;
+		std::cout << "\n  " << acceptors[a] << " acceptor(s): " << (size_t)(Connectors * Each / secs) << " connections/sec";
+		rx.close();
+		listener.join();
+	}
+	std::cout << "\n\n";
+}
+
+#endif
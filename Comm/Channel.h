@@ -30,47 +30,333 @@ Channel class also controls some low-level sending details such as replying
 acknowledge message to the sender.  Channel package should hide all the
 communication details from high-level classes.
 
+Send and receive queues are bounded by high/low watermarks.  A full send
+queue blocks send(), or fails trySend() and sendFor().  A full receive queue
+blocks the thread reading that connection, so it stops reading the socket
+and TCP flow control slows the remote sender down.
+
+The send thread coalesces queued messages for the same peer: up to
+BatchPolicy::maxMessages of them share one connection and one "quit" line,
+and their headers and small blocks are buffered into writes of about
+maxBytes.  After taking messages from the queue it waits up to lingerMicros
+for more to join them.
+
+Each group is connected and written by a thread of its peer's own, so a
+peer that is slow to connect, or does not answer at all, only holds up its
+own messages while they retry and back off.  A peer's thread starts when a
+message for it is first queued and stops after PEER_IDLE_MILLIS without
+any.  Up to PEER_BACKLOG groups wait for it.  When that many are waiting,
+the send thread waits for room if the peer is reachable, which slows the
+senders down as a full send queue does.  If the peer's last connect
+failed, the messages go to nextFailure() instead.
+
+Each data block is sent with a CRC32C checksum of its bytes.  The receiver
+verifies it, drops the message on a mismatch and answers with a NAK naming
+the message and the bad checksum.  The sender keeps its last SENT_CACHE
+messages, holding at most SENT_CACHE_BYTES, and resends the one named by a
+NAK, at most MAX_RESENDS times, after which the message is reported through
+nextFailure().  Of a message loaded by fromFile() only the path and block
+checksums are kept; a resend reads the file again, and reports it as failed
+if it has changed since it was sent.
+
+A channel which listens on a TCP port names it in the headers it sends,
+and a receiver sends its ACKs, NAKs and other answers to that port at the
+address the message came from, so a channel receiving from several peers
+answers each one.  Answers to a sender which did not name a port go to
+the channel's paired remote peer, as before.
+
+With enableCompression() set, data blocks are LZ4 compressed when that
+makes them smaller, and sent raw otherwise.  Receivers always decode
+compressed blocks, straight into the block kept for reassembly; both peers
+must run a version that knows the Content-Encoding field.
+
+With enableDedup() set, a file is not sent right away.  The channel sends
+an offer naming the file's SHA-256 hash instead, and keeps the file until
+the receiver answers.  A receiver whose ObjectStore holds that content
+links it into ReceivedFiles and answers "have", and the file is never
+sent.  Otherwise it answers "need" and the file follows.  At most
+PENDING_OFFERS files wait for an answer; older ones go to nextFailure().
+
+With enableDelta() set as well, offers say the sender can send deltas.  A
+receiver holding an older copy of the file answers with rsync signatures
+of it instead of "need", and the sender sends a delta message of literal
+bytes and copy instructions by range, which Messenger applies to the old
+copy.  The delta is encoded from the file's blocks as they are, without
+gathering them into one buffer.  Once the rebuilt file matches the offered
+hash Messenger answers "have", and the sender drops the file it kept;
+otherwise Messenger answers "need" and the whole file follows.
+
+Receive queues and listeners belong to ports, not channels, and live in a
+registry shared by all channels.  A port's entry is created on first use
+and never freed, so listen() looks it up once and then reads its queue
+without touching the registry.  The registry is guarded by a reader-writer
+lock, and only one channel can claim a port for listening.
+
+A port is accepted on by one listen thread, or by acceptors() of them when
+many short connections arrive at once.  Windows has no SO_REUSEPORT that
+spreads connections over sockets, so the threads share the port's one
+listener, with a backlog of SOMAXCONN, and the system hands each connection
+to one waiting accept.  Each thread is pinned to one CPU, a network CPU in
+turn or any CPU when none are set, and the handler of a connection it
+accepts runs on that CPU too.  Transient accept errors do not stop them.
+
+socketOptions() sets the TCP options of a channel's connections, and of
+the listener its listen() creates, which gives them to every connection it
+accepts; socketOptions(peer, options) sets them for connections to one peer
+host.  Nothing is changed from the system defaults unless asked for.  The
+latency profile turns off Nagle's delay and delayed ACKs, so ACKs and small
+task messages go out at once; the bulk profile sets 4 MB socket buffers
+for large transfers on high bandwidth-delay links, and corks a connection
+while a batch is written where the system has TCP_CORK.
+
+Sends can be paced by token buckets, block by block: one per channel,
+TokenBucket::peer() per peer host and TokenBucket::global() for the whole
+process, each set with sendLimit() or limit() and changeable while
+sending.  A peer host's bucket is shared by every channel of the process,
+whichever channel set its limit.  A block waits
+until every bucket it is charged to has tokens, and a block larger than
+what is left goes through and puts the bucket in debt.  A channel is BULK
+or INTERACTIVE: an interactive channel, such as one carrying task messages,
+never waits for the global cap but is charged to it, so bulk channels back
+off while it sends.  ACKs and NAKs never wait.  Messages through shared
+memory do not touch the network and are not paced.
+
+Channels record metrics in the Metrics registry as they run: messages and
+bytes sent and received per remote host, connect failures and connect
+time, send and receive queue depths, messages under reassembly, time to
+process a block and time spent in the listen callback.  Metrics looked up
+by name are looked up once per connection or batch, never per block.
+
+With enableTrace() set, every message sent gets a trace id, carried in the
+Trace-Id field of its blocks, unless it has one already.  The send thread
+and the receiving channel stamp a traced message at each stage, from
+entering the send queue to the listen callback returning, into the file
+opened by Trace::open(); the TraceReport tool prints the time spent
+between stages.  An offer shares the trace id of its file.
+
+Once enableSharedMemory() is set, peers on the same host skip TCP; it is
+off by default, so loopback traffic keeps going over sockets.  listen()
+then also creates a shared memory ring named after its port, and a send
+thread whose peer resolves to a loopback or this host's address writes
+whole messages into that ring when it exists: file name, flags and block sizes in a fixed binary frame, then
+the blocks, with no header text and no system call unless a side has to
+wait or two writers collide; whether the receiver is still alive is asked
+once per batch.  A message bigger than SHM_INLINE_MAX is copied once into a shared
+section of its own, and only the section's number goes through the ring;
+the receiver opens the section by a name made of the port, the writer's
+process id and that number, and the writer keeps it until the receiver
+has released the frame.
+The receiver queues, ACKs and traces these messages like any other; there
+is no checksum or compression, nothing goes over a wire.  When the ring
+cannot be opened, or a write fails, the messages go by TCP.
+
+A peer can also be a local path, such as a sidecar on the same host:
+listen(path, f) accepts AF_UNIX stream connections on it, and messages
+for a Peer made from a path are sent over one, with the same headers and
+batching as TCP.  On such a connection a file message loaded by
+fromFile() is not sent as bytes: the sender opens the file and, for each
+range of up to HANDOVER_RANGE bytes, copies its handle and sends a header
+naming the copy; the receiver takes the copy out of the sender's process,
+so only the process at the other end of the socket can lend it one, and
+reads the range from it into one block if it is a disk file.  The file is read as it is when it
+arrives, and its bytes are sent after all if it cannot be opened or its
+size changed since it was loaded.
+
 Peer:
 -------
 Peer data structure is used to store the peer information, typically remote
-IP, remote port, local IP, local port.  It can be used to distinguish different
-channels by using this pair as ID.
+IP, remote port, local IP, local port, or the path of a local socket.  It can
+be used to distinguish different channels by using this pair as ID.  key()
+packs address and ports into one integer, which is cheaper to compare and hash
+than toString(); connections on a local path are numbered instead.
+
+MsgId:
+-------
+Identifies a message under reassembly by its connection's Peer::key() and
+file name.  The hash is computed once, when the id is made.
 
 Public Interface:
 =================
 Peer p;
+Peer side("C:\\run\\sidecar.sock");	// peer listening on a local path
 p.fill(socket);	// fill data with socket information
 std::string str = p.toString();	// return this pair as string
 std::string remote = p.remoteHost();	// return remote host string
 std::string local = p.localHost();	// return local host string
+unsigned long long k = p.key();	// return numeric address+ports key
+MsgId id(p.key(), fileName);	// id of a message under reassembly
 
 Channel ch(p);	// create a channel with specific peer
 ch.enableACK()=true;	// enable ACK on channel
 ch.send(p, msg);	// send message to specific peer
 ch.send(msg);	// send message to paired remote peer
+ch.send(std::move(msg));	// hand message over to the channel, no copy
+ch.reply(received, std::move(msg));	// send to where the sender of a received message listens
+bool queued = ch.trySend(p, msg);	// send only if send queue has room now
+queued = ch.sendFor(msg, 500);	// wait up to 500 millisecs for room
+ch.sendLimits(1024, 768);	// set send queue watermarks, in messages
+Channel::receiveLimits(port, 256, 128);	// set receive queue watermarks of a port, or of a local path
+ch.batchPolicy().lingerMicros = 500;	// wait longer for messages to share a connection
+ch.enableLog() = false;	// stop printing progress messages
+ch.enableChecksum() = false;	// send blocks without checksums, and keep no resend cache
+ch.enableCompression() = true;	// LZ4 compress blocks which shrink
+ch.enableDedup() = true;	// offer files by content hash before sending them
+ch.enableDelta() = true;	// offer deltas against the receiver's older copy
+ch.enableTrace() = true;	// trace sent messages, see Trace::open()
+ch.enableSharedMemory() = true;	// same-host peers skip TCP, off by default
+ch.connectPolicy().maxTries = 3;	// tune connect retries, timeouts and circuit breaker
+ch.socketOptions() = SocketOptions::latency();	// TCP options of this channel's sockets
+ch.socketOptions(p, SocketOptions::bulk());	// and of connections to one peer host
+ch.sendLimit(50 << 20);	// pace this channel's sends to 50 MB/s, 0 for no limit
+ch.sendLimit(p, 10 << 20);	// and those of every channel to p's host to 10 MB/s
+TokenBucket::global().limit(100 << 20);	// all channels of the process
+ch.priority(TokenBucket::INTERACTIVE);	// never wait for the global cap, may change while sending
+TokenBucket::Priority pr = ch.priority();
+bool failed = ch.nextFailure(p, msg);	// fetch a message that could not be delivered
+ch.acceptors() = 4;	// accept on 4 threads, each pinned to a CPU, before listen()
 ch.listen<Messenger>(port, func);	// listen to a specific port
 ch.listen<Messenger>(f);	// listen to paired peer port
+ch.listen<Messenger>(path, f);	// listen on a local path
+ch.close();	// finish queued sends, stop listening, return from listen()
+Metrics::dumpEvery("comm.prom", 10000);	// write channel metrics to a file
+IoEngine::start(2);	// sockets and saved files use overlapped I/O from now on
 
 Build Process:
 ==============
 Required Files:
-Sockets.h, Sockets.cpp, Locks.h, Threads.h, BlockingQueue.h, BlockingQueue.cpp, Message.h, HttpWrapper.h
+Sockets.h, Sockets.cpp, Locks.h, Threads.h, BlockingQueue.h, BlockingQueue.cpp, Message.h, HttpWrapper.h,
+HiResTimer.h, CRC32C.h, CRC32C.cpp, LZ4.h, LZ4.cpp, SHA256.h, SHA256.cpp, ObjectStore.h, Delta.h, Delta.cpp,
+Metrics.h, Metrics.cpp, Trace.h, Trace.cpp, SharedMemory.h, SharedMemory.cpp, IoEngine.h, IoEngine.cpp,
+RateLimit.h, RateLimit.cpp
 
 Maintenance History:
 ====================
 - Apr 16, 2013 : initial version
+- Oct 19, 2026 : each peer is connected to and sent to by a thread of its
+                 own, so an unreachable peer does not hold up the others
+- Oct 19, 2026 : answers to offers go to the port the offering channel
+                 listens on
+- Oct 19, 2026 : ACKs and resend requests go to the port the sender
+                 listens on, added reply()
+- Oct 19, 2026 : shared memory is off by default; large messages go in
+                 named sections the receiver opens by name
+- Oct 19, 2026 : receivers take handed over file handles out of the sender,
+                 and only read them if they are disk files
+- Oct 19, 2026 : sends are paced by per channel, per peer and global token
+                 buckets, added sendLimit() and priority()
+- Oct 19, 2026 : TCP socket options per channel and per peer host, added
+                 socketOptions()
+- Oct 19, 2026 : a port can be accepted on by several threads, each pinned to
+                 a CPU with the handlers of its connections, added acceptors()
+- Oct 19, 2026 : a large block and the headers buffered before it go out as
+                 one gather send, overlapped once IoEngine is started
+- Oct 19, 2026 : peers can be local paths, reached over AF_UNIX sockets, on
+                 which files loaded by fromFile() are handed over as handles
+- Oct 19, 2026 : same-host peers exchange messages through shared memory
+                 rings, added enableSharedMemory()
+- Oct 19, 2026 : messages can carry trace ids, whose stages are recorded
+                 on both ends, added enableTrace()
+- Oct 19, 2026 : counters, gauges and latency histograms of traffic, queues
+                 and reassembly are recorded in the Metrics registry
+- Oct 19, 2026 : changed files can be sent as rsync style deltas, added
+                 enableDelta(); offers and answers are reassembled like any
+                 message, so answers can carry block signatures
+- Oct 19, 2026 : files can be offered by content hash and are only sent when
+                 the receiver does not have them, added enableDedup()
+- Oct 19, 2026 : optional LZ4 compression of data blocks, added enableCompression()
+- Oct 19, 2026 : blocks carry CRC32C checksums, corrupted messages are
+                 NAKed and resent from a cache of recently sent messages;
+                 a block whose message is unknown is now read and dropped
+                 instead of being parsed as a header
+- Oct 19, 2026 : queued messages for the same peer share a connection and
+                 are coalesced into large writes, added batchPolicy() and enableLog()
+- Oct 19, 2026 : receive queue, listener and listen thread of a port are kept
+                 in one registry entry, looked up under a reader-writer lock
+                 once per listen() instead of once per message
+- Oct 19, 2026 : network threads are named after the channel and can be
+                 pinned to CPUs with networkAffinity()
+- Oct 19, 2026 : messages are moved through send / receive queues, added
+                 rvalue send overloads
+- Oct 19, 2026 : send and listen loops drain their queues in batches, added close()
+- Oct 19, 2026 : bounded send / receive queues, added trySend, sendFor,
+                 sendLimits and receiveLimits
+- Oct 19, 2026 : peer identity is resolved once per connection, message ids
+                 under reassembly are MsgId structs instead of formatted strings
+- Oct 19, 2026 : undeliverable messages are queued for nextFailure() instead of
+                 being dropped; connect policy exposed through connectPolicy()
 
 */
 
 #include <string>
 #include <unordered_map>
 #include <sstream>
+#include <fstream>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <cstring>
+#include <atomic>
+#include <memory>
 #include "../Sockets/Sockets.h"
 #include "../Threads/Locks.h"
 #include "../Threads/Threads.h"
 #include "../BlockingQueue/BlockingQueue.h"
+#include "../HiResTimer/HiResTimer.h"
+#include "../CRC32C/CRC32C.h"
+#include "../LZ4/LZ4.h"
 #include "Message.h"
 #include "HttpWrapper.h"
+#include "ObjectStore.h"
+#include "../Delta/Delta.h"
+#include "../Metrics/Metrics.h"
+#include "../Trace/Trace.h"
+#include "../RateLimit/RateLimit.h"
+#include "../SharedMemory/SharedMemory.h"
+
+// default queue watermarks, in messages
+#define SENDQ_HIGH_WATER 1024
+#define SENDQ_LOW_WATER 768
+#define RECEIVEQ_HIGH_WATER 256
+#define RECEIVEQ_LOW_WATER 128
+// most messages taken from a queue under one lock
+#define QUEUE_BATCH 32
+// sent messages kept for resending, the bytes they may hold, and
+// resends allowed per message
+#define SENT_CACHE 64
+#define SENT_CACHE_BYTES (64*1024*1024)
+#define MAX_RESENDS 3
+// smaller blocks are never worth compressing
+#define COMPRESS_MIN_BLOCK 64
+// files kept while their content hash offer awaits an answer
+#define PENDING_OFFERS 64
+// smaller old copies are not worth a delta
+#define DELTA_MIN_SIZE (16*1024)
+// largest range of a file handed over to a local peer, read by the
+// receiver into one block
+#define HANDOVER_RANGE (64*1024*1024)
+// shared memory ring of a port, for same-host senders, and the largest
+// message written into it, larger ones pass in a section of their own
+#define SHM_RING_BYTES (4*1024*1024)
+#define SHM_INLINE_MAX (256*1024)
+// milliseconds a sender waits for room in a ring before using TCP
+#define SHM_WRITE_TIMEOUT 30000
+// groups of messages waiting for one peer's thread, millisecs the send
+// thread waits at a time for room among them, and millisecs a peer's
+// thread may stay idle before it is stopped
+#define PEER_BACKLOG 64
+#define PEER_POST_WAIT 100
+#define PEER_IDLE_MILLIS 10000
+
+/////////////////////////////////////////////////////////////////////
+// BatchPolicy struct
+// how the send thread coalesces queued messages for the same peer
+struct BatchPolicy {
+	size_t maxMessages;	// messages sent over one connection, 1 gives each its own
+	size_t maxBytes;	// buffered bytes that force a write, larger blocks are written alone
+	size_t lingerMicros;	// longest a batch waits for more messages, 0 never waits
+
+	BatchPolicy() : maxMessages(256), maxBytes(64*1024), lingerMicros(200) {}
+};
 
 /////////////////////////////////////////////////////////////////////
 // Peer class
@@ -78,10 +364,13 @@ Maintenance History:
 struct Peer {
 	std::string remote;	// remote's IP address
 	size_t lport;	// local port
-	size_t rport;	// remote port
+	size_t rport;	// remote port, or number of a connection on a local path
+	unsigned long raddr;	// remote IPv4 address in network byte order, 0 if unknown
+	std::string path;	// local socket path, used instead of remote and rport
+	static volatile long connections;	// connections on local paths so far
 
 	// default constructor
-	Peer() : lport(0), rport(0) {}
+	Peer() : lport(0), rport(0), raddr(0) {}
 
 	// fill data with specific socket
 	Peer(Socket& s) {
@@ -89,98 +378,709 @@ struct Peer {
 	}
 
 	// constructors
-	Peer(std::string _remote, size_t _rport) : remote(_remote), rport(_rport) {}
-	Peer(size_t _lport, std::string _remote, size_t _rport) : remote(_remote), rport(_rport), lport(_lport) {}
+	Peer(std::string _remote, size_t _rport) : remote(_remote), rport(_rport), lport(0), raddr(0) {}
+	Peer(size_t _lport, std::string _remote, size_t _rport) : remote(_remote), rport(_rport), lport(_lport), raddr(0) {}
+	explicit Peer(const std::string& _path) : lport(0), rport(0), raddr(0), path(_path) {}
 
 	// fill information from socket
 	void fill(Socket& s) {
-		remote = s.System().getRemoteIP(&s);
-		lport = s.System().getLocalPort(&s);
-		rport = s.System().getRemotePort(&s);
+		path = s.System().getLocalPath(&s);
+		if (!path.empty()) {	// a local socket has no addresses, number it
+			remote = "";
+			lport = 0;
+			rport = (size_t)::InterlockedIncrement(&connections);
+			raddr = 0;
+			return;
+		}
+		SOCKADDR_IN r, l;
+		if (!s.System().getEndpoints(&s, r, l)) {
+			remote = "";
+			lport = rport = 0;
+			raddr = 0;
+			return;
+		}
+		raddr = r.sin_addr.s_addr;
+		remote = inet_ntoa(r.sin_addr);
+		rport = ntohs(r.sin_port);
+		lport = ntohs(l.sin_port);
+	}
+
+	// return address and ports packed as one number
+	unsigned long long key() const {
+		return ((unsigned long long)raddr << 32) | ((rport & 0xffff) << 16) | (lport & 0xffff);
+	}
+
+	// is there somewhere to send to
+	bool reachable() const {
+		return !path.empty() || (rport != 0 && !remote.empty());
+	}
+
+	// remote address, or local path, without ports
+	const std::string& host() const {
+		return path.empty() ? remote : path;
 	}
 
 	// return this pair as string
-	std::string toString() {
+	std::string toString() const {
 		std::ostringstream ss;
-		ss << "[" << remote << ":" << rport << "](local " << lport <<")";
+		if (!path.empty())
+			ss << "[" << path << "](connection " << rport << ")";
+		else
+			ss << "[" << remote << ":" << rport << "](local " << lport <<")";
 		return ss.str();
 	}
 
 	// return remote host string
-	std::string remoteHost() {
+	std::string remoteHost() const {
+		if (!path.empty()) return path;
 		std::ostringstream ss;
 		ss << remote << ":" << rport;
 		return ss.str();
 	}
 };
 
+/////////////////////////////////////////////////////////////////////
+// MsgId struct
+// key of a message under reassembly: connection plus file name
+struct MsgId {
+	unsigned long long peer;	// Peer::key() of the connection
+	std::string name;	// transmitted file name
+	size_t hash;	// computed once, used by Hasher
+
+	// constructor
+	MsgId(unsigned long long _peer, const std::string& _name) : peer(_peer), name(_name) {
+		size_t h = std::hash<unsigned long long>()(peer);
+		hash = std::hash<std::string>()(name) ^ (h + 0x9e3779b9 + (h<<6) + (h>>2));
+	}
+
+	bool operator==(const MsgId& other) const {
+		return hash==other.hash && peer==other.peer && name==other.name;
+	}
+
+	// hash functor for unordered containers
+	struct Hasher {
+		size_t operator()(const MsgId& id) const {
+			return id.hash;
+		}
+	};
+};
+
 /////////////////////////////////////////////////////////////////////
 // Channel class
 class Channel {
 	typedef BlockingQueue<Message> messageQ; // data buffer queue, for a whole message
 	typedef std::pair<Peer, Message> MsgPair;
-	static std::unordered_map<std::string, Message> MsgSet;	// transmission name, message
+	static std::unordered_map<MsgId, Message, MsgId::Hasher> MsgSet;	// transmission id, message
 	// NOTE: only one receive port is support on one single channel!
-	static std::unordered_map<size_t, messageQ> receiveQ; // global receive buffer queue
-	static std::unordered_map<size_t, SocketListener*> receiveSocket;	// socket used by receiver
+
+	///////////////////////////////////////////////////
+	// receive port registry entry, created once per port and never
+	// freed, so a handle stays valid without holding the registry lock
+	class ListenThread;
+	class SharedListenThread;
+	struct Port {
+		size_t number;	// port number, 0 for a local path
+		std::string path;	// local path listened on, empty for a TCP port
+		std::string label;	// metric label naming the port
+		messageQ q;	// global receive buffer queue of this port
+		bool claimed;	// a channel listens on this port
+		SocketListener* listener;	// socket used by receiver, set by the claiming channel
+		std::vector<ListenThread*> threads;	// accepting threads of the claiming channel
+		SharedRing* ring;	// written by same-host senders, null if never opened
+		SharedListenThread* sharedThread;	// reads ring, null if it could not be created
+		Gauge& depth;	// messages in q, as last seen
+
+		Port(size_t _number) : number(_number), label(portLabel(_number)), claimed(false), listener(0), ring(0), sharedThread(0),
+			depth(Metrics::gauge("comm_receive_queue_depth", label)) {
+			q.setLimits(RECEIVEQ_HIGH_WATER, RECEIVEQ_LOW_WATER);
+		}
+		Port(const std::string& _path) : number(0), path(_path), label(Metrics::label("port", _path)), claimed(false), listener(0), ring(0), sharedThread(0),
+			depth(Metrics::gauge("comm_receive_queue_depth", label)) {
+			q.setLimits(RECEIVEQ_HIGH_WATER, RECEIVEQ_LOW_WATER);
+		}
+	};
+	static std::unordered_map<size_t, Port*> ports;	// port number, registry entry
+	static std::unordered_map<std::string, Port*> paths;	// local path, registry entry
+
+	///////////////////////////////////////////////////
+	// name of a port's shared memory ring
+	static std::string ringName(size_t number) {
+		std::ostringstream ss;
+		ss << "SocketComm.port." << number;
+		return ss.str();
+	}
+
+	///////////////////////////////////////////////////
+	// name of a section a writer to a port's ring made, the
+	// reader opens it by this name
+	static std::string sectionName(size_t number, unsigned int writer, unsigned long long section) {
+		std::ostringstream ss;
+		ss << ringName(number) << ".section." << writer << "." << section;
+		return ss.str();
+	}
+	static volatile long sections;	// sections made by this process, numbers their names
+
+	///////////////////////////////////////////////////
+	// fixed part of a message in a shared memory ring, followed by its
+	// file name, then by its block sizes and bytes, unless those are in
+	// a section whose number is given
+	struct SharedFrame {
+		enum { ACK = 1, NAK = 2, OFFER = 4, DELTA = 8, SECTION = 16 };
+		unsigned int flags;
+		unsigned int blocks;	// number of data blocks
+		unsigned int nameLength;	// bytes of file name
+		unsigned int writer;	// process id of the writer
+		unsigned int replyPort;	// port the writer's channel listens on, 0 if none
+		unsigned int reserved;	// zero, aligns the fields below
+		unsigned long long traceId;
+		unsigned long long length;	// bytes of block data
+		unsigned long long section;	// number of the writer's section, see sectionName
+	};
+
+	///////////////////////////////////////////////////
+	// metric label naming a port
+	static std::string portLabel(size_t number) {
+		std::ostringstream ss;
+		ss << number;
+		return Metrics::label("port", ss.str());
+	}
+	static SRWLock portsLock;	// lookups share it, adding or claiming a port is exclusive
+
+	///////////////////////////////////////////////////
+	// find the registry entry of a port number or local path,
+	// creating it on first use
+	template <typename Key>
+	static Port* find(std::unordered_map<Key, Port*>& registry, const Key& key) {
+		portsLock.lockShared();
+		auto it = registry.find(key);
+		Port* p = (it == registry.end()) ? 0 : it->second;
+		portsLock.unlockShared();
+		if (p) return p;
+		portsLock.lockExclusive();
+		Port*& slot = registry[key];
+		if (!slot) slot = new Port(key);	// another channel may have added it meanwhile
+		p = slot;
+		portsLock.unlockExclusive();
+		return p;
+	}
+	static Port* port(size_t number) {
+		return find(ports, number);
+	}
+	static Port* port(const std::string& path) {
+		return find(paths, path);
+	}
+
+	///////////////////////////////////////////////////
+	// make the caller the only listener of a port
+	// return false if another channel already listens there
+	static bool claim(Port* p) {
+		portsLock.lockExclusive();
+		bool claimed = !p->claimed;
+		p->claimed = true;
+		portsLock.unlockExclusive();
+		return claimed;
+	}
 
 	BlockingQueue<MsgPair> sendQ;
+	BlockingQueue<MsgPair> failQ;	// messages that could not be delivered
+	Gauge& sendDepth;	// messages in sendQ, as last seen
+	static Gauge& reassembling;	// messages in MsgSet
+	static Histogram& blockLatency;	// microseconds to read and process one block
 
 	bool _enableACK;	// whether to enable ACK or not
+	bool _enableLog;	// whether to print progress messages
+	bool _enableChecksum;	// whether to checksum sent blocks
+	bool _enableCompression;	// whether to compress sent blocks
+	bool _enableDedup;	// whether to offer files by content hash first
+	bool _enableDelta;	// whether offers accept deltas against an older copy
+	bool _enableTrace;	// whether sent messages get trace ids
+	bool _enableSharedMemory;	// whether same-host peers are reached through shared memory
+	size_t _acceptors;	// threads accepting on the listen port
+	std::atomic<int> _priority;	// TokenBucket::Priority of this channel's sends, read by the send thread
+	SocketOptions _socketOptions;	// of sending sockets, and of a listener this channel creates
+	std::unordered_map<std::string, SocketOptions> peerOptions;	// by peer host, instead of _socketOptions
+	CSLock optionsLock;	// callers set peerOptions, the send thread reads them
+
+	///////////////////////////////////////////////////
+	// options of a connection to p
+	SocketOptions optionsFor(const Peer& p) {
+		optionsLock.lock();
+		auto it = peerOptions.find(p.host());
+		SocketOptions options = it == peerOptions.end() ? _socketOptions : it->second;
+		optionsLock.unlock();
+		return options;
+	}
+
+	///////////////////////////////////////////////////
+	// a sent message kept until newer ones push it out, a file
+	// loaded by fromFile() without its bytes
+	struct Sent {
+		Peer dest;	// where it was sent
+		Message msg;	// no blocks when source is set
+		std::string source;	// file read again to resend, empty if msg holds the bytes
+		std::vector<unsigned int> crcs;	// checksum of each block
+		size_t bytes;	// bytes held in msg
+		size_t resends;	// times resent after a NAK
+
+		Sent(MsgPair& sent, std::vector<unsigned int>& _crcs) :
+			dest(sent.first), resends(0) {
+			crcs.swap(_crcs);
+			Message& m = sent.second;
+			if (!m.source().empty() && m.isBinary() && !m.isOffer() && !m.isDelta()) {
+				source = m.source();
+				msg = Message(m.fileName());
+				msg.traceId() = m.traceId();
+			}
+			else
+				msg = std::move(m);
+			bytes = msg.length();
+		}
+		Sent(Sent&& s) : dest(s.dest), msg(std::move(s.msg)), source(std::move(s.source)), crcs(std::move(s.crcs)),
+			bytes(s.bytes), resends(s.resends) {}
+		Sent& operator=(Sent&& s) {
+			dest = s.dest;
+			msg = std::move(s.msg);
+			source.swap(s.source);
+			crcs.swap(s.crcs);
+			bytes = s.bytes;
+			resends = s.resends;
+			return *this;
+		}
+	};
+	std::deque<Sent> sent;	// oldest first
+	size_t sentBytes;	// bytes held by sent
+	CSLock sentLock;	// the send thread adds, client handlers resend
+
+	///////////////////////////////////////////////////
+	// keep a sent message for resending, unless it is a resend
+	// of a message still in the cache, or holds more than
+	// SENT_CACHE_BYTES on its own
+	void remember(MsgPair& msg, std::vector<unsigned int>& crcs) {
+		sentLock.lock();
+		bool known = false;
+		for (auto it = sent.begin(); it != sent.end() && !known; it++)
+			known = it->crcs == crcs && it->msg.fileName() == msg.second.fileName();
+		if (!known) {
+			Sent kept(msg, crcs);
+			if (kept.bytes <= SENT_CACHE_BYTES) {
+				while (!sent.empty() && (sent.size() >= SENT_CACHE || sentBytes + kept.bytes > SENT_CACHE_BYTES)) {
+					sentBytes -= sent.front().bytes;
+					sent.pop_front();
+				}
+				sentBytes += kept.bytes;
+				sent.push_back(std::move(kept));
+			}
+		}
+		sentLock.unlock();
+	}
+
+	///////////////////////////////////////////////////
+	// read a cached file again for a resend, false if its
+	// blocks no longer match the checksums sent
+	static bool reload(Message& msg, const std::string& source, const std::vector<unsigned int>& crcs) {
+		Message m;
+		m.fromFile(source);
+		m.traceId() = msg.traceId();
+		std::vector<unsigned int> now;
+		for (auto it = m.begin(); it != m.end(); it++)
+			now.push_back(CRC32C::compute(it->data(), it->size()));
+		msg = std::move(m);
+		return now == crcs;
+	}
+
+	///////////////////////////////////////////////////
+	// resend the cached message named by a NAK, or give up on it
+	// and report it through nextFailure()
+	void resend(const std::string& fileName, unsigned int crc) {
+		sentLock.lock();
+		auto it = sent.begin();
+		for (; it != sent.end(); it++) {
+			if (it->msg.fileName() == fileName &&
+				std::find(it->crcs.begin(), it->crcs.end(), crc) != it->crcs.end())
+				break;
+		}
+		if (it == sent.end()) {
+			sentLock.unlock();
+			log("NAK for "+ fileName +" which is no longer cached, cannot resend");
+			return;
+		}
+		MsgPair again(it->dest, it->msg);
+		std::string source = it->source;
+		std::vector<unsigned int> crcs;
+		if (!source.empty()) crcs = it->crcs;
+		bool giveUp = ++it->resends > MAX_RESENDS;
+		if (giveUp) {
+			sentBytes -= it->bytes;
+			sent.erase(it);
+		}
+		sentLock.unlock();
+		if (!source.empty() && !reload(again.second, source, crcs) && !giveUp) {
+			log("Cannot resend "+ fileName +", the file changed since it was sent");
+			failed(std::move(again));
+			return;
+		}
+		if (giveUp) {
+			log("Giving up on "+ fileName +", still corrupted after resending");
+			failed(std::move(again));
+			return;
+		}
+		log("Resending "+ fileName +" after a checksum failure");
+		if (!sendQ.tryEnQ(std::move(again)))
+			log("Send queue full, cannot resend "+ fileName);
+	}
+
+	///////////////////////////////////////////////////
+	// a file waiting for the answer to its offer
+	struct Offer {
+		std::string hash;	// content hash offered
+		MsgPair file;
+
+		Offer(const std::string& _hash, MsgPair&& _file) : hash(_hash), file(std::move(_file)) {}
+		Offer(Offer&& o) : hash(std::move(o.hash)), file(std::move(o.file)) {}
+		Offer& operator=(Offer&& o) {
+			hash.swap(o.hash);
+			std::swap(file, o.file);
+			return *this;
+		}
+	};
+	std::deque<Offer> offers;	// oldest first
+	CSLock offersLock;	// senders add, client handlers take answered ones
+
+	///////////////////////////////////////////////////
+	// the message to queue for a file: an offer of its content hash
+	// when dedup is on, the file itself otherwise
+	MsgPair outgoing(const Peer& p, Message msg) {
+		if (_enableTrace && msg.traceId() == 0 && !msg.isACK() && !msg.isNAK())
+			msg.traceId() = Trace::newId();
+		Trace::record(msg.traceId(), Trace::QUEUED);
+		if ((!_enableDedup && !_enableDelta) || !msg.isBinary() || msg.isACK() || msg.isNAK() || msg.isOffer() || msg.isDelta())
+			return MsgPair(p, std::move(msg));
+		std::string hash = ObjectStore::hash(msg);
+		Message offer(msg.fileName());
+		offer.isOffer() = true;
+		offer.traceId() = msg.traceId();	// the offer's round trip is part of the file's trip
+		offer.push(DataBlock("offer "+ hash + (_enableDelta ? " delta" : "")));
+		pend(hash, MsgPair(p, std::move(msg)));
+		return MsgPair(p, std::move(offer));
+	}
+
+	///////////////////////////////////////////////////
+	// keep a file until its offer is answered, giving up on the
+	// oldest one waiting if there are too many
+	void pend(const std::string& hash, MsgPair&& file) {
+		MsgPair stale;
+		bool evicted = false;
+		offersLock.lock();
+		if (offers.size() >= PENDING_OFFERS) {
+			stale = std::move(offers.front().file);
+			offers.pop_front();
+			evicted = true;
+		}
+		offers.push_back(Offer(hash, std::move(file)));
+		offersLock.unlock();
+		if (evicted) {
+			log("No answer to the offer of "+ stale.second.fileName() +", giving up on it");
+			failed(std::move(stale));
+		}
+	}
+
+	///////////////////////////////////////////////////
+	// message whose blocks hold body
+	static Message compose(const std::string& fileName, const std::string& body) {
+		Message m(fileName);
+		std::istringstream ss(body);
+		m.from(ss);
+		return m;
+	}
+
+	///////////////////////////////////////////////////
+	// take back the file offered under a hash
+	// return false if it is not waiting for an answer
+	bool withdraw(const std::string& hash, MsgPair& file) {
+		offersLock.lock();
+		auto it = offers.begin();
+		while (it != offers.end() && it->hash != hash)
+			it++;
+		bool found = it != offers.end();
+		if (found) {
+			file = std::move(it->file);
+			offers.erase(it);
+		}
+		offersLock.unlock();
+		return found;
+	}
+
+	///////////////////////////////////////////////////
+	// hash named by an offer we made, empty for any other message
+	static std::string offeredHash(Message& msg) {
+		if (!msg.isOffer() || msg.size() == 0) return "";
+		std::istringstream body(std::string(msg.begin()->data(), msg.begin()->size()));
+		std::string verb, hash;
+		body >> verb >> hash;
+		return verb == "offer" ? hash : "";
+	}
+
+	///////////////////////////////////////////////////
+	// report a message which could not be delivered, an offer is
+	// reported as the file it offered
+	void failed(MsgPair&& msg) {
+		std::string hash = offeredHash(msg.second);
+		MsgPair file;
+		if (!hash.empty() && withdraw(hash, file))
+			msg = std::move(file);
+		std::string host = msg.first.remoteHost();
+		if (!failQ.tryEnQ(std::move(msg)))
+			log("Failure queue full, dropping message for "+ host);
+	}
+
+	///////////////////////////////////////////////////
+	// answer an offer: "have" if the content is stored, signatures
+	// of an older copy if the sender takes deltas, "need" otherwise,
+	// sent back to the offer's sender
+	void answer(Message& offer, const std::string& hash, bool delta) {
+		const std::string& fileName = offer.fileName();
+		std::string body;
+		if (ObjectStore::link(hash, fileName)) {
+			log("File ["+ fileName +"] linked from the object store, no transfer needed");
+			body = "have "+ hash;
+		}
+		else {
+			std::ifstream old(ObjectStore::root() +"/"+ fileName, std::ios::in | std::ios::binary);
+			old.seekg(0, std::ios::end);
+			size_t size = old.good() ? (size_t)old.tellg() : 0;
+			if (delta && size >= DELTA_MIN_SIZE) {
+				size_t blockSize = Delta::blockSize(size);
+				old.seekg(0, std::ios::beg);
+				std::ostringstream head;
+				head << "delta " << hash << " " << blockSize << "\n";
+				body = head.str() + Delta::signatures(old, blockSize);
+			}
+			else
+				body = "need "+ hash;
+		}
+		Message m = compose(fileName, body);
+		m.isOffer() = true;
+		reply(offer, std::move(m));
+	}
+
+	///////////////////////////////////////////////////
+	// send the delta of an offered file against the receiver's
+	// copy, whose signatures follow the first line of body
+	void sendDelta(MsgPair&& file, const std::string& hash, const std::string& body) {
+		size_t line = body.find('\n');
+		std::istringstream head(body.substr(0, line));
+		std::string verb, ignored;
+		size_t blockSize = 0;
+		head >> verb >> ignored >> blockSize;
+		std::vector<Delta::Piece> pieces;	// the file's blocks, not copied
+		for (auto it = file.second.begin(); it != file.second.end(); it++) {
+			Delta::Piece piece = { it->data(), it->size() };
+			pieces.push_back(piece);
+		}
+		size_t size = file.second.length();
+		size_t sigStart = line == std::string::npos ? body.size() : line + 1;
+		std::string delta = blockSize == 0 || pieces.empty() ? "" :
+			Delta::encode(&pieces[0], pieces.size(), body.data() + sigStart, body.size() - sigStart, blockSize);
+		if (delta.empty() || delta.size() >= size) {	// no gain, send it whole
+			sendQ.enQ(std::move(file));
+			return;
+		}
+		std::ostringstream ss;
+		ss << hash << " " << size << "\n";
+		Message m = compose(file.second.fileName(), ss.str() + delta);
+		m.isDelta() = true;
+		std::ostringstream note;
+		note << "Sending delta of " << delta.size() << " bytes for " << size << " byte file [" << file.second.fileName() << "]";
+		log(note.str());
+		Peer dest = file.first;
+		pend(hash, std::move(file));	// kept until the receiver answers "have" or "need"
+		sendQ.enQ(MsgPair(dest, std::move(m)));
+	}
+
+	///////////////////////////////////////////////////
+	// handle an offer from a peer, or the peer's answer to ours
+	void offered(Message& msg) {
+		std::ostringstream ss;
+		msg.to(ss);
+		std::string body = ss.str();
+		std::istringstream head(body.substr(0, body.find('\n')));
+		std::string verb, hash, option;
+		head >> verb >> hash >> option;
+		MsgPair file;
+		if (verb == "offer")
+			answer(msg, hash, option == "delta");
+		else if (verb == "have" && withdraw(hash, file))
+			log("File ["+ msg.fileName() +"] is stored by the receiver, nothing more to send");
+		else if (verb == "need" && withdraw(hash, file))
+			sendQ.enQ(std::move(file));
+		else if (verb == "delta" && withdraw(hash, file))
+			sendDelta(std::move(file), hash, body);
+	}
+
+	///////////////////////////////////////////////////
+	// take a complete received message: an offer is handled by the
+	// channel, anything else is ACKed if asked and queued for listen()
+	void complete(Message&& msg, Port& p) {
+		if (msg.isOffer()) {
+			offered(msg);
+			return;
+		}
+		if (_enableACK && !msg.isACK()) {	// send an ACK for received message
+			Message ack(msg.fileName());
+			ack.isACK() = true;
+			// push one empty data block to message
+			ack.push(DataBlock());
+			reply(msg.replyHost(), msg.replyPort(), std::move(ack));
+		}
+		Trace::record(msg.traceId(), Trace::REASSEMBLED);
+		// blocks while the receive queue is full, which stops the
+		// reading thread and pushes back on the sender
+		p.q.enQ(std::move(msg));
+		p.depth.set((long long)p.q.size());
+	}
 	Peer defaultRemotePeer;	// default remote peer
 	std::string channelName;	// channel name
 
+	///////////////////////////////////////////////////
+	// answer a message from host: to the port its sender said it
+	// listens on, or to the default peer if it did not say
+	void reply(const std::string& host, size_t port, Message&& msg) {
+		if (!host.empty() && port != 0)
+			send(Peer(host, port), std::move(msg));
+		else
+			send(std::move(msg));
+	}
+
 	///////////////////////////////////////////////////
 	// ClientHandlerThread thread
 	// Hiding details from upper layer, thus I define it inside Channel
 	class ClientHandlerThread : public tthreadBase {
 		Socket s;	// socket
-		messageQ& q;	// message queue
+		Port& port;	// receive queue and its metrics
 		Channel& ch;
+		Peer peer;	// remote identity, resolved once at accept time
+		std::string peerName;	// peer.toString(), for logging
+		Counter* receivedBytes;	// metrics of the remote host
+		Counter* receivedMessages;
+		std::vector<char> packed;	// compressed block as received
+
+		///////////////////////////////////////////////////
+		// read a range of a handed over file into block, closing its
+		// handle, return false if it has fewer bytes than the block
+		static bool readHandle(HANDLE h, long long offset, DataBlock& block) {
+			LARGE_INTEGER start;
+			start.QuadPart = offset;
+			bool ok = ::SetFilePointerEx(h, start, NULL, FILE_BEGIN) != 0;
+			size_t done = 0;
+			while (ok && done < block.size()) {
+				size_t left = block.size() - done;
+				DWORD n = 0;
+				ok = ::ReadFile(h, block.data() + done, left > (1 << 30) ? (1 << 30) : (DWORD)left, &n, NULL) && n > 0;
+				done += n;
+			}
+			::CloseHandle(h);
+			return ok;
+		}
+
+		///////////////////////////////////////////////////
+		// read the data following a header into block, decoding it
+		// if it was compressed, return false if it could not be decoded
+		bool receive(HttpWrapper& wrapper, DataBlock& block) {
+			if (wrapper.fileHandle() != 0) {
+				// only a local peer can hand a handle into this process
+				if (peer.path.empty())
+					throw std::exception("File handle from a remote peer");
+				// taken out of the peer, so it is one of the peer's own
+				HANDLE h = s.take(wrapper.fileHandle());
+				if (h == NULL)
+					throw std::exception("File handle not held by the peer");
+				if (::GetFileType(h) != FILE_TYPE_DISK) {
+					::CloseHandle(h);	// the duplicate, which is ours
+					throw std::exception("File handle is not a file");
+				}
+				return readHandle(h, wrapper.rangeStart(), block);
+			}
+			size_t wire = wrapper.wireLength();
+			if (wrapper.contentEncoding().empty()) {
+				if (wire>0)
+					s.recvAll(block.data(), wire);
+				return true;
+			}
+			// the stream cannot be resynchronized past a block we cannot size
+			if (wrapper.contentEncoding() != HttpWrapper::ENCODING_LZ4)
+				throw std::exception("Unknown content encoding");
+			if (wire == 0 || wire > LZ4::bound(block.size()))
+				throw std::exception("Bad encoded block length");
+			packed.resize(wire);
+			s.recvAll(&packed[0], wire);
+			return LZ4::decompress(&packed[0], wire, block.data(), block.size());
+		}
 
 		///////////////////////////////////////////////////
 		// process received message
-		void processMsg(HttpWrapper& wrapper, const std::string& msgid) {
+		void processMsg(HttpWrapper& wrapper, const MsgId& msgid) {
 			// if this message is complete
 			if (wrapper.isAllMsgArrived() || wrapper.isACK()) {
-				if (ch.enableACK() && !wrapper.isACK()) {	// send an ACK for received message
-					Message ack(wrapper.fileName());
-					ack.isACK() = true;
-					// push one empty data block to message
-					ack.push(DataBlock());
-					ch.send(ack);
-				}
-				q.enQ(MsgSet[msgid]);
+				Message msg(std::move(MsgSet[msgid]));
 				MsgSet.erase(msgid);
+				if (!msg.isOffer())
+					receivedMessages->add();
+				ch.complete(std::move(msg), port);
 			}
 		}
 
 		///////////////////////////////////////////////////
 		// read message from socket
-		void readMsg(const std::string& header, Peer& p) {
+		void readMsg(const std::string& header) {
 			// use HTTP wrapper to read the header
 			HttpWrapper wrapper;
 			if (!wrapper.readHeader(header)) {
 				ch.log("Mal-formatted header message received! Header:\n" + header);
 				return;
 			}
-			std::string msgid(p.toString() +'/'+ wrapper.fileName());
+			size_t len = wrapper.isACK() ? 0 : (size_t)(wrapper.rangeEnd() - wrapper.rangeStart()+1);
+			if (wrapper.isNAK()) {	// the peer asks for a resend
+				DataBlock block(len);
+				receive(wrapper, block);
+				std::istringstream body(std::string(block.data(), len));
+				unsigned int crc = 0;
+				body >> std::hex >> crc;
+				ch.resend(wrapper.fileName(), crc);
+				return;
+			}
+			MsgId msgid(peer.key(), wrapper.fileName());
 			if (wrapper.isNewMsg()) {  // a new message is created
 				MsgSet[msgid] = Message();
 				wrapper.unwrap(MsgSet[msgid]);
+				MsgSet[msgid].replyHost() = peer.remote;	// the port is the sender's word, the address is not
+				Trace::record(wrapper.traceId(), Trace::RECEIVED);
 			}
+			// read one block according to the header info
+			DataBlock block(len);	// receive or decompress straight into the block
+			bool decoded = receive(wrapper, block);
 			if (MsgSet.find(msgid) == MsgSet.end()) {
-				// first block of header information missing, drop data
+				// first block missing, or message dropped after a bad checksum
 				return;
 			}
-			// then read one block according to the header info
-			size_t len = wrapper.rangeEnd() - wrapper.rangeStart()+1;
-			if (len>0 && !wrapper.isACK()) {
-				char * buff = new char[len];
-				s.recvAll(buff, len);
-				MsgSet[msgid].push(DataBlock(buff, len));
-				delete buff;
+			if (!decoded && !wrapper.hasChecksum()) {
+				ch.log("Unreadable block in "+ wrapper.fileName() +" from "+ peerName +", message dropped");
+				MsgSet.erase(msgid);
+				return;
 			}
+			if (!decoded || (wrapper.hasChecksum() && CRC32C::compute(block.data(), len) != wrapper.checksum())) {
+				ch.log("Checksum mismatch in "+ wrapper.fileName() +" from "+ peerName +", asking for a resend");
+				MsgSet.erase(msgid);
+				Message nak(wrapper.fileName());
+				nak.isNAK() = true;
+				std::ostringstream body;
+				body << std::hex << wrapper.checksum();
+				nak.push(DataBlock(body.str()));
+				ch.reply(peer.remote, wrapper.replyPort(), std::move(nak));
+				return;
+			}
+			receivedBytes->add(len);
+			if (len>0)
+				MsgSet[msgid].push(std::move(block));
 			processMsg(wrapper, msgid);
 		}
 
@@ -198,9 +1098,11 @@ class Channel {
 						::Sleep(1500);
 						continue;
 					}
-					Peer p(s);
-					ch.log(">> Data block received from "+ p.toString() +". Header:\n  "+ header);
-					readMsg(header, p);
+					ch.log(">> Data block received from "+ peerName +". Header:\n  "+ header);
+					__int64 start = HRTimer::HiResTimer::Now();
+					readMsg(header);
+					blockLatency.record(HRTimer::HiResTimer::ToNanoseconds(HRTimer::HiResTimer::Now() - start) / 1000);
+					reassembling.set((long long)MsgSet.size());
 				}
 			}
 			catch (std::exception& ex) {
@@ -212,14 +1114,21 @@ class Channel {
 		}
 	public:
 		// constructor
-		ClientHandlerThread(Socket _s, messageQ& _q, Channel& _ch) : s(_s), q(_q), ch(_ch) {}
+		ClientHandlerThread(Socket _s, Port& p, Channel& _ch) : s(_s), port(p), ch(_ch) {
+			peer.fill(s);
+			peerName = peer.toString();
+			// by address only, the remote port changes with every connection
+			std::string host = Metrics::label("peer", peer.host());
+			receivedBytes = &Metrics::counter("comm_received_bytes_total", host);
+			receivedMessages = &Metrics::counter("comm_received_messages_total", host);
+		}
 	};
 
 	///////////////////////////////////////////////////
 	// listener thread
 	// Hiding details from upper layer, thus I define it inside Channel
 	class ListenThread : public threadBase {
-		messageQ* q;
+		Port* port;
 		SocketListener* sl;
 		Channel& ch;
 
@@ -229,7 +1138,10 @@ class Channel {
 			try {
 				while (1) {
 					SOCKET s = sl->waitForConnect();
-					ClientHandlerThread* pCht = new ClientHandlerThread(s, *q, ch);
+					if (s == INVALID_SOCKET) break;	// listener stopped by Channel::close
+					ClientHandlerThread* pCht = new ClientHandlerThread(s, *port, ch);
+					ch.place(*pCht, "recv");
+					pCht->affinity() = affinity();	// served where it was accepted
 					pCht->start();
 				}
 			}
@@ -243,72 +1155,733 @@ class Channel {
 	public:
 		///////////////////////////////////////////////////
 		// constructor
-		ListenThread(size_t port, Channel& _ch) : ch(_ch) {
-			// initialize with specific port
-			if (receiveQ.find(port) == receiveQ.end())
-				receiveQ[port] = messageQ();
-			q = &receiveQ[port];
-			if (receiveSocket.find(port) == receiveSocket.end())
-				receiveSocket[port] = new SocketListener(port);
-			sl = receiveSocket[port];
+		ListenThread(Port& p, Channel& _ch) : ch(_ch) {
+			// initialize with specific port, claimed by this channel,
+			// whose listener serve() has created
+			port = &p;
+			sl = p.listener;
 		}
 	};
 
 	///////////////////////////////////////////////////
-	// sender thread
-	class SendThread : public threadBase
+	// shared memory listener thread
+	// reads the messages same-host senders write to a port's ring
+	class SharedListenThread : public threadBase {
+		Port& port;
+		Channel& ch;
+		Counter& receivedBytes;
+		Counter& receivedMessages;
+
+		///////////////////////////////////////////////////
+		// rebuild the blocks of a message from their sizes and bytes
+		// return false if they do not fit in len bytes
+		static bool unpack(const char* p, size_t len, unsigned int blocks, Message& msg) {
+			size_t head = blocks * sizeof(unsigned int);
+			if (len < head) return false;
+			const char* data = p + head;
+			size_t left = len - head;
+			for (unsigned int i = 0; i < blocks; i++) {
+				unsigned int size;
+				::memcpy(&size, p + i * sizeof(size), sizeof(size));
+				if (size > left) return false;
+				msg.push(DataBlock(data, size));
+				data += size;
+				left -= size;
+			}
+			return true;
+		}
+
+		///////////////////////////////////////////////////
+		// read one frame, releasing it from the ring
+		// return false if it is malformed
+		bool read(const char* f, size_t len, Message& msg, SharedFrame& frame) {
+			SharedRing& ring = *port.ring;
+			if (len < sizeof(frame)) {
+				ring.release();
+				return false;
+			}
+			::memcpy(&frame, f, sizeof(frame));
+			size_t rest = len - sizeof(frame);
+			if (rest < frame.nameLength) {
+				ring.release();
+				return false;
+			}
+			msg.fileName().assign(f + sizeof(frame), frame.nameLength);
+			msg.isACK() = (frame.flags & SharedFrame::ACK) != 0;
+			msg.isNAK() = (frame.flags & SharedFrame::NAK) != 0;
+			msg.isOffer() = (frame.flags & SharedFrame::OFFER) != 0;
+			msg.isDelta() = (frame.flags & SharedFrame::DELTA) != 0;
+			msg.traceId() = frame.traceId;
+			msg.replyHost() = "127.0.0.1";	// the writer is on this host
+			msg.replyPort() = frame.replyPort;
+			Trace::record(frame.traceId, Trace::RECEIVED);
+			if (!(frame.flags & SharedFrame::SECTION)) {
+				bool ok = unpack(f + sizeof(frame) + frame.nameLength, rest - frame.nameLength, frame.blocks, msg);
+				ring.release();
+				return ok;
+			}
+			// opened by name, never by a handle value from the frame, and
+			// before the release, which lets the writer close the section
+			size_t size = (size_t)(frame.blocks * sizeof(unsigned int) + frame.length);
+			SharedSection section;
+			bool opened = section.open(sectionName(port.number, frame.writer, frame.section), size);
+			ring.release();
+			return opened && unpack(section.data(), size, frame.blocks, msg);
+		}
+
+		///////////////////////////////////////////////////
+		// main part, runs until the ring is closed and drained
+		void run() {
+			try {
+				size_t len = 0;
+				const char* f;
+				while ((f = port.ring->peek(len, INFINITE)) != 0) {
+					Message msg;
+					SharedFrame frame;
+					if (!read(f, len, msg, frame)) {
+						ch.log("Malformed message received through shared memory, dropped");
+						continue;
+					}
+					ch.log(">> Message ["+ msg.fileName() +"] received through shared memory");
+					receivedBytes.add((long long)frame.length);
+					if (!msg.isOffer())
+						receivedMessages.add();
+					ch.complete(std::move(msg), port);
+				}
+			}
+			catch (std::exception& ex) {
+				ch.log("Reading shared memory error: "+ std::string(ex.what()));
+			}
+			catch (...) {
+				ch.log("Reading shared memory error");
+			}
+		}
+	public:
+		// constructor
+		SharedListenThread(Port& p, Channel& _ch) : port(p), ch(_ch),
+			receivedBytes(Metrics::counter("comm_received_bytes_total", Metrics::label("peer", "shm"))),
+			receivedMessages(Metrics::counter("comm_received_messages_total", Metrics::label("peer", "shm"))) {}
+	};
+
+	///////////////////////////////////////////////////
+	// let same-host senders reach a port through shared memory
+	void listenShared(Port& p) {
+		if (!p.ring) p.ring = new SharedRing;
+		if (!p.ring->create(ringName(p.number), SHM_RING_BYTES)) {
+			log("Shared memory unavailable, same-host peers will use TCP");
+			return;
+		}
+		p.sharedThread = new SharedListenThread(p, *this);
+		place(*p.sharedThread, "shm");
+		p.sharedThread->start();
+	}
+
+	///////////////////////////////////////////////////
+	// listen on a port or path, calling f for every message
+	// received, until close()
+	template <typename CallBackF>
+	void serve(Port* p, CallBackF& f) {
+		if (!claim(p)) return;
+		try {
+			std::ostringstream ss;
+			if (p->path.empty())
+				ss << "Start listening on port "<< p->number;
+			else
+				ss << "Start listening on "<< p->path;
+			log(ss.str());
+			size_t acceptors = _acceptors > 0 ? _acceptors : 1;
+			int backLog = acceptors > 1 ? SOMAXCONN : 10;
+			if (!p->listener)
+				p->listener = p->path.empty() ? new SocketListener((int)p->number, backLog, _socketOptions) : new SocketListener(p->path, backLog);
+			listenPort = p;
+			answerPort.store(p->path.empty() ? (unsigned int)p->number : 0);
+			for (size_t i = 0; i < acceptors; i++) {
+				ListenThread* t = new ListenThread(*p, *this);
+				if (acceptors == 1)
+					place(*t, "listen");
+				else {
+					std::ostringstream role;
+					role << "accept" << i;
+					place(*t, role.str());
+					t->affinity() = acceptCPU(i);
+				}
+				p->threads.push_back(t);
+				t->start();
+			}
+			size_t count = 0;
+			if (_enableSharedMemory && p->path.empty())	// a local path is on this host already
+				listenShared(*p);
+			Histogram& callbackLatency = Metrics::histogram("comm_callback_us", p->label);
+			std::vector<Message> batch;
+			while (p->q.deQBatch(batch, QUEUE_BATCH) > 0) {	// monitor the receive Q
+				p->depth.set((long long)p->q.size());
+				for (auto it = batch.begin(); it != batch.end(); it++) {
+					count++;
+					std::ostringstream os;
+					os << "Message#" << count << " is received!";
+					log(os.str());
+					// now call back
+					unsigned long long id = it->traceId();	// the callback may move the message away
+					Trace::record(id, Trace::DELIVERED);
+					__int64 start = HRTimer::HiResTimer::Now();
+					f(*it);
+					callbackLatency.record(HRTimer::HiResTimer::ToNanoseconds(HRTimer::HiResTimer::Now() - start) / 1000);
+					Trace::record(id, Trace::HANDLED);
+				}
+			}
+			log("Receive queue closed, stopped listening");
+		}
+		catch(std::exception& ex) {
+			log("Listen process error: "+ std::string(ex.what()));
+		}
+		catch(...)
+		{
+			log("Listen process error.");
+		}
+	}
+
+	///////////////////////////////////////////////////
+	// sending thread of one peer, delivers the groups of messages
+	// the send thread hands it, so a peer slow to connect holds up
+	// only its own messages
+	class PeerThread : public threadBase
 	{
+		typedef std::shared_ptr<std::vector<MsgPair>> Group;
 		Channel& ch;
 		Socket s;
+		BatchPolicy& policy;	// the send thread's
+		ConnectPolicy& connect;	// the send thread's, given to s before each connect
+		BlockingQueue<Group> groups;	// waiting to be delivered, oldest first
+		std::atomic<bool> busy;	// delivering a group
+		std::atomic<bool> unreachable;	// the last connect failed
+		std::string out;	// bytes waiting to be written with one send
+		std::vector<char> packed;	// compressed copy of the current block
+		size_t writes;	// sends made on the current connection
+		std::unordered_map<size_t, SharedRing*> rings;	// rings of same-host ports, by port
+		struct Lent {
+			unsigned long end;	// ring position after the frame naming the section
+			SharedSection* section;
+		};
+		std::unordered_map<size_t, std::deque<Lent>> lent;	// sections kept until read, by port
+		std::string localIP;	// this host's address, looked up on first use
+		std::vector<unsigned int> sizes;	// block sizes of the message being written
+		std::vector<SharedRing::Slice> slices;	// pieces of the frame being written
+		TokenBucket& limit;	// paces this channel's sends, the send thread's
+		TokenBucket* peerLimit;	// of the peer being sent to, null if none
+		Counter* throttled;	// micros waited for tokens, of the peer being sent to
 
 		///////////////////////////////////////////////////
-		// send message
-		void sendMsg(MsgPair& msg) {
+		// wait until the channel, the peer and the process may send
+		// bytes more; control messages never wait
+		void throttle(size_t bytes, bool control) {
+			TokenBucket::Priority own = control ? TokenBucket::INTERACTIVE : TokenBucket::BULK;
+			long long waited = limit.take(bytes, own);
+			if (peerLimit)
+				waited += peerLimit->take(bytes, own);
+			waited += TokenBucket::global().take(bytes, control ? TokenBucket::INTERACTIVE : ch.priority());
+			if (waited > 0)
+				throttled->add(waited);
+		}
+
+		///////////////////////////////////////////////////
+		// does host name this host
+		bool sameHost(const std::string& host) {
+			std::string ip = host;
+			try {
+				ip = s.System().resolve(host);
+				if (localIP.empty())
+					localIP = s.System().getLocalIP();
+			}
+			catch (...) {}
+			return ip.compare(0, 4, "127.") == 0 || ip == localIP;
+		}
+
+		///////////////////////////////////////////////////
+		// the open ring of a same-host peer's port, null if the peer
+		// is remote, does not listen on shared memory, or its
+		// listener died without closing the ring
+		SharedRing* sharedRing(const Peer& dest) {
+			if (!ch.enableSharedMemory() || !dest.path.empty() || !sameHost(dest.remote)) return 0;
+			SharedRing*& ring = rings[dest.rport];
+			if (ring && ring->isOpen()) {
+				reclaim(dest.rport, *ring);
+				return ring;
+			}
+			if (!ring) ring = new SharedRing;
+			bool opened = ring->open(ringName(dest.rport));
+			reclaim(dest.rport, *ring);	// a new reader, or none, reads no old frame
+			return opened ? ring : 0;
+		}
+
+		///////////////////////////////////////////////////
+		// close the sections written to a port whose frames its
+		// reader released
+		void reclaim(size_t port, SharedRing& ring) {
+			std::deque<Lent>& q = lent[port];
+			while (!q.empty() && ring.consumed(q.front().end)) {
+				delete q.front().section;
+				q.pop_front();
+			}
+		}
+
+		///////////////////////////////////////////////////
+		// write one message to a ring, its blocks in a section of
+		// their own if the message is too big for the ring
+		bool writeShared(MsgPair& msg, SharedRing& ring) {
+			Message& m = msg.second;
+			SharedFrame frame;
+			frame.flags = (m.isACK() ? SharedFrame::ACK : 0) | (m.isNAK() ? SharedFrame::NAK : 0)
+				| (m.isOffer() ? SharedFrame::OFFER : 0) | (m.isDelta() ? SharedFrame::DELTA : 0);
+			frame.blocks = (unsigned int)m.size();
+			frame.nameLength = (unsigned int)m.fileName().size();
+			frame.writer = (unsigned int)::GetCurrentProcessId();
+			frame.replyPort = ch.answerPort.load();
+			frame.reserved = 0;
+			frame.traceId = m.traceId();
+			frame.length = m.length();
+			frame.section = 0;
+			sizes.clear();
+			for (auto it = m.begin(); it != m.end(); it++)
+				sizes.push_back((unsigned int)it->size());
+			size_t payload = sizes.size() * sizeof(unsigned int) + m.length();
+			slices.clear();
+			SharedRing::Slice head = { (const char*)&frame, sizeof(frame) };
+			SharedRing::Slice name = { m.fileName().data(), m.fileName().size() };
+			slices.push_back(head);
+			slices.push_back(name);
+			if (sizeof(frame) + name.size + payload <= SHM_INLINE_MAX) {
+				if (!sizes.empty()) {
+					SharedRing::Slice table = { (const char*)&sizes[0], sizes.size() * sizeof(unsigned int) };
+					slices.push_back(table);
+				}
+				for (auto it = m.begin(); it != m.end(); it++) {
+					SharedRing::Slice block = { it->data(), it->size() };
+					slices.push_back(block);
+				}
+				return ring.write(&slices[0], slices.size(), SHM_WRITE_TIMEOUT);
+			}
+			// the ring carries only the number of the section, which is
+			// kept until the reader released the frame
+			frame.section = (unsigned long long)::InterlockedIncrement(&sections);
+			std::unique_ptr<SharedSection> section(new SharedSection);
+			if (!section->create(sectionName(msg.first.rport, frame.writer, frame.section), payload)) return false;
+			char* p = section->data();
+			if (!sizes.empty())
+				::memcpy(p, &sizes[0], sizes.size() * sizeof(unsigned int));
+			p += sizes.size() * sizeof(unsigned int);
+			for (auto it = m.begin(); it != m.end(); it++) {
+				::memcpy(p, it->data(), it->size());
+				p += it->size();
+			}
+			frame.flags |= SharedFrame::SECTION;
+			if (!ring.write(&slices[0], slices.size(), SHM_WRITE_TIMEOUT)) return false;
+			Lent kept = { ring.written(), section.release() };
+			lent[msg.first.rport].push_back(kept);
+			return true;
+		}
+
+		///////////////////////////////////////////////////
+		// write a group of messages for a same-host peer to its ring
+		// return how many were written, the rest are left for TCP
+		size_t deliverShared(std::vector<MsgPair*>& group, SharedRing& ring, const std::string& peerLabel) {
+			Counter& sentMessages = Metrics::counter("comm_sent_messages_total", peerLabel);
+			Counter& sentBytes = Metrics::counter("comm_sent_bytes_total", peerLabel);
+			size_t sent = 0;
+			for (auto it = group.begin(); it != group.end(); it++, sent++) {
+				unsigned long long id = (*it)->second.traceId();
+				Trace::record(id, Trace::CONNECTED);
+				Trace::record(id, Trace::SENDING);
+				if (!writeShared(**it, ring)) break;
+				sentMessages.add();
+				sentBytes.add((long long)(*it)->second.length());
+			}
+			std::ostringstream ss;
+			ss << sent << " message(s) written to shared memory of port " << group.front()->first.rport;
+			ch.log(ss.str());
+			return sent;
+		}
+
+		///////////////////////////////////////////////////
+		// write all buffered bytes
+		bool flush() {
+			if (out.empty()) return true;
+			bool ok = s.sendAll(out.data(), out.size());
+			out.clear();
+			writes++;
+			return ok;
+		}
+
+		///////////////////////////////////////////////////
+		// open the file a message was loaded from, to be handed over
+		// to the local peer, INVALID_HANDLE_VALUE if it cannot be
+		// and its bytes must be sent
+		static HANDLE openSource(Message& m) {
+			if (m.source().empty() || m.length() == 0 || !m.isBinary() || m.isOffer() || m.isDelta()) return INVALID_HANDLE_VALUE;
+			HANDLE h = ::CreateFileA(m.source().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+				NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+			if (h == INVALID_HANDLE_VALUE) return h;
+			LARGE_INTEGER size;
+			if (!::GetFileSizeEx(h, &size) || (unsigned long long)size.QuadPart != m.length()) {	// changed since loaded
+				::CloseHandle(h);
+				return INVALID_HANDLE_VALUE;
+			}
+			return h;
+		}
+
+		///////////////////////////////////////////////////
+		// lend the local peer a copy of an open file's handle, return
+		// its value here, 0 if it could not be copied; the peer takes
+		// the copy out of this process, which closes it here
+		static unsigned long long lend(HANDLE file) {
+			HANDLE copy = NULL;
+			if (!::DuplicateHandle(::GetCurrentProcess(), file, ::GetCurrentProcess(), &copy, 0, FALSE, DUPLICATE_SAME_ACCESS))
+				return 0;
+			return (unsigned long long)(ULONG_PTR)copy;
+		}
+
+		///////////////////////////////////////////////////
+		// send a file as ranges of at most HANDOVER_RANGE, each a
+		// header naming a handle of its own, so the receiver reads
+		// a bounded block per range; handed is false if not even
+		// the first range could be handed over
+		bool sendHandles(MsgPair& msg, HttpWrapper& wrapper, HANDLE file, bool& handed) {
+			size_t length = msg.second.length();
+			handed = false;
+			if (s.peerProcessId() == 0) return false;	// the peer could not take a handle
+			for (size_t start = 0; start < length; start += HANDOVER_RANGE) {
+				if ((wrapper.fileHandle() = lend(file)) == 0) return false;
+				handed = true;
+				wrapper.rangeStart() = (long long)start;
+				wrapper.rangeEnd() = (long long)(length - start > HANDOVER_RANGE ? start + HANDOVER_RANGE : length) - 1;
+				out.append(wrapper.writeHeader());
+				// on failure the copy stays open: the peer may have taken
+				// it already, and its value may since name another handle
+				if (!flush()) return false;
+			}
+			return true;
+		}
+
+		///////////////////////////////////////////////////
+		// buffer one message, writing whenever maxBytes are buffered
+		// crcs receives the checksum of each block, if checksums are on
+		bool sendMsg(MsgPair& msg, std::vector<unsigned int>& crcs) {
 			HttpWrapper wrapper;
 			size_t range = 0;
+			Trace::record(msg.second.traceId(), Trace::SENDING);
 			wrapper.wrap(msg.second);
+			bool control = msg.second.isACK() || msg.second.isNAK();
+			wrapper.replyPort() = control ? 0 : ch.answerPort.load();	// nobody answers a control message
+			HANDLE file = control || msg.first.path.empty() ? INVALID_HANDLE_VALUE : openSource(msg.second);
+			if (file != INVALID_HANDLE_VALUE) {	// headers only, no bytes follow
+				bool handed = false;
+				bool ok = sendHandles(msg, wrapper, file, handed);
+				::CloseHandle(file);
+				if (handed) return ok;
+				wrapper.fileHandle() = 0;	// the peer takes no handles, send the bytes
+			}
+			wrapper.hasChecksum() = ch.enableChecksum() && !control;
+			bool compress = ch.enableCompression() && !control;
 			for (auto it = msg.second.begin(); it != msg.second.end(); it++) {
 				// calculate current content range
 				wrapper.rangeStart() = range;
 				wrapper.rangeEnd() = (range += it->size()) -1;
 				if (wrapper.rangeEnd() < wrapper.rangeStart()) wrapper.rangeEnd() = wrapper.rangeStart();	// happens when this is an ACK msg
-				std::string& header = it->header() = wrapper.writeHeader();
-				size_t len = header.length() + it->size();
-				char * buff = new char[len];
-				char * data = it->data();
-				for (size_t i=0; i<header.length(); i++)
-					buff[i] = header[i];
-				for (size_t i = header.length(); i<len; i++)
-					buff[i] = data[i-header.length()];
-				if (!s.sendAll(buff, len)) {	// unable to send all data
+				if (wrapper.hasChecksum())
+					crcs.push_back(wrapper.checksum() = CRC32C::compute(it->data(), it->size()));
+				const char* body = it->data();
+				size_t bodyLen = it->size();
+				wrapper.contentEncoding().clear();
+				if (compress && bodyLen >= COMPRESS_MIN_BLOCK) {
+					// room for one byte less than the block, so a block
+					// which does not shrink is refused and sent raw
+					packed.resize(bodyLen);
+					size_t n = LZ4::compress(body, bodyLen, &packed[0], bodyLen - 1);
+					if (n > 0) {
+						wrapper.contentEncoding() = HttpWrapper::ENCODING_LZ4;
+						wrapper.encodedLength() = (int)n;
+						body = &packed[0];
+						bodyLen = n;
+					}
+				}
+				throttle(bodyLen, control);
+				out.append(it->header() = wrapper.writeHeader());
+				if (bodyLen >= policy.maxBytes) {
+					// a large block goes out behind what is buffered, no copy,
+					// one gather send when IoEngine runs
+					IoBuffer pieces[] = { { out.data(), out.size() }, { body, bodyLen } };
+					bool ok = s.sendAll(pieces, 2);
+					out.clear();
+					writes++;
+					if (!ok) return false;
+					continue;
+				}
+				if (bodyLen > 0)
+					out.append(body, bodyLen);
+				if (out.size() >= policy.maxBytes && !flush()) return false;
+			}
+			return true;
+		}
+
+		///////////////////////////////////////////////////
+		// connect once, send a group of messages for the same peer
+		// and disconnect
+		void deliver(std::vector<MsgPair*>& group) {
+			const Peer& dest = group.front()->first;
+			std::string peerLabel = Metrics::label("peer", dest.host());
+			SharedRing* ring = sharedRing(dest);
+			if (ring) {
+				size_t sent = deliverShared(group, *ring, peerLabel);
+				if (sent == group.size()) return;
+				ch.log("Shared memory write failed, sending the rest by TCP");
+				group.erase(group.begin(), group.begin() + sent);
+			}
+			peerLimit = TokenBucket::findPeer(dest.host());
+			throttled = &Metrics::counter("comm_send_throttled_us_total", peerLabel);
+			__int64 start = HRTimer::HiResTimer::Now();
+			s.options() = ch.optionsFor(dest);
+			s.connectPolicy() = connect;
+			bool connected = dest.path.empty() ? s.connect(dest.remote, dest.rport) : s.connectLocal(dest.path);
+			unreachable = !connected;
+			if (!connected) {	// connect to remote peer
+				Metrics::counter("comm_connect_failures_total", peerLabel).add();
+				// report failure and move on, an open circuit makes this fast
+				std::string host = dest.remoteHost();
+				ch.log("Couldn't connect to "+ host);
+				for (auto it = group.begin(); it != group.end(); it++)
+					ch.failed(std::move(**it));
+				return;
+			}
+			Metrics::histogram("comm_connect_us", peerLabel).record(
+				HRTimer::HiResTimer::ToNanoseconds(HRTimer::HiResTimer::Now() - start) / 1000);
+			for (auto it = group.begin(); it != group.end(); it++)
+				Trace::record((*it)->second.traceId(), Trace::CONNECTED);
+			Counter& sentMessages = Metrics::counter("comm_sent_messages_total", peerLabel);
+			Counter& sentBytes = Metrics::counter("comm_sent_bytes_total", peerLabel);
+			Peer link(s);
+			ch.log("Connected to "+ link.toString());
+			bool corked = s.options().cork && dest.path.empty() && s.cork(true);
+			writes = 0;
+			size_t sent = 0;
+			std::vector<unsigned int> crcs;
+			for (auto it = group.begin(); it != group.end(); it++, sent++) {
+				crcs.clear();
+				if (!sendMsg(**it, crcs)) {	// unable to send all data
 					ch.log("Bad status in sending thread");
-					return;
+					out.clear();
+					for (auto rest = it; rest != group.end(); rest++)
+						ch.failed(std::move(**rest));	// this and the unsent rest of the group
+					break;
 				}
-				ch.log("<< Data block sent to "+ msg.first.toString() +". Header: \n  "+ header);
-				delete buff;
+				sentMessages.add();
+				sentBytes.add((long long)(*it)->second.length());
+				if (!crcs.empty())
+					ch.remember(**it, crcs);	// kept in case the peer NAKs it
 			}
+			out.append("quit\n");
+			flush();
+			if (corked)
+				s.cork(false);	// push out the last partial segment
+			s.disconnect();	// disconnect after every batch
+			std::ostringstream ss;
+			ss << sent << " message(s) sent in " << writes << " write(s)! Disconnected with " << link.toString();
+			ch.log(ss.str());
 		}
 
 		///////////////////////////////////////////////////
-		// main part
+		// main part, delivers groups until stopped and drained
+		// a group that throws is logged, and the thread goes on, so
+		// posts to it never wait on a thread that is gone
+		void run() {
+			Group group;
+			std::vector<MsgPair*> pointers;
+			while (groups.deQFor(group, INFINITE)) {
+				busy = true;
+				pointers.clear();
+				for (auto it = group->begin(); it != group->end(); it++)
+					pointers.push_back(&*it);
+				try {
+					deliver(pointers);
+				}
+				catch (std::exception& ex) {
+					ch.log("Sending data block error: "+ std::string(ex.what()));
+				}
+				catch (...) {
+					ch.log("Sending received data block error");
+				}
+				group.reset();
+				busy = false;
+			}
+		}
+	public:
+		///////////////////////////////////////////////////
+		// constructor
+		PeerThread(Channel& _ch, TokenBucket& _limit, BatchPolicy& _policy, ConnectPolicy& _connect) :
+			ch(_ch), policy(_policy), connect(_connect), busy(false), unreachable(false), writes(0), limit(_limit), peerLimit(0), throttled(0) {}
+		~PeerThread() {
+			for (auto it = rings.begin(); it != rings.end(); it++)
+				delete it->second;
+			for (auto it = lent.begin(); it != lent.end(); it++)
+				for (auto l = it->second.begin(); l != it->second.end(); l++)
+					delete l->section;
+		}
+
+		///////////////////////////////////////////////////
+		// queue a group, waiting up to milliseconds for room
+		// return false if there was none, the group is still the caller's
+		bool post(const Group& group, DWORD milliseconds) {
+			return groups.enQFor(group, milliseconds);
+		}
+
+		///////////////////////////////////////////////////
+		// deliver what is queued, then exit
+		void stop() {
+			groups.close();
+		}
+
+		///////////////////////////////////////////////////
+		// nothing queued and nothing being delivered
+		bool idle() {
+			return !busy && groups.size() == 0;
+		}
+
+		///////////////////////////////////////////////////
+		// did the last connect to the peer fail
+		bool failing() {
+			return unreachable;
+		}
+
+		///////////////////////////////////////////////////
+		// limit the groups waiting, posting waits while it is reached
+		void backlog(size_t highWater, size_t lowWater) {
+			groups.setLimits(highWater, lowWater);
+		}
+	};
+
+	///////////////////////////////////////////////////
+	// sender thread
+	// collects queued messages, groups them by peer and hands each
+	// group to the peer's own PeerThread, started on first use and
+	// stopped once idle for PEER_IDLE_MILLIS
+	class SendThread : public threadBase
+	{
+		typedef std::shared_ptr<std::vector<MsgPair>> Group;
+		struct Worker {
+			PeerThread* thread;
+			DWORD lastPost;	// tick count of the last group posted to it
+			Worker() : thread(0), lastPost(0) {}
+		};
+		Channel& ch;
+		BatchPolicy policy;
+		ConnectPolicy connect;	// given to every peer's socket
+		TokenBucket limit;	// paces this channel's sends, over all its peers
+		std::unordered_map<std::string, Worker> workers;	// by Peer::remoteHost()
+
+		///////////////////////////////////////////////////
+		// wait for queued messages, then linger up to lingerMicros,
+		// sleeping on the queue, for more, until maxMessages or
+		// maxBytes are collected
+		// return how many were collected, 0 once the queue is closed
+		size_t collect(std::vector<MsgPair>& batch) {
+			if (ch.sendQ.deQBatch(batch, QUEUE_BATCH) == 0) return 0;
+			ch.sendDepth.set((long long)ch.sendQ.size());
+			for (auto it = batch.begin(); it != batch.end(); it++)
+				Trace::record(it->second.traceId(), Trace::DEQUEUED);
+			if (policy.lingerMicros == 0 || policy.maxMessages <= 1) return batch.size();
+			size_t bytes = 0;
+			for (auto it = batch.begin(); it != batch.end(); it++)
+				bytes += it->second.length();
+			__int64 deadline = HRTimer::HiResTimer::Now() +
+				HRTimer::HiResTimer::Frequency() * policy.lingerMicros / 1000000;
+			__int64 frequency = HRTimer::HiResTimer::Frequency();
+			MsgPair more;
+			while (batch.size() < policy.maxMessages && bytes < policy.maxBytes) {
+				__int64 left = deadline - HRTimer::HiResTimer::Now();
+				if (left <= 0) break;
+				// sleep until a message arrives, rounded up to whole millisecs
+				DWORD millis = (DWORD)((left * 1000 + frequency - 1) / frequency);
+				if (!ch.sendQ.deQFor(more, millis)) break;
+				bytes += more.second.length();
+				Trace::record(more.second.traceId(), Trace::DEQUEUED);
+				batch.push_back(std::move(more));
+			}
+			return batch.size();
+		}
+
+		///////////////////////////////////////////////////
+		// same destination, so messages can share a connection
+		static bool samePeer(const Peer& a, const Peer& b) {
+			return a.rport == b.rport && a.remote == b.remote && a.path == b.path;
+		}
+
+		///////////////////////////////////////////////////
+		// hand a group to its peer's thread; while the peer's backlog
+		// is full wait for room, unless the peer cannot be connected
+		// to, whose messages then fail at once
+		void dispatch(std::vector<MsgPair*>& group) {
+			std::string key = group.front()->first.remoteHost();
+			Worker& w = workers[key];
+			if (!w.thread) {
+				w.thread = new PeerThread(ch, limit, policy, connect);
+				w.thread->backlog(PEER_BACKLOG, PEER_BACKLOG / 2);
+				ch.place(*w.thread, "send " + key);
+				w.thread->start();
+			}
+			w.lastPost = ::GetTickCount();
+			Group moved(new std::vector<MsgPair>);
+			moved->reserve(group.size());
+			for (auto it = group.begin(); it != group.end(); it++)
+				moved->push_back(std::move(**it));
+			while (!w.thread->post(moved, PEER_POST_WAIT)) {
+				if (!w.thread->failing()) continue;
+				ch.log("Backlog of unreachable "+ key +" is full, failing its messages");
+				for (auto it = moved->begin(); it != moved->end(); it++)
+					ch.failed(std::move(*it));
+				return;
+			}
+		}
+
+		///////////////////////////////////////////////////
+		// stop and delete the threads of peers idle for PEER_IDLE_MILLIS,
+		// or of all peers, which first deliver what they hold
+		void reap(bool all) {
+			DWORD now = ::GetTickCount();
+			for (auto it = workers.begin(); it != workers.end();) {
+				PeerThread* t = it->second.thread;
+				if (all || (now - it->second.lastPost >= PEER_IDLE_MILLIS && t->idle())) {
+					t->stop();
+					t->join();
+					delete t;
+					it = workers.erase(it);
+				}
+				else
+					it++;
+			}
+		}
+
+		///////////////////////////////////////////////////
+		// main part, runs until the send queue is closed and drained
+		// messages for one peer keep their order, each group of up to
+		// maxMessages shares one connection
 		void run() {
 			try {
-				while (1) {
-					MsgPair msg = ch.sendQ.deQ();
-					ch.log("Sending Message..");
-					if (!s.connect(msg.first.remote, msg.first.rport)) {	// connect to remote peer
-						ch.log("Couldn't connect to "+ msg.first.remoteHost());
-						continue;
-					}
-					else {	// connection failed to be established
-						msg.first.fill(s);
-						ch.log("Connected to "+ msg.first.toString());
+				std::vector<MsgPair> batch;
+				while (collect(batch) > 0) {
+					std::vector<bool> done(batch.size(), false);
+					for (size_t i = 0; i < batch.size(); i++) {
+						if (done[i]) continue;
+						std::vector<MsgPair*> group;
+						for (size_t j = i; j < batch.size() && group.size() < policy.maxMessages; j++) {
+							if (!done[j] && samePeer(batch[i].first, batch[j].first)) {
+								group.push_back(&batch[j]);
+								done[j] = true;
+							}
+						}
+						dispatch(group);
 					}
-					sendMsg(msg);
-					s.writeLine("quit");
-					s.disconnect();	// disconnect immediately after sending message every time
-					ch.log("Message sent! Disconnected with "+ msg.first.toString());
+					reap(false);
 				}
+				reap(true);
+				ch.log("Send queue closed, sender exiting");
 			}
 			catch (std::exception& ex) {
 				ch.log("Sending data block error: "+ std::string(ex.what()));
@@ -321,19 +1894,74 @@ class Channel {
 		///////////////////////////////////////////////////
 		// constructor
 		SendThread(Channel& _ch) : ch(_ch) {}
+		~SendThread() {
+			reap(true);
+		}
+
+		///////////////////////////////////////////////////
+		// pace all sends of the channel
+		void sendLimit(double bytesPerSecond, double burstBytes) {
+			limit.limit(bytesPerSecond, burstBytes);
+		}
+
+		///////////////////////////////////////////////////
+		// how queued messages are coalesced
+		BatchPolicy& batchPolicy() {
+			return policy;
+		}
+
+		///////////////////////////////////////////////////
+		// connect settings of the peers' sockets
+		ConnectPolicy& connectPolicy() {
+			return connect;
+		}
 	};
 
 	SendThread* sth;	// send thread
-	static std::unordered_map<size_t, ListenThread*> lths;	// hold the listen thread
+
+	///////////////////////////////////////////////////
+	// name a network thread after this channel and pin it to the
+	// network CPUs, must be called before the thread is started
+	template <typename ThreadT>
+	void place(ThreadT& th, const std::string& role) {
+		th.name() = channelName + "-" + role;
+		th.affinity() = networkAffinity();
+	}
+	Port* listenPort;	// port served by listen(), null if not listening
+	std::atomic<unsigned int> answerPort;	// TCP port of listenPort, told to peers for their answers, 0 if none
+
+	///////////////////////////////////////////////////
+	// CPU of the i-th accepting thread, the network CPUs in turn,
+	// or all CPUs in turn when none are set
+	static std::vector<size_t> acceptCPU(size_t i) {
+		std::vector<size_t>& cpus = networkAffinity();
+		if (!cpus.empty()) return std::vector<size_t>(1, cpus[i % cpus.size()]);
+		SYSTEM_INFO info;
+		::GetSystemInfo(&info);
+		return std::vector<size_t>(1, i % info.dwNumberOfProcessors);
+	}
 public:
 	///////////////////////////////////////////////////
 	// constructor
 	Channel(const std::string& name, const Peer& _p) :
-		channelName(name), _enableACK(true), defaultRemotePeer(_p), sth(new SendThread(*this)) {
+		channelName(name), _enableACK(true), _enableLog(true), _enableChecksum(true), _enableCompression(false), _enableDedup(false), _enableDelta(false), _enableTrace(false), _enableSharedMemory(false), _acceptors(1), _priority(TokenBucket::BULK),
+		optionsLock("Channel options"), sentBytes(0), sentLock("Channel sent"), offersLock("Channel offers"), defaultRemotePeer(_p),
+		sendQ(SENDQ_HIGH_WATER, SENDQ_LOW_WATER), failQ(SENDQ_HIGH_WATER, SENDQ_LOW_WATER),
+		sendDepth(Metrics::gauge("comm_send_queue_depth", Metrics::label("channel", name))),
+		sth(new SendThread(*this)), listenPort(0), answerPort(0) {
 			// start send thread
+			place(*sth, "send");
 			sth->start();
 	}
 
+	///////////////////////////////////////////////////
+	// CPUs the send, listen and client handler threads are pinned to,
+	// empty means no pinning, applies to threads started afterwards
+	static std::vector<size_t>& networkAffinity() {
+		static std::vector<size_t> cpus;
+		return cpus;
+	}
+
 	///////////////////////////////////////////////////
 	// enable ACK
 	bool& enableACK() {
@@ -341,48 +1969,216 @@ public:
 	}
 
 	///////////////////////////////////////////////////
-	// connect to remote peer
+	// enable progress messages on screen
+	bool& enableLog() {
+		return _enableLog;
+	}
+
+	///////////////////////////////////////////////////
+	// checksum sent blocks so the receiver can ask for a resend,
+	// received checksums are always verified
+	bool& enableChecksum() {
+		return _enableChecksum;
+	}
+
+	///////////////////////////////////////////////////
+	// compress sent blocks which shrink, received blocks are
+	// always decoded
+	bool& enableCompression() {
+		return _enableCompression;
+	}
+
+	///////////////////////////////////////////////////
+	// offer files by content hash, and send only those the
+	// receiver does not already store
+	bool& enableDedup() {
+		return _enableDedup;
+	}
+
+	///////////////////////////////////////////////////
+	// offer files so a receiver holding an older copy can ask for
+	// a delta against it, implies offering by content hash
+	bool& enableDelta() {
+		return _enableDelta;
+	}
+
+	///////////////////////////////////////////////////
+	// give sent messages trace ids, so their stages are recorded
+	// in the file opened by Trace::open()
+	bool& enableTrace() {
+		return _enableTrace;
+	}
+
+	///////////////////////////////////////////////////
+	// reach same-host peers through shared memory, and let them
+	// reach this channel's listen port the same way, off by default
+	bool& enableSharedMemory() {
+		return _enableSharedMemory;
+	}
+
+	///////////////////////////////////////////////////
+	// threads accepting connections on the listen port, each pinned
+	// to one CPU when more than one, set before listen()
+	size_t& acceptors() {
+		return _acceptors;
+	}
+
+	///////////////////////////////////////////////////
+	// connect to remote peer, blocks while send queue is full
 	void send(const Peer& p, const Message& msg) {
-		MsgPair msgP(p, msg);
-		sendQ.enQ(msgP);
+		sendQ.enQ(outgoing(p, msg));
+		sendDepth.set((long long)sendQ.size());
+	}
+
+	///////////////////////////////////////////////////
+	// hand message over to the channel without copying its blocks
+	void send(const Peer& p, Message&& msg) {
+		sendQ.enQ(outgoing(p, std::move(msg)));
+		sendDepth.set((long long)sendQ.size());
 	}
 
 	///////////////////////////////////////////////////
 	// send to binded remote peer
 	void send(const Message& msg) {
-		if (defaultRemotePeer.rport == 0 || defaultRemotePeer.remote.empty()) return;
+		if (!defaultRemotePeer.reachable()) return;
 		send(defaultRemotePeer, msg);
 	}
 
+	void send(Message&& msg) {
+		if (!defaultRemotePeer.reachable()) return;
+		send(defaultRemotePeer, std::move(msg));
+	}
+
+	///////////////////////////////////////////////////
+	// send an answer to a received message where its sender
+	// listens, to the paired remote peer if it did not say
+	void reply(Message& received, Message&& msg) {
+		reply(received.replyHost(), received.replyPort(), std::move(msg));
+	}
+
+	///////////////////////////////////////////////////
+	// queue message only if send queue has room now
+	bool trySend(const Peer& p, const Message& msg) {
+		return sendFor(p, msg, 0);
+	}
+
+	bool trySend(const Message& msg) {
+		return sendFor(msg, 0);
+	}
+
+	///////////////////////////////////////////////////
+	// queue message, waiting at most milliseconds for room
+	bool sendFor(const Peer& p, const Message& msg, DWORD milliseconds) {
+		MsgPair out = outgoing(p, msg);
+		std::string hash = offeredHash(out.second);
+		if (sendQ.enQFor(std::move(out), milliseconds)) {
+			sendDepth.set((long long)sendQ.size());
+			return true;
+		}
+		// an offer that finds no room must not leave its file waiting
+		MsgPair file;
+		if (!hash.empty())
+			withdraw(hash, file);
+		return false;
+	}
+
+	bool sendFor(const Message& msg, DWORD milliseconds) {
+		if (!defaultRemotePeer.reachable()) return false;
+		return sendFor(defaultRemotePeer, msg, milliseconds);
+	}
+
+	///////////////////////////////////////////////////
+	// set send queue watermarks, in messages
+	void sendLimits(size_t highWater, size_t lowWater) {
+		sendQ.setLimits(highWater, lowWater);
+	}
+
+	///////////////////////////////////////////////////
+	// set receive queue watermarks of a port, in messages
+	static void receiveLimits(size_t number, size_t highWater, size_t lowWater) {
+		port(number)->q.setLimits(highWater, lowWater);
+	}
+
+	static void receiveLimits(const std::string& path, size_t highWater, size_t lowWater) {
+		port(path)->q.setLimits(highWater, lowWater);
+	}
+
+	///////////////////////////////////////////////////
+	// connect retry, timeout and circuit breaker settings
+	ConnectPolicy& connectPolicy() {
+		return sth->connectPolicy();
+	}
+
+	///////////////////////////////////////////////////
+	// pace this channel's sends to bytesPerSecond, 0 for no limit,
+	// may be changed while the channel sends
+	void sendLimit(double bytesPerSecond, double burstBytes = 0) {
+		sth->sendLimit(bytesPerSecond, burstBytes);
+	}
+
+	///////////////////////////////////////////////////
+	// pace sends to p's host as well, those of every channel in
+	// the process
+	void sendLimit(const Peer& p, double bytesPerSecond, double burstBytes = 0) {
+		TokenBucket::peer(p.host()).limit(bytesPerSecond, burstBytes);
+	}
+
+	///////////////////////////////////////////////////
+	// BULK sends wait for the global cap, INTERACTIVE ones are only
+	// charged to it; may be changed while the channel sends
+	void priority(TokenBucket::Priority p) {
+		_priority.store(p);
+	}
+	TokenBucket::Priority priority() {
+		return (TokenBucket::Priority)_priority.load();
+	}
+
+	///////////////////////////////////////////////////
+	// TCP options of connections to peers without options of their
+	// own, and of the listener listen() creates, set before listen()
+	SocketOptions& socketOptions() {
+		return _socketOptions;
+	}
+
+	///////////////////////////////////////////////////
+	// TCP options of connections to p's host, may be changed while
+	// the channel sends
+	void socketOptions(const Peer& p, const SocketOptions& options) {
+		optionsLock.lock();
+		peerOptions[p.host()] = options;
+		optionsLock.unlock();
+	}
+
+	///////////////////////////////////////////////////
+	// how queued messages for the same peer are coalesced,
+	// set before sending
+	BatchPolicy& batchPolicy() {
+		return sth->batchPolicy();
+	}
+
+	///////////////////////////////////////////////////
+	// fetch a message which could not be delivered, never blocks
+	// return false when there is no failed message
+	bool nextFailure(Peer& p, Message& msg) {
+		MsgPair failed;
+		if (!failQ.tryDeQ(failed)) return false;
+		p = failed.first;
+		msg = std::move(failed.second);
+		return true;
+	}
+
 	///////////////////////////////////////////////////
 	// start listen thread, binding service to one specific port
 	template <typename CallBackF>
-	void listen(size_t port, CallBackF& f) {
-		if (receiveSocket.find(port) != receiveSocket.end()) return;
-		try {
-			std::ostringstream ss;
-			ss << "Start listening on port "<< port;
-			log(ss.str());
-			lths[port] = new ListenThread(port, *this);
-			size_t count = 0;
-			lths[port]->start();
-			while (1) {	// monitor the receive Q
-				count++;
-				std::ostringstream os;
-				os << "Message#" << count << " is received!";
-				Message msg = receiveQ[port].deQ();
-				log(os.str());
-				// now call back
-				f(msg);
-			}
-		}
-		catch(std::exception& ex) {
-			log("Listen process error: "+ std::string(ex.what()));
-		}
-		catch(...)
-		{
-			log("Listen process error.");
-		}
+	void listen(size_t number, CallBackF& f) {
+		serve(port(number), f);	// resolved once, the receive loop needs no lookups
+	}
+
+	///////////////////////////////////////////////////
+	// start listen thread on a local path, for same-host peers
+	template <typename CallBackF>
+	void listen(const std::string& path, CallBackF& f) {
+		serve(port(path), f);
 	}
 
 	///////////////////////////////////////////////////
@@ -393,17 +2189,45 @@ public:
 		listen<CallBackF>(defaultRemotePeer.lport, f);
 	}
 
+	///////////////////////////////////////////////////
+	// shut channel down: queued messages are still sent, then the
+	// send thread exits; the listen port stops accepting and listen()
+	// returns once its queue is drained
+	// NOTE: receive queue and listener are shared by every channel
+	// listening on the same port
+	void close() {
+		sendQ.close();
+		sth->join();
+		if (listenPort == 0) return;
+		listenPort->listener->stop();
+		for (size_t i = 0; i < listenPort->threads.size(); i++) {
+			listenPort->threads[i]->join();
+			delete listenPort->threads[i];
+		}
+		listenPort->threads.clear();
+		if (listenPort->sharedThread) {
+			listenPort->ring->close();	// read what was written, then stop
+			listenPort->sharedThread->join();
+		}
+		listenPort->q.close();
+	}
+
 	///////////////////////////////////////////////////
 	// print message to screen
 	void log(const std::string& msg) {
+		if (!_enableLog) return;
 		sout << locker <<"\n\n  "<< channelName <<" "<< msg << unlocker;
 	}
 };
 
 // declare static variables
-std::unordered_map<std::string, Message> Channel::MsgSet;
-std::unordered_map<size_t, BlockingQueue<Message>> Channel::receiveQ;
-std::unordered_map<size_t, SocketListener*> Channel::receiveSocket;
-std::unordered_map<size_t, Channel::ListenThread*> Channel::lths;
+std::unordered_map<MsgId, Message, MsgId::Hasher> Channel::MsgSet;
+std::unordered_map<size_t, Channel::Port*> Channel::ports;
+std::unordered_map<std::string, Channel::Port*> Channel::paths;
+volatile long Peer::connections = 0;
+volatile long Channel::sections = 0;
+SRWLock Channel::portsLock("Channel ports");
+Gauge& Channel::reassembling = Metrics::gauge("comm_reassembly_messages");
+Histogram& Channel::blockLatency = Metrics::histogram("comm_block_process_us");
 
 #endif
\ No newline at end of file
@@ -37,4 +37,49 @@ void main() {
 	}
 	std::cout<<"\n\n";
 }
-#endif
\ No newline at end of file
+#endif
+#ifdef BENCH_HTTPWRAPPER
+
+#include "Message.h"
+#include "HttpWrapper.h"
+#include "../MicroBench/MicroBench.h"
+
+//----< benchmark: per block cost of writing and parsing headers >----
+/*
+ * Every block sent or received costs one writeHeader or readHeader,
+ * measured here with and without the optional checksum and encoding
+ * fields.
+ *
+ * cl /EHa /O2 /DBENCH_HTTPWRAPPER HttpWrapper.cpp ../MicroBench/MicroBench.cpp
+ */
+void main() {
+	const size_t N = 100000;
+	Message m("ReceivedFiles.bin");
+	m.push(DataBlock(std::string(BLOCK_SIZE, 'h')));
+	HttpWrapper wrapper;
+	wrapper.wrap(m);
+	wrapper.rangeStart() = 0;
+	wrapper.rangeEnd() = BLOCK_SIZE - 1;
+	MicroBench::title("HttpWrapper, one block header");
+	MicroBench::report("writeHeader", MicroBench::measure(N, [&]() {
+		MicroBench::keep(wrapper.writeHeader().size());
+	}));
+	std::string plain = wrapper.writeHeader();
+	MicroBench::report("readHeader", MicroBench::measure(N, [&]() {
+		MicroBench::keep(wrapper.readHeader(plain));
+	}));
+
+	wrapper.hasChecksum() = true;
+	wrapper.checksum() = 0xe3069283;
+	wrapper.contentEncoding() = HttpWrapper::ENCODING_LZ4;
+	wrapper.encodedLength() = 700;
+	MicroBench::report("writeHeader, checksum + encoding", MicroBench::measure(N, [&]() {
+		MicroBench::keep(wrapper.writeHeader().size());
+	}));
+	std::string full = wrapper.writeHeader();
+	MicroBench::report("readHeader, checksum + encoding", MicroBench::measure(N, [&]() {
+		MicroBench::keep(wrapper.readHeader(full));
+	}));
+	std::cout << "\n\n";
+}
+#endif
@@ -19,22 +19,61 @@ header based on raw message.  It does nothing more but setting data
 length, computing how many data to download in this particular request.
 It should support HTTP range fetch and keep-alive feature.
 
+A block may carry a CRC32C of its data in an optional "Checksum" field
+at the end of the header line.  Readers which do not know the field
+ignore it, since it comes after the fields they scan.
+
+A compressed block names its codec and its size on the wire in an optional
+"Content-Encoding" field.  Ranges and checksums always describe the
+uncompressed bytes.  Unlike the checksum, readers which do not know the
+field cannot read the block, so senders only compress when told to.
+
+A block of a traced message names its trace id in an optional "Trace-Id"
+field, which readers which do not know it ignore, like the checksum.
+
+A file handed over on a local socket is sent as ranges, each one header
+whose optional "File-Handle" field names a handle to the file, valid in
+the sender, in place of the range's bytes; no data follows that header.
+The receiver takes the handle out of the sender's process itself.
+
+Optional fields are only looked for after the fixed fields, so a file
+name cannot carry one.
+
+A block whose sender listens on a TCP port names that port in an optional
+"Reply-Port" field, so answers to it, such as resend requests, go to the
+port at the address the block came from.
+
+Content lengths and ranges are 64 bit, so files of 2 GB and more can be
+sent.  They are written as plain decimals, which older readers parse as
+long as the values fit an int.
+
 Public Interface:
 =================
 HttpWrapper w;
 bool ka = w.keepAlive();	// keep alive
 std::string type = w.contentType();	// return current type
 bool isBin = w.isContentBinary();	// return current mimeType
-int len = w.contentLength();	// message content length
+long long len = w.contentLength();	// message content length
 std::string fname = w.fileName();	// set file name
-int rs = w.rangeStart();	// return range start value
-int re = w.rangeEnd();	// return range end value
+long long rs = w.rangeStart();	// return range start value
+long long re = w.rangeEnd();	// return range end value
 std::string header = w.writeHeader();	// set the header info
 bool suc = w.readHeader(header);	// read information from HTTP header
 w.unwrap(msg);	// unwrap message, read message info to HTTP header
 w.wrap(msg);	// wrap message, fill HTTP header into message info
 bool isMsgArrived = w.isAllMsgArrived();	// are all data blocks in a message series arrived
 bool isACK = w.isACK();	// is current message a ACK message?
+bool isNAK = w.isNAK();	// is current message a request to resend?
+bool isOffer = w.isOffer();	// is current message a content hash offer or answer?
+bool isDelta = w.isDelta();	// is current message a file delta?
+w.hasChecksum() = true;	// write the checksum field
+unsigned int crc = w.checksum();	// CRC32C of this block, valid if hasChecksum()
+w.contentEncoding() = HttpWrapper::ENCODING_LZ4;	// block is LZ4 compressed, empty if raw
+w.encodedLength() = n;	// compressed block size
+unsigned long long id = w.traceId();	// trace id of the message, 0 if not traced
+w.replyPort() = 8080;	// the sender listens there, 0 if it does not
+w.fileHandle() = h;	// block is read from the sender's handle h, 0 when its bytes follow
+size_t wire = w.wireLength();	// bytes following this header
 bool newMsg = w.isNewMsg();	// is this a new message?
 
 Build Process:
@@ -45,6 +84,18 @@ Message.h
 Maintenance History:
 ====================
 - Apr 13, 2013 : initial version
+- Oct 19, 2026 : optional Reply-Port field
+- Oct 19, 2026 : optional fields are read after the fixed fields only;
+                 File-Handle names a handle in the sender
+- Oct 19, 2026 : content length and ranges are 64 bit
+- Oct 19, 2026 : optional File-Handle field, for files handed over on
+                 local sockets
+- Oct 19, 2026 : optional per-block Trace-Id field
+- Oct 19, 2026 : delta content type; unwrap keeps the file name of every
+                 message but plain text, ACKs of files included
+- Oct 19, 2026 : offer content type
+- Oct 19, 2026 : optional per-block Content-Encoding field
+- Oct 19, 2026 : optional per-block Checksum field, NAK content type
 
 */
 
@@ -56,10 +107,19 @@ Maintenance History:
 class HttpWrapper {
 	// HTTP request and response format here
 	static const std::string HEADER_POST;
+	static const std::string HEADER_SCAN;
+	static const std::string HEADER_CHECKSUM;
+	static const std::string HEADER_ENCODING;
+	static const std::string HEADER_TRACE;
+	static const std::string HEADER_HANDLE;
+	static const std::string HEADER_REPLY;
 	// content-type here
 	static const std::string TYPE_BIN ;
 	static const std::string TYPE_TEXT;
 	static const std::string TYPE_ACK;
+	static const std::string TYPE_NAK;
+	static const std::string TYPE_OFFER;
+	static const std::string TYPE_DELTA;
 	// connection type here
 	static const std::string CONN_KEEP_ALIVE;
 	static const std::string CONN_CLOSE;
@@ -69,18 +129,42 @@ class HttpWrapper {
 	// the MIME type
 	std::string _mimeType;
 	// current range start number
-	int _rangeStart;
+	long long _rangeStart;
 	// current range end number
-	int _rangeEnd;
+	long long _rangeEnd;
 	// total data length
-	int _contentLength;
+	long long _contentLength;
 	// received / sent block name
 	std::string _fileName;
+	// is a block checksum present
+	bool _hasChecksum;
+	// CRC32C of the block data
+	unsigned int _checksum;
+	// codec of the block data, empty when sent raw
+	std::string _contentEncoding;
+	// block size on the wire when encoded
+	int _encodedLength;
+	// trace id of the message, 0 when not traced
+	unsigned long long _traceId;
+	// handle to the file holding the block, valid in the sender, 0 if none
+	unsigned long long _fileHandle;
+	// port the sender listens on for answers, 0 if none
+	unsigned int _replyPort;
+	// where an optional field's value starts, null if it is absent;
+	// optional fields are searched for from the end of the fixed ones
+	static const char* field(const std::string& header, size_t fixed, const std::string& format) {
+		std::string name = format.substr(0, format.find('%'));
+		size_t pos = header.find(name, fixed);
+		return pos == std::string::npos ? 0 : header.c_str() + pos + name.size();
+	}
 	// read keep-alive status from string
 	void keepAlive(const std::string& str) {
 		_keepAlive = (str==CONN_KEEP_ALIVE);
 	}
 public:
+	// content encodings
+	static const std::string ENCODING_LZ4;
+
 	///////////////////////////////////////////////////
 	// constructor, by default, it will be close-connection and binary content-type
 	HttpWrapper() : 
@@ -88,7 +172,13 @@ public:
 		_mimeType(TYPE_BIN),
 		_rangeStart(0),
 		_rangeEnd(0),
-		_contentLength(0) {}
+		_contentLength(0),
+		_hasChecksum(false),
+		_checksum(0),
+		_encodedLength(0),
+		_traceId(0),
+		_fileHandle(0),
+		_replyPort(0) {}
 
 	///////////////////////////////////////////////////
 	// return current connection status
@@ -110,7 +200,7 @@ public:
 
 	///////////////////////////////////////////////////
 	// message content length
-	int& contentLength() {
+	long long& contentLength() {
 		return _contentLength;
 	}
 
@@ -122,21 +212,82 @@ public:
 
 	///////////////////////////////////////////////////
 	// return range start value
-	int& rangeStart() {
+	long long& rangeStart() {
 		return _rangeStart;
 	}
 
 	///////////////////////////////////////////////////
 	// return range end value
-	int& rangeEnd() {
+	long long& rangeEnd() {
 		return _rangeEnd;
 	}
 
+	///////////////////////////////////////////////////
+	// is a block checksum present
+	bool& hasChecksum() {
+		return _hasChecksum;
+	}
+
+	///////////////////////////////////////////////////
+	// CRC32C of the block data
+	unsigned int& checksum() {
+		return _checksum;
+	}
+
+	///////////////////////////////////////////////////
+	// codec of the block data, empty when sent raw
+	std::string& contentEncoding() {
+		return _contentEncoding;
+	}
+
+	///////////////////////////////////////////////////
+	// block size on the wire when encoded
+	int& encodedLength() {
+		return _encodedLength;
+	}
+
+	///////////////////////////////////////////////////
+	// trace id of the message, 0 when not traced
+	unsigned long long& traceId() {
+		return _traceId;
+	}
+
+	///////////////////////////////////////////////////
+	// handle the block is read from, 0 when its bytes follow
+	unsigned long long& fileHandle() {
+		return _fileHandle;
+	}
+
+	///////////////////////////////////////////////////
+	// port the sender listens on for answers, 0 if none
+	unsigned int& replyPort() {
+		return _replyPort;
+	}
+
+	///////////////////////////////////////////////////
+	// bytes of block data following the header
+	size_t wireLength() {
+		if (isACK() || _fileHandle != 0) return 0;
+		if (!_contentEncoding.empty()) return _encodedLength;
+		return (size_t)(_rangeEnd - _rangeStart + 1);
+	}
+
 	///////////////////////////////////////////////////
 	// set the header info
 	std::string writeHeader() {
 		char buff[1024];
-		sprintf_s(buff, 1024, HEADER_POST.c_str(), _fileName.c_str(), _mimeType.c_str(), _contentLength, _rangeStart, _rangeEnd, _keepAlive ? CONN_KEEP_ALIVE.c_str() : CONN_CLOSE.c_str());
+		int n = sprintf_s(buff, 1024, HEADER_POST.c_str(), _fileName.c_str(), _mimeType.c_str(), _contentLength, _rangeStart, _rangeEnd, _keepAlive ? CONN_KEEP_ALIVE.c_str() : CONN_CLOSE.c_str());
+		// optional fields replace the line end, and end with one
+		if (!_contentEncoding.empty() && n > 2)
+			n += sprintf_s(buff + n - 2, 1024 - n + 2, HEADER_ENCODING.c_str(), _contentEncoding.c_str(), _encodedLength) - 2;
+		if (_traceId != 0 && n > 2)
+			n += sprintf_s(buff + n - 2, 1024 - n + 2, HEADER_TRACE.c_str(), _traceId) - 2;
+		if (_fileHandle != 0 && n > 2)
+			n += sprintf_s(buff + n - 2, 1024 - n + 2, HEADER_HANDLE.c_str(), _fileHandle) - 2;
+		if (_replyPort != 0 && n > 2)
+			n += sprintf_s(buff + n - 2, 1024 - n + 2, HEADER_REPLY.c_str(), _replyPort) - 2;
+		if (_hasChecksum && n > 2)
+			sprintf_s(buff + n - 2, 1024 - n + 2, HEADER_CHECKSUM.c_str(), _checksum);
 		std::string header(buff);
 		return header;
 	}
@@ -147,21 +298,45 @@ public:
 	bool readHeader(const std::string& header) {
 		// do the scan
 		char _keep_alive[16], _file_name[256], _mime_type[64];
-		if (sscanf_s(header.c_str(), HEADER_POST.c_str(), _file_name, 256, _mime_type, 64, &_contentLength, &_rangeStart, &_rangeEnd, _keep_alive, 16) < 6) {
+		int fixed = 0;	// length of the fixed fields, set once all of them matched
+		if (sscanf_s(header.c_str(), HEADER_SCAN.c_str(), _file_name, 256, _mime_type, 64, &_contentLength, &_rangeStart, &_rangeEnd, _keep_alive, 16, &fixed) < 6 || fixed == 0) {
 			// something wrong is just happening
 			return false;
 		}
 		_fileName = _file_name;
 		_mimeType = _mime_type;
 		keepAlive(std::string(_keep_alive));	// change the value of keep-alive
+		// optional fields follow all others
+		const char* value = field(header, fixed, HEADER_CHECKSUM);
+		_hasChecksum = value && sscanf_s(value, "%x", &_checksum) == 1;
+		char _encoding[16];
+		value = field(header, fixed, HEADER_ENCODING);
+		if (value && sscanf_s(value, "%s %d", _encoding, 16, &_encodedLength) == 2)
+			_contentEncoding = _encoding;
+		else
+			_contentEncoding.clear();
+		value = field(header, fixed, HEADER_TRACE);
+		if (!value || sscanf_s(value, "%llx", &_traceId) != 1)
+			_traceId = 0;
+		value = field(header, fixed, HEADER_HANDLE);
+		if (!value || sscanf_s(value, "%llx", &_fileHandle) != 1)
+			_fileHandle = 0;
+		value = field(header, fixed, HEADER_REPLY);
+		if (!value || sscanf_s(value, "%u", &_replyPort) != 1 || _replyPort > 65535)
+			_replyPort = 0;
 		return true;
 	}
 
 	///////////////////////////////////////////////////
 	// unwrap message, read message info to HTTP header
 	void unwrap(Message& msg) {
-		msg.fileName() = isContentBinary() ? _fileName : Message::TYPE_STRING;
+		msg.fileName() = _mimeType==TYPE_TEXT ? Message::TYPE_STRING : _fileName;
 		msg.isACK() = isACK();
+		msg.isNAK() = isNAK();
+		msg.isOffer() = isOffer();
+		msg.isDelta() = isDelta();
+		msg.traceId() = _traceId;
+		msg.replyPort() = _replyPort;
 	}
 
 	///////////////////////////////////////////////////
@@ -174,7 +349,14 @@ public:
 			_mimeType = TYPE_BIN;
 		if (msg.isACK())
 			_mimeType = TYPE_ACK;
-		_contentLength = msg.length();
+		if (msg.isNAK())
+			_mimeType = TYPE_NAK;
+		if (msg.isOffer())
+			_mimeType = TYPE_OFFER;
+		if (msg.isDelta())
+			_mimeType = TYPE_DELTA;
+		_contentLength = (long long)msg.length();
+		_traceId = msg.traceId();
 	}
 
 	///////////////////////////////////////////////////
@@ -189,6 +371,24 @@ public:
 		return _mimeType==TYPE_ACK;
 	}
 
+	///////////////////////////////////////////////////
+	// is current message a request to resend a corrupted message?
+	bool isNAK() {
+		return _mimeType==TYPE_NAK;
+	}
+
+	///////////////////////////////////////////////////
+	// is current message a content hash offer, or an answer to one?
+	bool isOffer() {
+		return _mimeType==TYPE_OFFER;
+	}
+
+	///////////////////////////////////////////////////
+	// is current message a delta against an older copy of a file?
+	bool isDelta() {
+		return _mimeType==TYPE_DELTA;
+	}
+
 	///////////////////////////////////////////////////
 	// is this a new message?
 	bool isNewMsg() {
@@ -202,10 +402,21 @@ const std::string HttpWrapper::CONN_CLOSE = "close";
 
 // this is a custom-defined HTTP 1.1 header
 const std::string HttpWrapper::HEADER_POST =
-	"POST %s HTTP/1.1 ; Content-Type: %s , Content-Length: %d , Range: %d-%d , Connection: %s \r\n";	// filename, content-type, content-length, file-range
+	"POST %s HTTP/1.1 ; Content-Type: %s , Content-Length: %lld , Range: %lld-%lld , Connection: %s \r\n";	// filename, content-type, content-length, file-range
+const std::string HttpWrapper::HEADER_SCAN = HEADER_POST + "%n";	// HEADER_POST, and where its fields end
+const std::string HttpWrapper::HEADER_CHECKSUM = ", Checksum: %08x \r\n";	// optional, replaces the line end of HEADER_POST
+const std::string HttpWrapper::HEADER_ENCODING = ", Content-Encoding: %s %d \r\n";	// optional, codec and wire size
+const std::string HttpWrapper::HEADER_TRACE = ", Trace-Id: %016llx \r\n";	// optional, trace id of the message
+const std::string HttpWrapper::HEADER_REPLY = ", Reply-Port: %u \r\n";	// optional, port the sender listens on
+const std::string HttpWrapper::HEADER_HANDLE = ", File-Handle: %llx \r\n";	// optional, handle to the block's file in the sender
 
 const std::string HttpWrapper::TYPE_BIN = "application/octet-stream";	// binary content-type
 const std::string HttpWrapper::TYPE_TEXT = "plain/text";	// text content-type
 const std::string HttpWrapper::TYPE_ACK = "etc/ack";	// custom defined type : ACK
+const std::string HttpWrapper::TYPE_NAK = "etc/nak";	// custom defined type : NAK, resend request
+const std::string HttpWrapper::TYPE_OFFER = "etc/offer";	// custom defined type : content hash offer exchange
+const std::string HttpWrapper::TYPE_DELTA = "etc/delta";	// custom defined type : file delta
+
+const std::string HttpWrapper::ENCODING_LZ4 = "lz4";	// LZ4 block format
 
 #endif
\ No newline at end of file
@@ -46,4 +46,52 @@ void main() {
 	std::cout<<"\n Message content: "<< os.str().c_str();
 	std::cout<<"\n\n";
 }
-#endif
\ No newline at end of file
+#endif
+#ifdef BENCH_MESSAGE
+
+#include <string>
+#include <iostream>
+#include <sstream>
+#include "Message.h"
+#include "../MicroBench/MicroBench.h"
+
+//----< benchmark: per call cost of message and block operations >----
+/*
+ * Message::from reads its stream a character at a time and allocates a
+ * read buffer as well as the block for every block, a block copy
+ * allocates and copies its bytes, a block move allocates nothing.
+ *
+ * cl /EHa /O2 /DBENCH_MESSAGE Message.cpp ../MicroBench/MicroBench.cpp
+ */
+void main() {
+	const size_t N = 20000;
+	std::string text(4 * BLOCK_SIZE, 'm');
+	std::istringstream in(text);
+	MicroBench::title("Message and DataBlock, 4 KB message of 1 KB blocks");
+	MicroBench::report("Message::from", MicroBench::measure(N, [&]() {
+		Message m;
+		m.from(in);	// rewinds the stream, read to its end last time
+		MicroBench::keep(m.length());
+	}));
+	Message m;
+	m.fromString(text);
+	std::ostringstream out;
+	MicroBench::report("Message::to", MicroBench::measure(N, [&]() {
+		out.seekp(0);	// reuse the stream's buffer
+		m.to(out);
+		MicroBench::keep((size_t)out.tellp());
+	}));
+	DataBlock block(text.data(), BLOCK_SIZE);
+	MicroBench::report("DataBlock copy", MicroBench::measure(10 * N, [&]() {
+		DataBlock copy(block);
+		MicroBench::keep(copy.size());
+	}));
+	MicroBench::report("DataBlock move, construct + assign", MicroBench::measure(10 * N, [&]() {
+		DataBlock moved(std::move(block));
+		block = std::move(moved);
+		MicroBench::keep(block.size());
+	}));
+	std::cout << "\n\n";
+}
+
+#endif
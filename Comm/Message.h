@@ -20,7 +20,9 @@ Three structures are provided:
 
 DataBlock:
 -------------
-A baisc unit of chunked message.
+A baisc unit of chunked message.  Copying a block copies its bytes, moving
+a block hands its buffer over, so queues and vectors of blocks should be
+moved from whenever the source is no longer needed.
 
 Message:
 -------
@@ -30,6 +32,7 @@ an array of data blocks.  It can be either a file or a string.
 Public Interface:
 =================
 DataBlock data;
+DataBlock buff(len);	// uninitialized block of len bytes, fill through data()
 char * dat = data.data();
 size_t size = data.size();
 std::string header = data.header();
@@ -46,7 +49,14 @@ m.push(dat);	// push data block into vector
 size_t len = m.length();	// return the total content length
 std::string name = m.fileName();	// return current file name
 bool isACK = m.isACK();	// return ACK status
+bool isNAK = m.isNAK();	// return NAK status, a request to resend a corrupted message
+bool isOffer = m.isOffer();	// is this part of a content hash offer exchange?
+bool isDelta = m.isDelta();	// does this carry a delta against an older copy of the file?
 bool isBin = m.isBinary();	// is current mssage a binary message?
+m.traceId() = id;	// stages of a message with a nonzero id are traced
+std::string src = m.source();	// file the message was loaded from, empty if none
+std::string host = m.replyHost();	// address the sender of a received message listens on, empty if unknown
+size_t port = m.replyPort();	// and its port, 0 if unknown
 
 Build Process:
 ==============
@@ -56,6 +66,18 @@ Required Files:
 Maintenance History:
 ====================
 - Apr 16, 2013 : initial version
+- Oct 19, 2026 : added replyHost() and replyPort(), where the sender of a
+                 received message listens
+- Oct 19, 2026 : added source(), set by fromFile(), so a file can be
+                 handed over instead of sent
+- Oct 19, 2026 : added traceId() for end-to-end tracing
+- Oct 19, 2026 : from() clears the stream state before rewinding, so a stream
+                 read to its end can be read again
+- Oct 19, 2026 : added isDelta() for files sent as deltas
+- Oct 19, 2026 : added isOffer() for content hash offers and their answers
+- Oct 19, 2026 : added isNAK() for checksum failure reports
+- Oct 19, 2026 : DataBlock deep-copies, moves and frees its buffer; Message
+                 is movable; blocks are moved into messages
 
 */
 
@@ -63,6 +85,7 @@ Maintenance History:
 #include <sstream>
 #include <fstream>
 #include <vector>
+#include <utility>
 
 // define the size of each block
 #define BLOCK_SIZE 1024
@@ -82,8 +105,14 @@ public:
 	// constructors
 	DataBlock() : _data(0), _size(0) {}
 	///////////////////////////////////////////////////
+	// constructing an uninitialized block, filled through data()
+	explicit DataBlock(size_t _s) : _size(_s), _data(0) {
+		if (_size<1) return;
+		_data = new char[_size];
+	}
+	///////////////////////////////////////////////////
 	// constructing from raw data
-	DataBlock(const char * _dat, size_t _s) : _size(_s) {
+	DataBlock(const char * _dat, size_t _s) : _size(_s), _data(0) {
 		if (_size<1) return;
 		_data = new char[_size];
 		// do a string copy here
@@ -92,7 +121,7 @@ public:
 	}
 	///////////////////////////////////////////////////
 	// constructing from string
-	DataBlock(const std::string _dat) : _size(_dat.length()) {
+	DataBlock(const std::string _dat) : _size(_dat.length()), _data(0) {
 		if (_size<1) return;
 		_data = new char[_size];
 		for (size_t i=0; i<_size; i++)
@@ -100,12 +129,30 @@ public:
 	}
 	///////////////////////////////////////////////////
 	// copy constructor
-	DataBlock(const DataBlock& _dat) : _size(_dat._size), _header(_dat._header), _data(_dat._data) {
+	DataBlock(const DataBlock& _dat) : _size(_dat._size), _header(_dat._header), _data(0) {
 		if (_size<1) return;
-		char* tmp = _data;
-		char* _data = new char[_size];
+		_data = new char[_size];
 		for (size_t i=0; i<_size; i++)
-			_data[i] = tmp[i];
+			_data[i] = _dat._data[i];
+	}
+	///////////////////////////////////////////////////
+	// move constructor, takes over the buffer
+	DataBlock(DataBlock&& _dat) : _size(_dat._size), _header(std::move(_dat._header)), _data(_dat._data) {
+		_dat._data = 0;
+		_dat._size = 0;
+	}
+	///////////////////////////////////////////////////
+	// copy and move assignment
+	DataBlock& operator=(DataBlock _dat) {
+		std::swap(_size, _dat._size);
+		std::swap(_data, _dat._data);
+		_header.swap(_dat._header);
+		return *this;
+	}
+	///////////////////////////////////////////////////
+	// destructor
+	~DataBlock() {
+		delete[] _data;
 	}
 
 	///////////////////////////////////////////////////
@@ -140,6 +187,19 @@ class Message {
 	std::string _fileName;
 	// is this message an acknowledge message?
 	bool _isACK;
+	// is this message a negative acknowledge, asking for a resend?
+	bool _isNAK;
+	// is this an offer of content by hash, or an answer to one?
+	bool _isOffer;
+	// does this message carry a delta instead of the whole file?
+	bool _isDelta;
+	// trace id, 0 if the message is not traced
+	unsigned long long _traceId;
+	// path of the file loaded by fromFile(), empty otherwise
+	std::string _source;
+	// address and port the sender listens on, empty and 0 if unknown
+	std::string _replyHost;
+	size_t _replyPort;
 public:
 	// iterator for blocks
 	typedef std::vector<DataBlock>::iterator iterator;
@@ -149,14 +209,45 @@ public:
 	///////////////////////////////////////////////////
 	// constructor
 	Message() :
-		_contentLength(0), _blockSize(BLOCK_SIZE), _fileName(TYPE_STRING), _isACK(false) {}
+		_contentLength(0), _blockSize(BLOCK_SIZE), _fileName(TYPE_STRING), _isACK(false), _isNAK(false), _isOffer(false), _isDelta(false), _traceId(0), _replyPort(0) {}
 	Message(const std::string& f) :
-		_contentLength(0), _blockSize(BLOCK_SIZE), _fileName(f), _isACK(false) {}
+		_contentLength(0), _blockSize(BLOCK_SIZE), _fileName(f), _isACK(false), _isNAK(false), _isOffer(false), _isDelta(false), _traceId(0), _replyPort(0) {}
+	Message(const Message& m) :
+		data(m.data), _contentLength(m._contentLength), _blockSize(m._blockSize), _fileName(m._fileName), _isACK(m._isACK), _isNAK(m._isNAK), _isOffer(m._isOffer), _isDelta(m._isDelta), _traceId(m._traceId), _source(m._source),
+		_replyHost(m._replyHost), _replyPort(m._replyPort) {}
+
+	///////////////////////////////////////////////////
+	// move constructor, blocks are handed over not copied
+	Message(Message&& m) :
+		data(std::move(m.data)), _contentLength(m._contentLength), _blockSize(m._blockSize),
+		_fileName(std::move(m._fileName)), _isACK(m._isACK), _isNAK(m._isNAK), _isOffer(m._isOffer), _isDelta(m._isDelta), _traceId(m._traceId),
+		_source(std::move(m._source)), _replyHost(std::move(m._replyHost)), _replyPort(m._replyPort) {
+		m._contentLength = 0;
+	}
+
+	///////////////////////////////////////////////////
+	// copy and move assignment
+	Message& operator=(Message m) {
+		data.swap(m.data);
+		std::swap(_contentLength, m._contentLength);
+		std::swap(_blockSize, m._blockSize);
+		_fileName.swap(m._fileName);
+		std::swap(_isACK, m._isACK);
+		std::swap(_isNAK, m._isNAK);
+		std::swap(_isOffer, m._isOffer);
+		std::swap(_isDelta, m._isDelta);
+		std::swap(_traceId, m._traceId);
+		_source.swap(m._source);
+		_replyHost.swap(m._replyHost);
+		std::swap(_replyPort, m._replyPort);
+		return *this;
+	}
 
 	///////////////////////////////////////////////////
 	// load message from string
 	inline void fromString(const std::string& str) {
 		_fileName = TYPE_STRING;
+		_source.clear();
 		if (str.empty()) return;
 		std::stringstream ss;
 		ss << str;
@@ -173,6 +264,7 @@ public:
 		else
 			_fileName = path.substr(pos+1);
 		std::ifstream fs(path, std::ios::in | std::ios::binary);
+		_source = path;
 		if (fs.good())
 			from(fs);
 		fs.close();
@@ -183,8 +275,8 @@ public:
 	// as it is stream, it can either be a istringstream or a ifstream
 	void from(std::istream& s) {
 		_contentLength = 0;
+		s.clear(s.goodbit);	// a stream read to its end would not seek
 		s.seekg(0, s.beg);
-		s.clear(s.goodbit);
 		while (s.good()) {
 			char * buff = new char[_blockSize];	// read buffer
 			size_t bytesRead = 0;
@@ -200,7 +292,7 @@ public:
 				data.push_back(DataBlock(buff, bytesRead));
 				_contentLength += bytesRead;
 			}
-			delete buff;
+			delete[] buff;
 		}
 	}
 
@@ -239,8 +331,8 @@ public:
 	///////////////////////////////////////////////////
 	// push data block into vector
 	inline void push(DataBlock dat) {
-		data.push_back(dat);
 		_contentLength += dat.size();
+		data.push_back(std::move(dat));
 	}
 
 	///////////////////////////////////////////////////
@@ -261,6 +353,49 @@ public:
 		return _isACK;
 	}
 
+	///////////////////////////////////////////////////
+	// return NAK status
+	inline bool& isNAK() {
+		return _isNAK;
+	}
+
+	///////////////////////////////////////////////////
+	// return offer status
+	inline bool& isOffer() {
+		return _isOffer;
+	}
+
+	///////////////////////////////////////////////////
+	// return delta status
+	inline bool& isDelta() {
+		return _isDelta;
+	}
+
+	///////////////////////////////////////////////////
+	// return trace id, 0 if not traced
+	inline unsigned long long& traceId() {
+		return _traceId;
+	}
+
+	///////////////////////////////////////////////////
+	// return the file loaded by fromFile(), empty if none
+	inline std::string& source() {
+		return _source;
+	}
+
+	///////////////////////////////////////////////////
+	// return the address the sender of a received message
+	// listens on, empty if unknown
+	inline std::string& replyHost() {
+		return _replyHost;
+	}
+
+	///////////////////////////////////////////////////
+	// return the port the sender listens on, 0 if unknown
+	inline size_t& replyPort() {
+		return _replyPort;
+	}
+
 	///////////////////////////////////////////////////
 	// is current mssage a binary message?
 	inline bool isBinary() {
@@ -19,6 +19,17 @@ message is received, it will simply print it on the screen.  When a binary
 message is received, it will save it on the disk.  It will also conduct
 tasks based on specific string instructions.
 
+Saved files are added to the ObjectStore, so a peer offering the same
+content again has it linked instead of sent.
+
+A delta message is applied to the saved copy of its file.  The result is
+written beside it and replaces it only if its hash is the one offered,
+and the sender is told it has the file; otherwise the sender is asked for
+the whole file.
+
+Once IoEngine is started, a binary message is saved with overlapped writes,
+its blocks in flight together.
+
 Public Interface:
 =================
 Messenger m(channel);	// declare a messenger instance
@@ -27,11 +38,15 @@ m(message);	// process received message
 Build Process:
 ==============
 Required Files:
-- Message.h
+- Message.h, ObjectStore.h, Delta.h, Delta.cpp, IoEngine.h, IoEngine.cpp
 
 Maintenance History:
 ====================
 - Apr 16, 2013 : initial version
+- Oct 19, 2026 : the answer to a delta goes to the channel that sent it
+- Oct 19, 2026 : binary messages are saved with overlapped writes when IoEngine runs
+- Oct 19, 2026 : delta messages are applied to the saved copy of their file
+- Oct 19, 2026 : saved files are added to the ObjectStore
 
 */
 
@@ -39,6 +54,9 @@ Maintenance History:
 #include <fstream>
 #include <sstream>
 #include "Message.h"
+#include "ObjectStore.h"
+#include "../Delta/Delta.h"
+#include "../IoEngine/IoEngine.h"
 
 /////////////////////////////////////////////////////////////////////
 // Messenger class, used to processing message
@@ -49,13 +67,65 @@ class Messenger {
 	// save message content to binary file
 	std::string saveBinary(Message& m) {
 		::CreateDirectory(L"ReceivedFiles", NULL);	// save files to specific directory
-		std::string path("ReceivedFiles/"+ m.fileName());
-		std::ofstream f(path, std::ios::out | std::ios::binary);
-		m.to(f);
-		f.close();
+		std::string path(ObjectStore::root() +"/"+ m.fileName());
+		ObjectStore::unlink(path);	// never write through a link into the store
+		if (IoEngine::running()) {
+			// blocks are written in place, m outlives the writes
+			IoFile f;
+			bool ok = f.open(path);
+			for (auto it = m.begin(); ok && it != m.end(); it++)
+				ok = f.write(it->data(), it->size());
+			if (!f.close() || !ok)
+				ch.log("Failed to save " + path);
+		}
+		else {
+			std::ofstream f(path, std::ios::out | std::ios::binary);
+			m.to(f);
+			f.close();
+		}
+		ObjectStore::add(path, ObjectStore::hash(m));
 		return path;
 	}
 
+	///////////////////////////////////////////////////
+	// rebuild a file from its saved copy and a delta
+	// return false, and ask for the whole file, if that fails
+	bool applyDelta(Message& m) {
+		std::ostringstream ss;
+		m.to(ss);
+		std::string body = ss.str();
+		size_t line = body.find('\n');
+		std::istringstream head(body.substr(0, line));
+		std::string hash;
+		head >> hash;
+		std::string path(ObjectStore::root() +"/"+ m.fileName());
+		std::string temp(path +".delta");
+		bool ok = false;
+		if (line != std::string::npos) {
+			std::ifstream base(path, std::ios::in | std::ios::binary);
+			std::ofstream out(temp, std::ios::out | std::ios::binary);
+			ok = base.good() && Delta::apply(base, body.data() + line + 1, body.size() - line - 1, out);
+		}
+		if (ok) {
+			std::ifstream rebuilt(temp, std::ios::in | std::ios::binary);
+			ok = ObjectStore::hash(rebuilt) == hash;
+		}
+		if (ok) {
+			ObjectStore::unlink(path);	// the old copy may be linked into the store
+			::MoveFileExA(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING);
+			ObjectStore::add(path, hash);
+		}
+		else
+			::DeleteFileA(temp.c_str());
+		// the sender keeps the file until it hears either way, so the
+		// answer goes back to it, not to the paired peer
+		Message answer(m.fileName());
+		answer.isOffer() = true;
+		answer.push(DataBlock((ok ? "have " : "need ")+ hash));
+		ch.reply(m, std::move(answer));
+		return ok;
+	}
+
 	///////////////////////////////////////////////////
 	// print string on the screen
 	std::string saveString(Message& m) {
@@ -75,7 +145,7 @@ class Messenger {
 			// send a message back
 			Message m;
 			m.fromString("Task#1 Answer: The ultimate answer to the universe is 42");	// return the ultimate answer to the universe
-			ch.send(m);
+			ch.send(std::move(m));
 		}
 		else if (instr=="Task#2") {
 			ch.log("Instruction received! Calculation the ultimate question to the universe..");
@@ -83,7 +153,7 @@ class Messenger {
 			ch.log("Calculation finished!");
 			Message m;
 			m.fromString("Task#2 Answer: The ultimate question to the universe is 'How many roads must a man walk down?'");	// return the final question to the universe
-			ch.send(m);
+			ch.send(std::move(m));
 		}
 	}
 
@@ -101,6 +171,12 @@ public:
 			else
 				ch.log("String message is acknowledged by receiver!");
 		}
+		else if (m.isDelta()) {
+			if (applyDelta(m))
+				ch.log("File ["+ m.fileName() +"] is rebuilt from a delta!");
+			else
+				ch.log("Delta for ["+ m.fileName() +"] could not be applied, asking for the whole file");
+		}
 		else if (m.isBinary()) {
 			std::string path = saveBinary(m);
 			ch.log("File ["+ m.fileName() +"] is received and saved to ["+ path +"]!");
@@ -0,0 +1,137 @@
+#ifndef OBJECTSTORE_H
+#define OBJECTSTORE_H
+
+/////////////////////////////////////////////////////////////////////
+// ObjectStore.h - Content addressed store of received files       //
+// ver 1.0                                                         //
+// Language:      Visual C++, 2011                                 //
+// Platform:      Studio 1558, Windows 7 Pro SP1                   //
+// Application:   CIS 687 / Project 3, Sp13                        //
+/////////////////////////////////////////////////////////////////////
+/*
+
+Module Operations:
+==================
+ObjectStore keeps one copy of every file content received, named by its
+SHA-256 hash, under ReceivedFiles/.objects.  Objects are hard links to
+the received files, so the store costs no extra disk space.  When a peer
+offers a file whose hash is already stored, the file is linked into
+ReceivedFiles instead of being transferred again.
+
+A received file shares its bytes with its object, so it must be removed
+with unlink() before it is rewritten, never truncated in place.
+
+Public Interface:
+=================
+std::string dir = ObjectStore::root();	// directory received files are saved to
+std::string h = ObjectStore::hash(msg);	// content hash of a message
+h = ObjectStore::hash(stream);	// content hash of a stream, read to its end
+bool ok = ObjectStore::valid(h);	// is h a well formed hash?
+bool have = ObjectStore::has(h);	// is an object with this hash stored?
+bool linked = ObjectStore::link(h, name);	// make ReceivedFiles/name the stored object
+ObjectStore::unlink(path);	// remove a received file before rewriting it
+ObjectStore::add(path, h);	// store a saved file under its hash
+
+Build Process:
+==============
+Required Files:
+Message.h, SHA256.h, SHA256.cpp
+
+Maintenance History:
+====================
+- Oct 19, 2026 : initial version
+- Oct 19, 2026 : added hash of a stream
+
+*/
+
+#include <string>
+#include <Windows.h>
+#include "../SHA256/SHA256.h"
+#include "Message.h"
+
+/////////////////////////////////////////////////////////////////////
+// ObjectStore class
+class ObjectStore {
+	///////////////////////////////////////////////////
+	// path of the object with this content hash
+	static std::string object(const std::string& hash) {
+		return root() + "/.objects/" + hash;
+	}
+
+public:
+	///////////////////////////////////////////////////
+	// directory received files are saved to
+	static const std::string& root() {
+		static const std::string dir("ReceivedFiles");
+		return dir;
+	}
+
+	///////////////////////////////////////////////////
+	// content hash of a message, over all its blocks
+	static std::string hash(Message& m) {
+		SHA256 h;
+		for (auto it = m.begin(); it != m.end(); it++)
+			h.update(it->data(), it->size());
+		return h.hex();
+	}
+
+	///////////////////////////////////////////////////
+	// content hash of a stream, read to its end
+	static std::string hash(std::istream& in) {
+		SHA256 h;
+		char buff[64 * 1024];
+		while (in.read(buff, sizeof(buff)) || in.gcount() > 0)
+			h.update(buff, (size_t)in.gcount());
+		return h.hex();
+	}
+
+	///////////////////////////////////////////////////
+	// is this a well formed hash? hashes come from peers and
+	// become file names, so nothing else may pass
+	static bool valid(const std::string& hash) {
+		if (hash.size() != 64) return false;
+		for (size_t i = 0; i < hash.size(); i++) {
+			char c = hash[i];
+			if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) return false;
+		}
+		return true;
+	}
+
+	///////////////////////////////////////////////////
+	// is an object with this hash stored?
+	static bool has(const std::string& hash) {
+		return valid(hash) && ::GetFileAttributesA(object(hash).c_str()) != INVALID_FILE_ATTRIBUTES;
+	}
+
+	///////////////////////////////////////////////////
+	// make root()/name the stored object with this hash
+	// return false if there is no such object
+	static bool link(const std::string& hash, const std::string& name) {
+		if (!has(hash)) return false;
+		std::string path = root() + "/" + name;
+		unlink(path);
+		if (::CreateHardLinkA(path.c_str(), object(hash).c_str(), NULL)) return true;
+		// file systems without hard links get a copy
+		return ::CopyFileA(object(hash).c_str(), path.c_str(), FALSE) != 0;
+	}
+
+	///////////////////////////////////////////////////
+	// remove a received file before rewriting it, so the object
+	// it may be linked to keeps its content
+	static void unlink(const std::string& path) {
+		::DeleteFileA(path.c_str());
+	}
+
+	///////////////////////////////////////////////////
+	// store a saved file under its content hash, nothing to do
+	// if that content is already stored
+	static void add(const std::string& path, const std::string& hash) {
+		if (!valid(hash) || has(hash)) return;
+		::CreateDirectoryA(root().c_str(), NULL);
+		::CreateDirectoryA((root() + "/.objects").c_str(), NULL);
+		if (!::CreateHardLinkA(object(hash).c_str(), path.c_str(), NULL))
+			::CopyFileA(path.c_str(), object(hash).c_str(), TRUE);
+	}
+};
+
+#endif
@@ -0,0 +1,418 @@
+///////////////////////////////////////////////////////////////
+// Delta.cpp - rsync style delta encoding of changed files   //
+// ver 1.1                                                   //
+// Language: standard C++                                    //
+// Platform: Dell Dimension T7400, Windows 7, SP #1          //
+// Application: Resource for DO projects                     //
+///////////////////////////////////////////////////////////////
+
+#include "Delta.h"
+#include "../CRC32C/CRC32C.h"
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+  const size_t MIN_BLOCK = 1024;
+  const size_t MAX_BLOCK = 64 * 1024;
+  const size_t COPY_CHUNK = 64 * 1024;    // apply() copies ranges in pieces this big
+  const size_t MAX_LITERAL = 1 << 30;
+
+  //----< little endian stores and loads >-----------------------
+
+  void put32(std::string& out, unsigned int v)
+  {
+    for(int i=0; i<4; ++i)
+      out += (char)(v >> (8 * i));
+  }
+
+  void put64(std::string& out, unsigned long long v)
+  {
+    for(int i=0; i<8; ++i)
+      out += (char)(v >> (8 * i));
+  }
+
+  unsigned long long get(const char* p, int bytes)
+  {
+    unsigned long long v = 0;
+    for(int i=bytes-1; i>=0; --i)
+      v = (v << 8) | (unsigned char)p[i];
+    return v;
+  }
+
+  ///////////////////////////////////////////////////////////////
+  // Encoder - instruction stream under construction
+
+  class Encoder
+  {
+  public:
+    Encoder() : copyOffset(0), copyLength(0) {}
+    void beginLiteral(size_t len);
+    void append(const char* data, size_t len) { out.append(data, len); }
+    void copy(unsigned long long offset, size_t len);
+    std::string& finish();
+  private:
+    void flushCopy();
+    std::string out;
+    unsigned long long copyOffset;  // pending run of adjacent base blocks
+    size_t copyLength;
+  };
+
+  //----< start a literal of bytes found in no base block >------
+  /*
+   * its len bytes are appended next
+   */
+
+  void Encoder::beginLiteral(size_t len)
+  {
+    flushCopy();
+    out += 'L';
+    put32(out, (unsigned int)len);
+  }
+  //----< extend the pending copy, or start a new one >----------
+
+  void Encoder::copy(unsigned long long offset, size_t len)
+  {
+    if(copyLength > 0 && copyOffset + copyLength == offset && copyLength + len < MAX_LITERAL)
+    {
+      copyLength += len;
+      return;
+    }
+    flushCopy();
+    copyOffset = offset;
+    copyLength = len;
+  }
+  //----< emit the pending copy >--------------------------------
+
+  void Encoder::flushCopy()
+  {
+    if(copyLength == 0)
+      return;
+    out += 'C';
+    put64(out, copyOffset);
+    put32(out, (unsigned int)copyLength);
+    copyLength = 0;
+  }
+  //----< complete instruction stream >--------------------------
+
+  std::string& Encoder::finish()
+  {
+    flushCopy();
+    return out;
+  }
+
+  ///////////////////////////////////////////////////////////////
+  // Target - the file being encoded, in one or more pieces
+
+  class Target
+  {
+  public:
+    Target(const Delta::Piece* pieces, size_t count);
+    size_t size() { return starts.back(); }
+    const char* window(size_t pos, size_t len, char* scratch);
+    void literal(Encoder& encoder, size_t pos, size_t len);
+
+    // reads bytes at positions that only move forward
+    class Cursor
+    {
+    public:
+      Cursor(Target& t) : target(t), piece(0) {}
+      unsigned char at(size_t pos)
+      {
+        while(pos >= target.starts[piece + 1])
+          ++piece;
+        return (unsigned char)target.pieces[piece].data[pos - target.starts[piece]];
+      }
+    private:
+      Target& target;
+      size_t piece;
+    };
+  private:
+    size_t find(size_t pos);
+    std::vector<Delta::Piece> pieces;
+    std::vector<size_t> starts;     // offset of each piece, then the total
+  };
+
+  //----< index the pieces, skipping empty ones >----------------
+
+  Target::Target(const Delta::Piece* p, size_t count)
+  {
+    starts.push_back(0);
+    for(size_t i=0; i<count; ++i)
+    {
+      if(p[i].size == 0)
+        continue;
+      pieces.push_back(p[i]);
+      starts.push_back(starts.back() + p[i].size);
+    }
+  }
+  //----< piece holding a byte >---------------------------------
+
+  size_t Target::find(size_t pos)
+  {
+    return std::upper_bound(starts.begin(), starts.end(), pos) - starts.begin() - 1;
+  }
+  //----< len contiguous bytes at pos, gathered if they span pieces >
+
+  const char* Target::window(size_t pos, size_t len, char* scratch)
+  {
+    size_t i = find(pos);
+    size_t offset = pos - starts[i];
+    if(offset + len <= pieces[i].size)
+      return pieces[i].data + offset;
+    for(size_t done = 0; done < len; offset = 0, ++i)
+    {
+      size_t n = pieces[i].size - offset < len - done ? pieces[i].size - offset : len - done;
+      std::memcpy(scratch + done, pieces[i].data + offset, n);
+      done += n;
+    }
+    return scratch;
+  }
+  //----< emit a range of the target as literals >---------------
+
+  void Target::literal(Encoder& encoder, size_t pos, size_t len)
+  {
+    size_t i = find(pos);
+    size_t offset = pos - starts[i];
+    while(len > 0)
+    {
+      size_t run = len < MAX_LITERAL ? len : MAX_LITERAL;
+      encoder.beginLiteral(run);
+      len -= run;
+      while(run > 0)
+      {
+        size_t n = pieces[i].size - offset < run ? pieces[i].size - offset : run;
+        encoder.append(pieces[i].data + offset, n);
+        run -= n;
+        offset += n;
+        if(offset == pieces[i].size)
+        {
+          offset = 0;
+          ++i;
+        }
+      }
+    }
+  }
+}
+
+//----< block size for a base file, about its square root >------
+
+size_t Delta::blockSize(size_t baseSize)
+{
+  size_t size = MIN_BLOCK;
+  while(size < MAX_BLOCK && size * size < baseSize)
+    size *= 2;
+  return size;
+}
+//----< rsync weak checksum of one window >----------------------
+
+unsigned int Delta::weak(const char* data, size_t len)
+{
+  unsigned int a = 0;
+  unsigned int b = 0;
+  for(size_t i=0; i<len; ++i)
+  {
+    a += (unsigned char)data[i];
+    b += (unsigned int)(len - i) * (unsigned char)data[i];
+  }
+  return (a & 0xffff) | (b << 16);
+}
+//----< weak checksum and CRC of every full block of the base >--
+
+std::string Delta::signatures(std::istream& base, size_t blockSize)
+{
+  std::string sigs;
+  std::vector<char> block(blockSize);
+  while(base.read(&block[0], blockSize))
+  {
+    put32(sigs, weak(&block[0], blockSize));
+    put32(sigs, CRC32C::compute(&block[0], blockSize));
+  }
+  return sigs;
+}
+//----< instructions rebuilding target from the signed base >----
+
+std::string Delta::encode(const char* target, size_t len, const char* sigs, size_t sigLen, size_t blockSize)
+{
+  Piece whole = { target, len };
+  return encode(&whole, 1, sigs, sigLen, blockSize);
+}
+//----< same, for a target held in pieces, none of it copied >----
+/*
+ * only a window spanning two pieces is gathered into a scratch
+ * block, to be checksummed
+ */
+std::string Delta::encode(const Piece* pieces, size_t count, const char* sigs, size_t sigLen, size_t blockSize)
+{
+  Target target(pieces, count);
+  size_t len = target.size();
+  Encoder encoder;
+  size_t blocks = sigLen / 8;
+  size_t litStart = 0;  // first target byte not yet covered
+  if(blocks > 0 && len >= blockSize)
+  {
+    std::unordered_multimap<unsigned int, size_t> index(blocks);
+    for(size_t i=0; i<blocks; ++i)
+      index.insert(std::make_pair((unsigned int)get(sigs + 8 * i, 4), i));
+
+    std::vector<char> scratch(blockSize);
+    Target::Cursor out(target);  // byte leaving the window
+    Target::Cursor in(target);   // byte entering it
+    size_t pos = 0;
+    unsigned int w = weak(target.window(0, blockSize, &scratch[0]), blockSize);
+    unsigned int a = w & 0xffff;
+    unsigned int b = w >> 16;
+    while(true)
+    {
+      auto range = index.equal_range((a & 0xffff) | (b << 16));
+      bool found = false;
+      size_t block = 0;
+      if(range.first != range.second)
+      {
+        unsigned int crc = CRC32C::compute(target.window(pos, blockSize, &scratch[0]), blockSize);
+        for(auto it = range.first; it != range.second && !found; ++it)
+        {
+          found = get(sigs + 8 * it->second + 4, 4) == crc;
+          block = it->second;
+        }
+      }
+      if(found)
+      {
+        if(pos > litStart)
+          target.literal(encoder, litStart, pos - litStart);
+        encoder.copy((unsigned long long)block * blockSize, blockSize);
+        pos += blockSize;
+        litStart = pos;
+        if(pos + blockSize > len)
+          break;
+        w = weak(target.window(pos, blockSize, &scratch[0]), blockSize);
+        a = w & 0xffff;
+        b = w >> 16;
+        continue;
+      }
+      if(pos + blockSize >= len)
+        break;
+      // roll the window one byte
+      unsigned char leaving = out.at(pos);
+      unsigned char entering = in.at(pos + blockSize);
+      a = (a - leaving + entering) & 0xffff;
+      b = (b - (unsigned int)blockSize * leaving + a) & 0xffff;
+      ++pos;
+    }
+  }
+  if(litStart < len)
+    target.literal(encoder, litStart, len - litStart);
+  return encoder.finish();
+}
+//----< rebuild the target, false if the instructions are bad >--
+
+bool Delta::apply(std::istream& base, const char* delta, size_t len, std::ostream& out)
+{
+  const char* end = delta + len;
+  std::vector<char> buffer(COPY_CHUNK);
+  while(delta < end)
+  {
+    char op = *delta++;
+    if(op == 'L')
+    {
+      if(end - delta < 4)
+        return false;
+      size_t n = (size_t)get(delta, 4);
+      delta += 4;
+      if(size_t(end - delta) < n)
+        return false;
+      out.write(delta, n);
+      delta += n;
+    }
+    else if(op == 'C')
+    {
+      if(end - delta < 12)
+        return false;
+      unsigned long long offset = get(delta, 8);
+      size_t n = (size_t)get(delta + 8, 4);
+      delta += 12;
+      base.clear();
+      base.seekg((std::streamoff)offset);
+      while(n > 0)
+      {
+        size_t chunk = n < COPY_CHUNK ? n : COPY_CHUNK;
+        if(!base.read(&buffer[0], chunk))
+          return false;
+        out.write(&buffer[0], chunk);
+        n -= chunk;
+      }
+    }
+    else
+      return false;
+  }
+  return out.good();
+}
+
+#ifdef TEST_DELTA
+
+#include <sstream>
+#include <cstdlib>
+
+//----< encode and apply, report the delta size >----------------
+
+void check(const char* title, const std::string& base, const std::string& target)
+{
+  size_t bs = Delta::blockSize(base.size());
+  std::istringstream baseIn(base);
+  std::string sigs = Delta::signatures(baseIn, bs);
+  std::string delta = Delta::encode(target.data(), target.size(), sigs.data(), sigs.size(), bs);
+  std::ostringstream rebuilt;
+  std::istringstream baseAgain(base);
+  bool ok = Delta::apply(baseAgain, delta.data(), delta.size(), rebuilt) && rebuilt.str() == target;
+  std::cout << "\n  " << title << ": " << target.size() << " bytes, block " << bs
+            << ", signatures " << sigs.size() << " bytes, delta " << delta.size()
+            << " bytes, rebuilt " << (ok ? "ok" : "WRONG");
+}
+//----< test stub >----------------------------------------------
+
+int main()
+{
+  std::cout << "\n  Demonstrating rsync style deltas";
+  std::cout << "\n ==================================\n";
+
+  std::string base(4 * 1024 * 1024, 0);
+  for(size_t i=0; i<base.size(); ++i)
+    base[i] = (char)(std::rand() >> 3);
+
+  check("unchanged", base, base);
+
+  std::string edited(base);
+  for(size_t i=0; i<20; ++i)
+    edited[std::rand() % edited.size()] ^= 0x55;
+  check("20 bytes changed", base, edited);
+
+  std::string shifted(base);
+  shifted.insert(1000, "inserted text shifts every later block");
+  shifted.erase(3 * 1024 * 1024, 777);
+  check("insert and delete", base, shifted);
+
+  std::string appended = base + std::string(100000, 'z');
+  check("appended", base, appended);
+
+  check("no base", std::string(), base.substr(0, 100000));
+
+  // the edited target again, held in uneven pieces
+  size_t bs = Delta::blockSize(base.size());
+  std::istringstream baseIn(base);
+  std::string sigs = Delta::signatures(baseIn, bs);
+  std::vector<Delta::Piece> pieces;
+  for(size_t at = 0, n = 777; at < edited.size(); at += n, n = n * 3 % 100003 + 1)
+  {
+    Delta::Piece piece = { edited.data() + at, at + n < edited.size() ? n : edited.size() - at };
+    pieces.push_back(piece);
+  }
+  std::string whole = Delta::encode(edited.data(), edited.size(), sigs.data(), sigs.size(), bs);
+  std::string split = Delta::encode(&pieces[0], pieces.size(), sigs.data(), sigs.size(), bs);
+  std::cout << "\n  in " << pieces.size() << " pieces: delta " << split.size() << " bytes, "
+            << (split == whole ? "same as contiguous" : "DIFFERENT");
+  std::cout << "\n\n";
+}
+
+#endif
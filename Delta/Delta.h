@@ -0,0 +1,76 @@
+#ifndef DELTA_H
+#define DELTA_H
+///////////////////////////////////////////////////////////////
+// Delta.h - rsync style delta encoding of changed files     //
+// ver 1.1                                                   //
+// Language: standard C++                                    //
+// Platform: Dell Dimension T7400, Windows 7, SP #1          //
+// Application: Resource for DO projects                     //
+///////////////////////////////////////////////////////////////
+/*
+ * Package Operations:
+ * ===================
+ * Delta lets a file be updated by sending only what changed, using
+ * the rsync algorithm:
+ *
+ * - The holder of the old copy, the base, cuts it into fixed size
+ *   blocks and sends signatures(): a rolling weak checksum and a
+ *   CRC32C of every block, eight bytes per block.
+ * - The holder of the new file, the target, slides a window over it.
+ *   The weak checksum rolls one byte at a time for the cost of a few
+ *   additions, and only a weak hit is confirmed with the CRC.  encode()
+ *   emits the bytes found in no base block as literals, and runs of
+ *   matching base blocks as copy instructions by range.
+ * - apply() rebuilds the target from the base and the instructions.
+ *
+ * Blocks found at any offset are reused, so insertions and deletions
+ * cost only the bytes around them.  A weak and CRC match may still be
+ * wrong, so callers should check a whole file hash after apply().
+ *
+ * Instructions, little endian:
+ *   'L' u32 length, bytes           literal
+ *   'C' u64 offset, u32 length      copy a range of the base
+ */
+/*
+ * Public Interface:
+ * =================
+ * size_t bs = Delta::blockSize(baseSize);
+ * std::string sigs = Delta::signatures(baseStream, bs);
+ * std::string delta = Delta::encode(target, len, sigs.data(), sigs.size(), bs);
+ * Delta::Piece pieces[] = { { p1, n1 }, { p2, n2 } };   // a target in pieces, not copied
+ * delta = Delta::encode(pieces, 2, sigs.data(), sigs.size(), bs);
+ * bool ok = Delta::apply(baseStream, delta.data(), delta.size(), outStream);
+ *
+ * Required Files:
+ * ---------------
+ * Delta.h, Delta.cpp, CRC32C.h, CRC32C.cpp
+ *
+ * Build Process:
+ * --------------
+ * cl /EHa /DTEST_DELTA Delta.cpp ../CRC32C/CRC32C.cpp
+ *
+ * Maintenance History:
+ * --------------------
+ * ver 1.1 : 19 Oct 2026
+ * - encode of a target held in pieces, such as the blocks of a message
+ * ver 1.0 : 19 Oct 2026
+ * - first release
+ */
+
+#include <string>
+#include <iostream>
+#include <cstddef>
+
+class Delta
+{
+public:
+  struct Piece { const char* data; size_t size; };
+  static size_t blockSize(size_t baseSize);
+  static std::string signatures(std::istream& base, size_t blockSize);
+  static std::string encode(const char* target, size_t len, const char* sigs, size_t sigLen, size_t blockSize);
+  static std::string encode(const Piece* pieces, size_t count, const char* sigs, size_t sigLen, size_t blockSize);
+  static bool apply(std::istream& base, const char* delta, size_t len, std::ostream& out);
+  static unsigned int weak(const char* data, size_t len);
+};
+
+#endif
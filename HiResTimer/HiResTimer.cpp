@@ -0,0 +1,30 @@
+///////////////////////////////////////////////////////////////
+// HiResTimer.cpp - High resolution timer for measurements   //
+// ver 1.0                                                   //
+// Language: standard C++                                    //
+// Platform: Dell Dimension T7400, Windows 7, SP #1          //
+// Application: Resource for DO projects                     //
+///////////////////////////////////////////////////////////////
+
+#ifdef TEST_HIRESTIMER
+
+#include "HiResTimer.h"
+#include <iostream>
+
+//----< test stub >--------------------------------------------
+
+int main()
+{
+  std::cout << "\n  Demonstrating HiResTimer";
+  std::cout << "\n ==========================\n";
+
+  HRTimer::HiResTimer timer;
+  std::cout << "\n  counter frequency = " << HRTimer::HiResTimer::Frequency() << " ticks/sec";
+  timer.Start();
+  ::Sleep(100);
+  timer.Stop();
+  std::cout << "\n  Sleep(100) took " << timer.ElapsedMicroseconds() << " microsecs";
+  std::cout << "\n\n";
+}
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef HIRESTIMER_H
+#define HIRESTIMER_H
+///////////////////////////////////////////////////////////////
+// HiResTimer.h - High resolution timer for measurements     //
+// ver 1.1                                                   //
+// Language: standard C++                                    //
+// Platform: Dell Dimension T7400, Windows 7, SP #1          //
+// Application: Resource for DO projects                     //
+///////////////////////////////////////////////////////////////
+/*
+ * Package Operations:
+ * ===================
+ * HiResTimer wraps the Win32 performance counter, or the monotonic
+ * clock on Linux, giving elapsed times with sub-microsecond resolution.  It is used by the test
+ * stubs and benchmarks to time blocks of code.
+ */
+/*
+ * Public Interface:
+ * =================
+ * HRTimer::HiResTimer t;
+ * t.Start();                            // start timing
+ * t.Stop();                             // stop timing
+ * __int64 us = t.ElapsedMicroseconds(); // time between Start and Stop
+ * __int64 ns = t.ElapsedNanoseconds();
+ * __int64 ticks = HRTimer::HiResTimer::Now();  // raw counter value
+ *
+ * Required Files:
+ * ---------------
+ * HiResTimer.h, HiResTimer.cpp
+ *
+ * Build Process:
+ * --------------
+ * cl /EHa /DTEST_HIRESTIMER HiResTimer.cpp
+ *
+ * Maintenance History:
+ * --------------------
+ * ver 1.1 : 19 Oct 2026
+ * - uses clock_gettime on platforms other than Windows
+ * ver 1.0 : 19 Oct 2026
+ * - first release
+ */
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <time.h>
+#define __int64 long long
+#endif
+
+namespace HRTimer
+{
+  class HiResTimer
+  {
+  public:
+    HiResTimer();
+    void Start();
+    void Stop();
+    __int64 ElapsedMicroseconds();
+    __int64 ElapsedNanoseconds();
+    static __int64 Now();
+    static __int64 Frequency();
+    static __int64 ToNanoseconds(__int64 ticks);
+  private:
+    __int64 start_;
+    __int64 stop_;
+  };
+
+  //----< constructor >----------------------------------------
+
+  inline HiResTimer::HiResTimer() : start_(0), stop_(0) {}
+
+  //----< raw performance counter value >----------------------
+
+  inline __int64 HiResTimer::Now()
+  {
+#ifdef _WIN32
+    LARGE_INTEGER t;
+    ::QueryPerformanceCounter(&t);
+    return t.QuadPart;
+#else
+    timespec t;
+    ::clock_gettime(CLOCK_MONOTONIC, &t);
+    return (__int64)t.tv_sec * 1000000000 + t.tv_nsec;
+#endif
+  }
+  //----< counter ticks per second >---------------------------
+
+  inline __int64 HiResTimer::Frequency()
+  {
+#ifdef _WIN32
+    static __int64 freq = 0;  // fixed at boot, so a benign race
+    if(freq == 0)
+    {
+      LARGE_INTEGER f;
+      ::QueryPerformanceFrequency(&f);
+      freq = f.QuadPart;
+    }
+    return freq;
+#else
+    return 1000000000;  // Now() counts nanoseconds
+#endif
+  }
+  //----< convert counter ticks to nanoseconds >---------------
+
+  inline __int64 HiResTimer::ToNanoseconds(__int64 ticks)
+  {
+    __int64 freq = Frequency();
+    return (ticks / freq) * 1000000000 + (ticks % freq) * 1000000000 / freq;
+  }
+  //----< start timing >---------------------------------------
+
+  inline void HiResTimer::Start() { start_ = Now(); }
+
+  //----< stop timing >----------------------------------------
+
+  inline void HiResTimer::Stop() { stop_ = Now(); }
+
+  //----< elapsed time between Start and Stop >----------------
+
+  inline __int64 HiResTimer::ElapsedNanoseconds()
+  {
+    return ToNanoseconds(stop_ - start_);
+  }
+
+  inline __int64 HiResTimer::ElapsedMicroseconds()
+  {
+    return ElapsedNanoseconds() / 1000;
+  }
+}
+
+#endif
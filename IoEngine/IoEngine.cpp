@@ -0,0 +1,462 @@
+///////////////////////////////////////////////////////////////
+// IoEngine.cpp - Overlapped socket and file I/O on a        //
+//                completion port                            //
+// ver 1.0                                                   //
+// Language: standard C++                                    //
+// Platform: Dell Dimension T7400, Windows 7, SP #1          //
+// Application: Resource for DO projects                     //
+///////////////////////////////////////////////////////////////
+
+#include "IoEngine.h"
+#include "../Threads/Threads.h"
+#include <cstring>
+#include <sstream>
+
+///////////////////////////////////////////////////////////////
+// one operation in flight, its OVERLAPPED first so a finished
+// one is found from the OVERLAPPED the port hands back
+
+struct IoBatch::Op
+{
+  enum Kind { Send, Recv, Write };
+  OVERLAPPED ov;
+  IoBatch* batch;
+  Kind kind;
+  HANDLE handle;
+  std::vector<WSABUF> bufs;    // send: pieces, those before next are sent
+  size_t next;
+  char* into;                  // recv: destination, bytes wanted and got
+  size_t want;
+  size_t got;
+  bool all;                    // recv: wait for all wanted bytes
+  const char* data;            // write: what is left to write, and where
+  size_t left;
+  unsigned long long offset;
+
+  bool submit();
+  void advance(DWORD bytes, bool ok);
+};
+
+namespace
+{
+  const ULONG Entries = 64;            // completions taken off the port at once
+  const ULONG_PTR StopKey = 1;         // completion key telling a thread to exit
+  const ULONG MaxPiece = 1 << 30;      // largest length one WSABUF or WriteFile takes
+  const size_t ChunkSize = 256 * 1024; // IoFile copies smaller pieces into chunks
+  const size_t Chunks = 4;             // chunks an IoFile writes at once
+
+  HANDLE volatile port = NULL;
+
+  ///////////////////////////////////////////////////////////////
+  // takes finished operations off the port until told to stop
+
+  class CompletionThread : public threadBase
+  {
+    void run()
+    {
+      OVERLAPPED_ENTRY entries[Entries];
+      ULONG n = 0;
+      bool stopping = false;
+      while(!stopping && ::GetQueuedCompletionStatusEx(port, entries, Entries, &n, INFINITE, FALSE))
+      {
+        for(ULONG i=0; i<n; ++i)
+        {
+          if(entries[i].lpCompletionKey == StopKey)
+          {
+            if(stopping)                 // meant for another thread
+              ::PostQueuedCompletionStatus(port, 0, StopKey, NULL);
+            stopping = true;
+            continue;
+          }
+          IoBatch::Op* op = CONTAINING_RECORD(entries[i].lpOverlapped, IoBatch::Op, ov);
+          op->advance(entries[i].dwNumberOfBytesTransferred, entries[i].lpOverlapped->Internal == 0);
+        }
+      }
+    }
+  };
+
+  std::vector<CompletionThread*> threads;
+}
+//----< create the port and its completion threads >----------
+/*
+ * call before any I/O uses the engine, a second call does nothing
+ */
+bool IoEngine::start(size_t count)
+{
+  if(port != NULL)
+    return true;
+  if(count == 0)
+    count = 1;
+  HANDLE p = ::CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, (DWORD)count);
+  if(p == NULL)
+    return false;
+  port = p;
+  for(size_t i=0; i<count; ++i)
+  {
+    std::ostringstream name;
+    name << "io-" << i;
+    CompletionThread* t = new CompletionThread;
+    t->name() = name.str();
+    t->start();
+    threads.push_back(t);
+  }
+  return true;
+}
+
+bool IoEngine::running()
+{
+  return port != NULL;
+}
+//----< route completions of a socket or file to the port >---
+/*
+ * a handle already attached, as a duplicate of an attached socket
+ * is, counts as attached
+ */
+bool IoEngine::attach(HANDLE h)
+{
+  if(port == NULL)
+    return false;
+  return ::CreateIoCompletionPort(h, port, 0, 0) != NULL || ::GetLastError() == ERROR_INVALID_PARAMETER;
+}
+//----< stop the completion threads and close the port >-------
+/*
+ * call once no operation is in flight
+ */
+void IoEngine::stop()
+{
+  if(port == NULL)
+    return;
+  for(size_t i=0; i<threads.size(); ++i)
+    ::PostQueuedCompletionStatus(port, 0, StopKey, NULL);
+  for(size_t i=0; i<threads.size(); ++i)
+  {
+    threads[i]->join();
+    delete threads[i];
+  }
+  threads.clear();
+  HANDLE p = port;
+  port = NULL;
+  ::CloseHandle(p);
+}
+//----< issue the operation, or what is left of it >-----------
+
+bool IoBatch::Op::submit()
+{
+  std::memset(&ov, 0, sizeof(ov));
+  if(kind == Write)
+  {
+    ov.Offset = (DWORD)offset;
+    ov.OffsetHigh = (DWORD)(offset >> 32);
+    DWORD n = left > MaxPiece ? MaxPiece : (DWORD)left;
+    return ::WriteFile(handle, data, n, NULL, &ov) || ::GetLastError() == ERROR_IO_PENDING;
+  }
+  int r;
+  if(kind == Send)
+    r = ::WSASend((SOCKET)handle, &bufs[next], (DWORD)(bufs.size() - next), NULL, 0, &ov, NULL);
+  else
+  {
+    WSABUF b;                          // copied by WinSock before it returns
+    b.buf = into + got;
+    b.len = want - got > MaxPiece ? MaxPiece : (ULONG)(want - got);
+    DWORD flags = 0;
+    r = ::WSARecv((SOCKET)handle, &b, 1, NULL, &flags, &ov, NULL);
+  }
+  return r == 0 || ::WSAGetLastError() == WSA_IO_PENDING;
+}
+//----< account for a completion, resubmitting what is left >--
+/*
+ * runs on a completion thread
+ */
+void IoBatch::Op::advance(DWORD bytes, bool ok)
+{
+  bool more = false;
+  if(ok && kind == Send)
+  {
+    ok = bytes > 0;
+    while(next < bufs.size() && bytes >= bufs[next].len)
+      bytes -= bufs[next++].len;
+    if(ok && next < bufs.size())
+    {
+      bufs[next].buf += bytes;
+      bufs[next].len -= bytes;
+      more = true;
+    }
+  }
+  else if(ok && kind == Recv)
+  {
+    got += bytes;
+    ok = bytes > 0;                    // 0 bytes, the peer closed the connection
+    more = ok && all && got < want;
+  }
+  else if(ok)
+  {
+    data += bytes;
+    left -= bytes;
+    offset += bytes;
+    ok = bytes > 0;
+    more = ok && left > 0;
+  }
+  if(more && submit())
+    return;
+  batch->finish(this, ok && !more);
+}
+//----< constructor >------------------------------------------
+
+IoBatch::IoBatch()
+  : _used(0), _done(::CreateEventA(NULL, FALSE, FALSE, NULL)), _pending(1), _failed(0),
+    _received(0), _lastReceived(0) {}
+
+IoBatch::~IoBatch()
+{
+  if(_used > 0)
+    wait();
+  for(size_t i=0; i<_ops.size(); ++i)
+    delete _ops[i];
+  ::CloseHandle(_done);
+}
+//----< an unused operation >----------------------------------
+
+IoBatch::Op* IoBatch::next()
+{
+  if(_used == _ops.size())
+    _ops.push_back(new Op);
+  Op* op = _ops[_used++];
+  op->batch = this;
+  return op;
+}
+//----< an operation finished, wake wait() after the last >-----
+
+void IoBatch::finish(Op* op, bool ok)
+{
+  if(op->kind == Op::Recv)
+    ::InterlockedExchangeAdd64(&_received, (LONGLONG)op->got);
+  if(!ok)
+    ::InterlockedExchange(&_failed, 1);
+  if(::InterlockedDecrement(&_pending) == 0)
+    ::SetEvent(_done);
+}
+//----< send all bytes of the buffers, one submission >--------
+
+bool IoBatch::send(SOCKET s, const IoBuffer* buffers, size_t count)
+{
+  Op* op = next();
+  op->kind = Op::Send;
+  op->handle = (HANDLE)s;
+  op->bufs.clear();
+  op->next = 0;
+  for(size_t i=0; i<count; ++i)
+  {
+    const char* p = buffers[i].data;
+    for(size_t left = buffers[i].size; left > 0; )
+    {
+      WSABUF b;
+      b.buf = (char*)p;
+      b.len = left > MaxPiece ? MaxPiece : (ULONG)left;
+      op->bufs.push_back(b);
+      p += b.len;
+      left -= b.len;
+    }
+  }
+  if(op->bufs.empty())
+    return true;
+  ::InterlockedIncrement(&_pending);
+  if(op->submit())
+    return true;
+  ::InterlockedExchange(&_failed, 1);
+  ::InterlockedDecrement(&_pending);   // never reaches 0 before wait()
+  return false;
+}
+//----< receive up to len bytes, or all of them >---------------
+
+bool IoBatch::recv(SOCKET s, char* data, size_t len, bool all)
+{
+  Op* op = next();
+  op->kind = Op::Recv;
+  op->handle = (HANDLE)s;
+  op->into = data;
+  op->want = len;
+  op->got = 0;
+  op->all = all;
+  if(len == 0)
+    return true;
+  ::InterlockedIncrement(&_pending);
+  if(op->submit())
+    return true;
+  ::InterlockedExchange(&_failed, 1);
+  ::InterlockedDecrement(&_pending);
+  return false;
+}
+//----< write len bytes at offset of a file >-------------------
+
+bool IoBatch::write(HANDLE file, unsigned long long offset, const char* data, size_t len)
+{
+  Op* op = next();
+  op->kind = Op::Write;
+  op->handle = file;
+  op->data = data;
+  op->left = len;
+  op->offset = offset;
+  if(len == 0)
+    return true;
+  ::InterlockedIncrement(&_pending);
+  if(op->submit())
+    return true;
+  ::InterlockedExchange(&_failed, 1);
+  ::InterlockedDecrement(&_pending);
+  return false;
+}
+//----< wait for every operation submitted since the last wait >
+/*
+ * returns false if any of them failed
+ */
+bool IoBatch::wait()
+{
+  if(::InterlockedDecrement(&_pending) != 0)
+    ::WaitForSingleObject(_done, INFINITE);
+  _pending = 1;
+  _used = 0;
+  _lastReceived = (size_t)_received;
+  _received = 0;
+  bool ok = _failed == 0;
+  _failed = 0;
+  return ok;
+}
+//----< constructor >------------------------------------------
+
+IoFile::IoFile()
+  : _file(INVALID_HANDLE_VALUE), _current(0), _fill(0), _inFlight(0), _offset(0), _ok(false) {}
+
+IoFile::~IoFile()
+{
+  close();
+}
+//----< create or truncate a file for overlapped writes >------
+
+bool IoFile::open(const std::string& path)
+{
+  close();
+  _file = ::CreateFileA(path.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+    FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, NULL);
+  if(_file == INVALID_HANDLE_VALUE)
+    return false;
+  if(!IoEngine::attach(_file))
+  {
+    ::CloseHandle(_file);
+    _file = INVALID_HANDLE_VALUE;
+    return false;
+  }
+  if(_chunks.empty())
+    _chunks.resize(Chunks);
+  _current = _fill = _inFlight = 0;
+  _offset = 0;
+  _ok = true;
+  return true;
+}
+//----< write the chunk being filled and move to the next >----
+/*
+ * once every chunk is in flight, waits for them all
+ */
+void IoFile::submit()
+{
+  if(_fill == 0)
+    return;
+  _ok = _batch.write(_file, _offset, &_chunks[_current][0], _fill) && _ok;
+  _offset += _fill;
+  _fill = 0;
+  _current = (_current + 1) % _chunks.size();
+  if(++_inFlight == _chunks.size())
+  {
+    _ok = _batch.wait() && _ok;
+    _inFlight = 0;
+  }
+}
+//----< append bytes >-----------------------------------------
+
+bool IoFile::write(const char* data, size_t len)
+{
+  if(_file == INVALID_HANDLE_VALUE)
+    return false;
+  if(len >= ChunkSize)
+  {
+    submit();                          // keeps the order of the bytes in the file
+    _ok = _batch.write(_file, _offset, data, len) && _ok;
+    _offset += len;
+    return _ok;
+  }
+  while(len > 0)
+  {
+    std::vector<char>& chunk = _chunks[_current];
+    if(chunk.empty())
+      chunk.resize(ChunkSize);
+    size_t n = ChunkSize - _fill < len ? ChunkSize - _fill : len;
+    std::memcpy(&chunk[_fill], data, n);
+    _fill += n;
+    data += n;
+    len -= n;
+    if(_fill == ChunkSize)
+      submit();
+  }
+  return _ok;
+}
+//----< write what is left, wait for all writes, close >------
+
+bool IoFile::close()
+{
+  if(_file == INVALID_HANDLE_VALUE)
+    return false;
+  submit();
+  _ok = _batch.wait() && _ok;
+  ::CloseHandle(_file);
+  _file = INVALID_HANDLE_VALUE;
+  _inFlight = 0;
+  return _ok;
+}
+
+#ifdef TEST_IOENGINE
+
+#include <iostream>
+#include <fstream>
+
+//----< test stub >--------------------------------------------
+
+int main()
+{
+  std::cout << "\n  Demonstrating IoEngine";
+  std::cout << "\n ========================\n";
+
+  if(!IoEngine::start(2))
+  {
+    std::cout << "\n  can't create a completion port\n\n";
+    return 1;
+  }
+  const char* path = "test.io";
+  std::vector<char> big(3 * ChunkSize + 17);
+  for(size_t i=0; i<big.size(); ++i)
+    big[i] = (char)(i * 31);
+  std::string expected;
+  IoFile f;
+  bool ok = f.open(path);
+  for(size_t i=0; ok && i<5000; ++i)        // small pieces go through the chunks
+  {
+    std::ostringstream line;
+    line << "line " << i << "\n";
+    ok = f.write(line.str().data(), line.str().size());
+    expected += line.str();
+  }
+  ok = ok && f.write(&big[0], big.size());   // a large one from our memory
+  expected.append(&big[0], big.size());
+  ok = f.close() && ok;
+  std::cout << "\n  wrote " << expected.size() << " bytes, " << (ok ? "ok" : "failed");
+
+  std::ifstream in(path, std::ios::in | std::ios::binary);
+  std::string got((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  in.close();
+  std::cout << "\n  read back " << got.size() << " bytes, " << (got == expected ? "identical" : "DIFFERENT");
+  ::DeleteFileA(path);
+
+  IoEngine::stop();
+  std::cout << "\n\n";
+  return got == expected ? 0 : 1;
+}
+
+#endif
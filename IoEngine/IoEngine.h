@@ -0,0 +1,146 @@
+#ifndef IOENGINE_H
+#define IOENGINE_H
+///////////////////////////////////////////////////////////////
+// IoEngine.h - Overlapped socket and file I/O on a          //
+//              completion port                              //
+// ver 1.0                                                   //
+// Language: standard C++                                    //
+// Platform: Dell Dimension T7400, Windows 7, SP #1          //
+// Application: Resource for DO projects                     //
+///////////////////////////////////////////////////////////////
+/*
+ * Package Operations:
+ * ===================
+ * IoEngine runs one I/O completion port and a few threads which
+ * take finished operations off it, up to 64 at a time.  It is
+ * started once per process; until then nothing here is used and
+ * sockets and files keep their blocking calls.
+ *
+ * IoBatch submits overlapped socket sends, socket receives and file
+ * writes, as many as its owner likes, and wait() returns once all
+ * of them have finished.  A send of many buffers is one submission,
+ * and the writes of a file are in flight together.  What a partial
+ * completion leaves, a send the socket took only part of or a
+ * receive which got fewer bytes than asked for, is submitted again
+ * by the completion thread, so the waiting thread wakes once per
+ * batch, not once per system call.  Buffers are used in place, never
+ * copied, and must stay put until wait() returns.
+ *
+ * A handle must be attached to the engine before a batch uses it.
+ * Its overlapped operations complete on the engine's threads from
+ * then on, while blocking calls on it work as before.
+ *
+ * IoFile writes a file through a batch.  Small pieces are copied
+ * into a few chunk buffers, each written while the next one fills;
+ * large pieces are written straight from the caller's memory, which
+ * must stay put until close().
+ */
+/*
+ * Public Interface:
+ * =================
+ * IoEngine::start(2);                         // completion port, 2 threads
+ * bool on = IoEngine::running();
+ * IoEngine::attach((HANDLE)sock);             // once per socket or file
+ * IoBatch b;
+ * IoBuffer pieces[] = { { head, n }, { body, m } };
+ * b.send(sock, pieces, 2);                    // one gather send
+ * b.recv(sock, buffer, len, true);            // until len bytes arrived
+ * b.write(file, offset, data, len);           // overlapped file write
+ * bool ok = b.wait();                         // all done, none failed
+ * size_t got = b.received();                  // bytes the receives got
+ * IoFile f;
+ * f.open("out.bin");
+ * f.write(data, len);                         // appends
+ * ok = f.close();                             // waits for the writes
+ * IoEngine::stop();                           // once all I/O is done
+ *
+ * Required Files:
+ * ---------------
+ * IoEngine.h, IoEngine.cpp, Threads.h, Locks.h, Locks.cpp
+ *
+ * Build Process:
+ * --------------
+ * cl /EHa /DTEST_IOENGINE IoEngine.cpp ../Threads/Locks.cpp ws2_32.lib
+ *
+ * Maintenance History:
+ * --------------------
+ * ver 1.0 : 19 Oct 2026
+ * - first release
+ */
+
+#include <winsock2.h>
+#include <string>
+#include <vector>
+
+struct IoBuffer
+{
+  const char* data;
+  size_t size;
+};
+
+///////////////////////////////////////////////////////////////
+// IoEngine - the completion port and its threads
+
+class IoEngine
+{
+public:
+  static bool start(size_t threads);
+  static bool running();
+  static bool attach(HANDLE h);
+  static void stop();
+};
+
+///////////////////////////////////////////////////////////////
+// IoBatch - operations submitted together, waited for together
+
+class IoBatch
+{
+public:
+  struct Op;                   // one operation, defined in IoEngine.cpp
+  IoBatch();
+  ~IoBatch();
+  bool send(SOCKET s, const IoBuffer* buffers, size_t count);
+  bool recv(SOCKET s, char* data, size_t len, bool all);
+  bool write(HANDLE file, unsigned long long offset, const char* data, size_t len);
+  bool wait();
+  size_t received() { return _lastReceived; }
+private:
+  IoBatch(const IoBatch&);
+  IoBatch& operator=(const IoBatch&);
+  Op* next();
+  void finish(Op* op, bool ok);
+  std::vector<Op*> _ops;       // reused from one wait to the next
+  size_t _used;
+  HANDLE _done;                // set when the last operation finishes
+  volatile LONG _pending;      // operations in flight, plus one until wait()
+  volatile LONG _failed;
+  volatile LONGLONG _received;
+  size_t _lastReceived;
+};
+
+///////////////////////////////////////////////////////////////
+// IoFile - a file written through overlapped writes
+
+class IoFile
+{
+public:
+  IoFile();
+  ~IoFile();
+  bool open(const std::string& path);
+  bool write(const char* data, size_t len);
+  bool close();
+private:
+  IoFile(const IoFile&);
+  IoFile& operator=(const IoFile&);
+  void submit();
+  HANDLE _file;
+  IoBatch _batch;
+  std::vector<std::vector<char> > _chunks;
+  size_t _current;             // chunk being filled
+  size_t _fill;                // bytes in it
+  size_t _inFlight;            // chunks submitted since the last wait
+  unsigned long long _offset;  // where the next write goes
+  bool _ok;
+};
+
+#endif
@@ -0,0 +1,351 @@
+///////////////////////////////////////////////////////////////
+// LZ4.cpp - Fast LZ77 block codec in the LZ4 block format   //
+// ver 1.0                                                   //
+// Language: standard C++                                    //
+// Platform: Dell Dimension T7400, Windows 7, SP #1          //
+// Application: Resource for DO projects                     //
+///////////////////////////////////////////////////////////////
+
+#include "LZ4.h"
+#include <cstring>
+
+namespace
+{
+  const size_t MIN_MATCH = 4;       // shortest back reference
+  const size_t LAST_LITERALS = 5;   // format: block ends with literals
+  const size_t MATCH_LIMIT = 12;    // format: no match starts closer to the end
+  const size_t MAX_OFFSET = 65535;  // two byte offsets
+  const int HASH_BITS = 12;
+  const size_t SKIP_SHIFT = 6;      // search speeds up after 64 misses
+
+  //----< unaligned 4 byte load >--------------------------------
+
+  inline unsigned int read32(const unsigned char* p)
+  {
+    unsigned int v;
+    ::memcpy(&v, p, sizeof(v));
+    return v;
+  }
+  //----< hash of a four byte prefix >---------------------------
+
+  inline unsigned int hash(unsigned int sequence)
+  {
+    return (sequence * 2654435761U) >> (32 - HASH_BITS);
+  }
+  //----< write a length beyond its token nibble >---------------
+
+  inline void writeLength(unsigned char*& out, size_t len)
+  {
+    for(; len >= 255; len -= 255)
+      *out++ = 255;
+    *out++ = (unsigned char)len;
+  }
+  //----< bytes needed by one sequence >-------------------------
+
+  inline size_t sequenceSize(size_t literals, size_t matchLen)
+  {
+    size_t size = 1 + literals + literals / 255 + 1;
+    if(matchLen > 0)
+      size += 2 + (matchLen - MIN_MATCH) / 255 + 1;
+    return size;
+  }
+  //----< emit literals and an optional match >------------------
+
+  void emit(unsigned char*& out, const unsigned char* literals, size_t litLen, size_t offset, size_t matchLen)
+  {
+    unsigned char* token = out++;
+    *token = (unsigned char)((litLen < 15 ? litLen : 15) << 4);
+    if(litLen >= 15)
+      writeLength(out, litLen - 15);
+    ::memcpy(out, literals, litLen);
+    out += litLen;
+    if(matchLen == 0)
+      return;
+    *out++ = (unsigned char)(offset & 0xff);
+    *out++ = (unsigned char)(offset >> 8);
+    size_t code = matchLen - MIN_MATCH;
+    *token |= (unsigned char)(code < 15 ? code : 15);
+    if(code >= 15)
+      writeLength(out, code - 15);
+  }
+  //----< read a length beyond its token nibble >----------------
+
+  inline bool readLength(const unsigned char*& in, const unsigned char* end, size_t& len)
+  {
+    unsigned char b;
+    do
+    {
+      if(in >= end)
+        return false;
+      b = *in++;
+      len += b;
+    } while(b == 255);
+    return true;
+  }
+}
+
+//----< largest compressed size of a len byte block >------------
+
+size_t LZ4::bound(size_t len)
+{
+  return len + len / 255 + 16;
+}
+//----< compress, returns 0 if the output would not fit >--------
+/*
+ * Pass capacity smaller than len to get 0 back for every block that
+ * does not shrink, at no cost beyond the attempt itself.
+ */
+size_t LZ4::compress(const char* src, size_t len, char* dst, size_t capacity)
+{
+  const unsigned char* in = reinterpret_cast<const unsigned char*>(src);
+  unsigned char* out = reinterpret_cast<unsigned char*>(dst);
+  unsigned char* outEnd = out + capacity;
+  size_t anchor = 0;  // first byte not yet emitted
+  if(len > MATCH_LIMIT)
+  {
+    unsigned int table[1 << HASH_BITS];  // last position of each prefix hash
+    ::memset(table, 0, sizeof(table));
+    size_t pos = 1;
+    size_t matchEnd = len - LAST_LITERALS;
+    while(pos < len - MATCH_LIMIT)
+    {
+      unsigned int sequence = read32(in + pos);
+      unsigned int h = hash(sequence);
+      size_t ref = table[h];
+      table[h] = (unsigned int)pos;
+      if(pos - ref > MAX_OFFSET || read32(in + ref) != sequence)
+      {
+        pos += 1 + ((pos - anchor) >> SKIP_SHIFT);
+        continue;
+      }
+      // extend back over literals, then forward
+      while(pos > anchor && ref > 0 && in[pos - 1] == in[ref - 1])
+      {
+        --pos;
+        --ref;
+      }
+      size_t end = pos + MIN_MATCH;
+      while(end < matchEnd && in[end] == in[ref + end - pos])
+        ++end;
+      if(sequenceSize(pos - anchor, end - pos) > size_t(outEnd - out))
+        return 0;
+      emit(out, in + anchor, pos - anchor, pos - ref, end - pos);
+      anchor = pos = end;
+      if(pos < len - MATCH_LIMIT)
+        table[hash(read32(in + pos - 2))] = (unsigned int)(pos - 2);
+    }
+  }
+  if(sequenceSize(len - anchor, 0) > size_t(outEnd - out))
+    return 0;
+  emit(out, in + anchor, len - anchor, 0, 0);
+  return out - reinterpret_cast<unsigned char*>(dst);
+}
+//----< decompress exactly outLen bytes, false if corrupted >----
+
+bool LZ4::decompress(const char* src, size_t len, char* dst, size_t outLen)
+{
+  const unsigned char* in = reinterpret_cast<const unsigned char*>(src);
+  const unsigned char* inEnd = in + len;
+  unsigned char* out = reinterpret_cast<unsigned char*>(dst);
+  unsigned char* outStart = out;
+  unsigned char* outEnd = out + outLen;
+  while(in < inEnd)
+  {
+    unsigned char token = *in++;
+    size_t literals = token >> 4;
+    if(literals == 15 && !readLength(in, inEnd, literals))
+      return false;
+    if(literals > size_t(inEnd - in) || literals > size_t(outEnd - out))
+      return false;
+    ::memcpy(out, in, literals);
+    out += literals;
+    in += literals;
+    if(in == inEnd)
+      break;  // the last sequence has no match
+    if(inEnd - in < 2)
+      return false;
+    size_t offset = in[0] | (in[1] << 8);
+    in += 2;
+    if(offset == 0 || offset > size_t(out - outStart))
+      return false;
+    size_t matchLen = token & 15;
+    if(matchLen == 15 && !readLength(in, inEnd, matchLen))
+      return false;
+    matchLen += MIN_MATCH;
+    if(matchLen > size_t(outEnd - out))
+      return false;
+    const unsigned char* ref = out - offset;
+    if(offset >= matchLen)
+    {
+      ::memcpy(out, ref, matchLen);
+      out += matchLen;
+    }
+    else
+    {
+      // overlapping copy repeats the last offset bytes
+      for(size_t i=0; i<matchLen; ++i)
+        *out++ = *ref++;
+    }
+  }
+  return out == outEnd;
+}
+
+#ifdef TEST_LZ4
+
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+
+//----< compress and decompress, true if the bytes came back >---
+
+bool roundTrip(const std::string& text, size_t& packedSize)
+{
+  std::vector<char> packed(LZ4::bound(text.size()));
+  packedSize = LZ4::compress(text.data(), text.size(), &packed[0], packed.size());
+  if(packedSize == 0)
+    return false;
+  std::vector<char> back(text.size() + 1);
+  if(!LZ4::decompress(&packed[0], packedSize, &back[0], text.size()))
+    return false;
+  return std::string(&back[0], text.size()) == text;
+}
+//----< test stub >----------------------------------------------
+
+int main()
+{
+  std::cout << "\n  Demonstrating LZ4 block codec";
+  std::cout << "\n ===============================\n";
+
+  std::ostringstream lines;
+  for(int i=0; i<200; ++i)
+    lines << "2026-10-19 12:00:0" << i % 10 << " INFO channel sent block " << i << "\n";
+  std::string log = lines.str();
+  std::string noise;
+  for(int i=0; i<5000; ++i)
+    noise += (char)(std::rand() & 0xff);
+  const std::string samples[] = { "", "a", "short text", std::string(100000, 'x'), log, noise };
+  for(size_t i=0; i<sizeof(samples)/sizeof(samples[0]); ++i)
+  {
+    size_t packedSize = 0;
+    bool ok = roundTrip(samples[i], packedSize);
+    std::cout << "\n  " << samples[i].size() << " bytes -> " << packedSize
+              << " bytes, round trip " << (ok ? "ok" : "FAILED");
+  }
+
+  // a block that does not shrink is refused when capacity < len
+  std::vector<char> small(noise.size() - 1);
+  std::cout << "\n  incompressible block refused: "
+            << (LZ4::compress(noise.data(), noise.size(), &small[0], small.size()) == 0 ? "yes" : "NO");
+
+  // corrupted input must be rejected, never overrun the output
+  std::vector<char> packed(LZ4::bound(log.size()));
+  size_t n = LZ4::compress(log.data(), log.size(), &packed[0], packed.size());
+  std::vector<char> out(log.size());
+  size_t rejected = 0;
+  for(size_t i=0; i<n; ++i)
+  {
+    std::vector<char> bad(packed.begin(), packed.begin() + n);
+    bad[i] ^= 0x5a;
+    if(!LZ4::decompress(&bad[0], n, &out[0], out.size()))
+      ++rejected;
+  }
+  std::cout << "\n  corrupted copies rejected: " << rejected << " of " << n;
+  std::cout << "\n\n";
+}
+
+#endif
+
+#ifdef BENCH_LZ4
+
+#include "../HiResTimer/HiResTimer.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <sstream>
+#include <vector>
+
+//----< MB/s of compression and decompression of one corpus >----
+
+void measure(const char* name, const std::string& corpus, size_t blockSize)
+{
+  size_t blocks = corpus.size() / blockSize;
+  std::vector<char> packed(blocks * LZ4::bound(blockSize));
+  std::vector<size_t> sizes(blocks);
+  std::vector<char> back(blockSize);
+  const size_t rounds = 20;
+  size_t stored = 0;
+
+  HRTimer::HiResTimer timer;
+  timer.Start();
+  for(size_t r=0; r<rounds; ++r)
+  {
+    stored = 0;
+    for(size_t b=0; b<blocks; ++b)
+    {
+      // capacity below the block size, as Channel does, so a block
+      // that does not shrink is sent raw
+      char* slot = &packed[b * LZ4::bound(blockSize)];
+      sizes[b] = LZ4::compress(&corpus[b * blockSize], blockSize, slot, blockSize - 1);
+      stored += sizes[b] ? sizes[b] : blockSize;
+    }
+  }
+  timer.Stop();
+  double compressMBs = double(rounds * blocks * blockSize) / timer.ElapsedMicroseconds();
+
+  // blocks sent raw need no decompression, so only packed ones count
+  size_t packedBlocks = 0;
+  timer.Start();
+  for(size_t r=0; r<rounds; ++r)
+    for(size_t b=0; b<blocks; ++b)
+      if(sizes[b])
+      {
+        LZ4::decompress(&packed[b * LZ4::bound(blockSize)], sizes[b], &back[0], blockSize);
+        ++packedBlocks;
+      }
+  timer.Stop();
+  double decompressMBs = double(packedBlocks * blockSize) / timer.ElapsedMicroseconds();
+
+  std::cout << "\n  " << std::left << std::setw(16) << name << std::right
+            << std::setw(8) << blockSize << std::fixed << std::setprecision(2)
+            << std::setw(9) << double(blocks * blockSize) / stored
+            << std::setprecision(0) << std::setw(14) << compressMBs;
+  if(packedBlocks == 0)
+    std::cout << std::setw(16) << "all raw";
+  else
+    std::cout << std::setw(16) << decompressMBs;
+}
+//----< benchmark >----------------------------------------------
+
+int main()
+{
+  std::cout << "\n  LZ4 block codec, MB/s of uncompressed data";
+  std::cout << "\n =============================================";
+
+  const size_t size = 16 * 1024 * 1024;
+  std::ostringstream lines;
+  const char* levels[] = { "INFO", "WARN", "DEBUG", "INFO" };
+  for(size_t i=0; lines.tellp() < std::streamoff(size); ++i)
+    lines << "2026-10-19 12:" << 10 + i % 50 << ":" << 10 + i % 47 << " " << levels[i % 4]
+          << " Channel-" << i % 4 << " sent block " << i << " to 127.0.0.1:" << 8080 + i % 3 << "\n";
+  std::string logs = lines.str();
+  logs.resize(size);
+  std::string noise(size, 0);
+  unsigned int state = 12345;
+  for(size_t i=0; i<size; ++i)
+  {
+    state = state * 1103515245 + 12345;
+    noise[i] = (char)(state >> 23);
+  }
+
+  std::cout << "\n  corpus             block    ratio  compress MB/s  decompress MB/s";
+  const size_t blockSizes[] = { 1024, 16 * 1024, 64 * 1024 };
+  for(size_t i=0; i<3; ++i)
+    measure("log text", logs, blockSizes[i]);
+  for(size_t i=0; i<3; ++i)
+    measure("random", noise, blockSizes[i]);
+  std::cout << "\n\n";
+}
+
+#endif
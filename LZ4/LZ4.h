@@ -0,0 +1,58 @@
+#ifndef LZ4_H
+#define LZ4_H
+///////////////////////////////////////////////////////////////
+// LZ4.h - Fast LZ77 block codec in the LZ4 block format     //
+// ver 1.0                                                   //
+// Language: standard C++                                    //
+// Platform: Dell Dimension T7400, Windows 7, SP #1          //
+// Application: Resource for DO projects                     //
+///////////////////////////////////////////////////////////////
+/*
+ * Package Operations:
+ * ===================
+ * LZ4 compresses and decompresses single blocks.  The output is the
+ * LZ4 block format: sequences of literal runs and back references
+ * of at least four bytes, at most 64 KB back.  Matches are found
+ * through a hash table of the last position each four byte prefix
+ * was seen at, and the search skips ahead faster through data which
+ * keeps failing to match, so incompressible blocks cost little.
+ *
+ * The codec knows nothing about block sizes, so the decompressed
+ * length has to travel with the compressed block.  Decompression
+ * checks every length and offset against both buffers, so corrupted
+ * input is reported, never written outside the output.
+ */
+/*
+ * Public Interface:
+ * =================
+ * std::vector<char> packed(LZ4::bound(len));
+ * size_t n = LZ4::compress(src, len, &packed[0], packed.size());
+ * if(n == 0) ...                                 // did not fit
+ * bool ok = LZ4::decompress(&packed[0], n, dst, len);
+ *
+ * Required Files:
+ * ---------------
+ * LZ4.h, LZ4.cpp
+ *
+ * Build Process:
+ * --------------
+ * cl /EHa /DTEST_LZ4 LZ4.cpp
+ * cl /EHa /O2 /DBENCH_LZ4 LZ4.cpp          (throughput and ratio)
+ *
+ * Maintenance History:
+ * --------------------
+ * ver 1.0 : 19 Oct 2026
+ * - first release
+ */
+
+#include <cstddef>
+
+class LZ4
+{
+public:
+  static size_t bound(size_t len);
+  static size_t compress(const char* src, size_t len, char* dst, size_t capacity);
+  static bool decompress(const char* src, size_t len, char* dst, size_t outLen);
+};
+
+#endif
@@ -0,0 +1,448 @@
+///////////////////////////////////////////////////////////////
+// Metrics.cpp - Runtime counters, gauges and histograms     //
+// ver 1.0                                                   //
+// Language: standard C++                                    //
+// Platform: Dell Dimension T7400, Windows 7, SP #1          //
+// Application: Resource for DO projects                     //
+///////////////////////////////////////////////////////////////
+
+#include "Metrics.h"
+#include "../Threads/Threads.h"
+#include "../Threads/Locks.h"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdio>
+
+std::atomic<unsigned int> Counter::nextStripe;  // static storage, zero before any thread counts
+
+//----< constructor >------------------------------------------
+
+Counter::Counter()
+{
+  for(size_t i=0; i<Stripes; ++i)
+    stripes[i].n.store(0);
+}
+//----< sum of all stripes >-----------------------------------
+
+long long Counter::value() const
+{
+  long long sum = 0;
+  for(size_t i=0; i<Stripes; ++i)
+    sum += stripes[i].n.load(std::memory_order_relaxed);
+  return sum;
+}
+//----< constructor >------------------------------------------
+
+Histogram::Histogram()
+{
+  for(size_t i=0; i<Buckets; ++i)
+    counts[i].store(0);
+  total.store(0);
+  _sum.store(0);
+  _max.store(0);
+}
+//----< number, sum and largest of recorded values >-----------
+
+unsigned long long Histogram::count() const
+{
+  return total.load(std::memory_order_relaxed);
+}
+
+unsigned long long Histogram::sum() const
+{
+  return _sum.load(std::memory_order_relaxed);
+}
+
+unsigned long long Histogram::largest() const
+{
+  return _max.load(std::memory_order_relaxed);
+}
+//----< largest value that falls in a bucket >-----------------
+
+unsigned long long Histogram::upper(size_t bucket)
+{
+  if(bucket < Sub)
+    return bucket;
+  size_t shift = (bucket - Sub) / Sub;
+  unsigned long long mantissa = (bucket - Sub) % Sub + Sub;
+  return ((mantissa + 1) << shift) - 1;
+}
+//----< value below which fraction of the values fall >--------
+/*
+ * Reported as the top of its bucket, so never below the true
+ * value and never more than 1/16 above it, and never above the
+ * largest value recorded.
+ */
+unsigned long long Histogram::percentile(double fraction) const
+{
+  unsigned long long n = count();
+  if(n == 0)
+    return 0;
+  unsigned long long rank = (unsigned long long)(fraction * n + 0.999999);
+  if(rank < 1)
+    rank = 1;
+  unsigned long long seen = 0;
+  for(size_t i=0; i<Buckets; ++i)
+  {
+    seen += counts[i].load(std::memory_order_relaxed);
+    if(seen >= rank)
+    {
+      unsigned long long top = upper(i);
+      unsigned long long most = largest();
+      return top < most ? top : most;
+    }
+  }
+  return largest();
+}
+//----< how many values fell in one bucket >------------------
+
+unsigned long long Histogram::inBucket(size_t bucket) const
+{
+  return counts[bucket].load(std::memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////
+// Metric - registry entry, never freed
+
+struct Metrics::Metric
+{
+  Metric(Kind k, const std::string& n, const std::string& l)
+    : kind(k), name(n), labels(l), pCounter(0), pGauge(0), pHistogram(0), next(0)
+  {
+    if(kind == COUNTER)
+      pCounter = new Counter;
+    else if(kind == GAUGE)
+      pGauge = new Gauge;
+    else
+      pHistogram = new Histogram;
+  }
+  bool is(Kind k, const std::string& n, const std::string& l)
+  {
+    return kind == k && name == n && labels == l;
+  }
+  Kind kind;
+  std::string name;
+  std::string labels;
+  Counter* pCounter;
+  Gauge* pGauge;
+  Histogram* pHistogram;
+  Metric* next;
+};
+
+//----< list head, zero initialized before any metric is made >
+
+std::atomic<Metrics::Metric*>& Metrics::head()
+{
+  static std::atomic<Metric*> first;
+  return first;
+}
+//----< find a metric, adding it if it is new >----------------
+/*
+ * Metrics are only ever pushed on the front of the list.  When
+ * another thread pushes first, the entries it added are checked
+ * before trying again, so a metric is never registered twice.
+ */
+Metrics::Metric* Metrics::find(Kind kind, const std::string& name, const std::string& labels)
+{
+  Metric* first = head().load();
+  for(Metric* pM = first; pM != 0; pM = pM->next)
+    if(pM->is(kind, name, labels))
+      return pM;
+  Metric* pNew = new Metric(kind, name, labels);
+  pNew->next = first;
+  while(!head().compare_exchange_weak(pNew->next, pNew))
+  {
+    for(Metric* pM = pNew->next; pM != first; pM = pM->next)
+    {
+      if(pM->is(kind, name, labels))
+      {
+        delete pNew;  // lost the race, its parts are leaked once
+        return pM;
+      }
+    }
+    first = pNew->next;
+  }
+  return pNew;
+}
+//----< named metrics >----------------------------------------
+
+Counter& Metrics::counter(const std::string& name, const std::string& labels)
+{
+  return *find(COUNTER, name, labels)->pCounter;
+}
+
+Gauge& Metrics::gauge(const std::string& name, const std::string& labels)
+{
+  return *find(GAUGE, name, labels)->pGauge;
+}
+
+Histogram& Metrics::histogram(const std::string& name, const std::string& labels)
+{
+  return *find(HISTOGRAM, name, labels)->pHistogram;
+}
+//----< key="value", escaped for the text format >-------------
+
+std::string Metrics::label(const std::string& key, const std::string& value)
+{
+  std::string text = key + "=\"";
+  for(size_t i=0; i<value.size(); ++i)
+  {
+    if(value[i] == '\\' || value[i] == '"')
+      text += '\\';
+    if(value[i] == '\n')
+      text += "\\n";
+    else
+      text += value[i];
+  }
+  return text + "\"";
+}
+//----< current value of every metric >------------------------
+
+std::vector<Metrics::Sample> Metrics::snapshot()
+{
+  std::vector<Sample> samples;
+  for(Metric* pM = head().load(); pM != 0; pM = pM->next)
+  {
+    Sample s;
+    s.kind = pM->kind;
+    s.name = pM->name;
+    s.labels = pM->labels;
+    s.value = 0;
+    s.count = s.sum = s.p50 = s.p99 = s.p999 = s.largest = 0;
+    if(pM->pCounter)
+      s.value = pM->pCounter->value();
+    else if(pM->pGauge)
+      s.value = pM->pGauge->value();
+    else
+    {
+      Histogram& h = *pM->pHistogram;
+      s.count = h.count();
+      s.sum = h.sum();
+      s.p50 = h.percentile(0.5);
+      s.p99 = h.percentile(0.99);
+      s.p999 = h.percentile(0.999);
+      s.largest = h.largest();
+    }
+    samples.push_back(s);
+  }
+  std::reverse(samples.begin(), samples.end());  // oldest first
+  return samples;
+}
+
+namespace
+{
+  //----< order samples by name, keeping registration order >--
+
+  bool byName(const Metrics::Sample& a, const Metrics::Sample& b)
+  {
+    return a.name < b.name;
+  }
+  //----< {labels} with an optional extra label >--------------
+
+  std::string braces(const std::string& labels, const std::string& extra = "")
+  {
+    std::string inside = labels;
+    if(!extra.empty())
+      inside += (inside.empty() ? "" : ",") + extra;
+    return inside.empty() ? "" : "{" + inside + "}";
+  }
+}
+//----< every metric in the Prometheus text format >-----------
+/*
+ * Histograms list a cumulative bucket for each bucket holding
+ * values, bounded by the largest value that bucket can hold.
+ */
+void Metrics::prometheus(std::ostream& out)
+{
+  static const char* types[] = { "counter", "gauge", "histogram" };
+  std::vector<Sample> samples = snapshot();
+  std::stable_sort(samples.begin(), samples.end(), byName);
+  for(size_t i=0; i<samples.size(); ++i)
+  {
+    Sample& s = samples[i];
+    if(i == 0 || samples[i-1].name != s.name)
+      out << "# TYPE " << s.name << " " << types[s.kind] << "\n";
+    if(s.kind != HISTOGRAM)
+    {
+      out << s.name << braces(s.labels) << " " << s.value << "\n";
+      continue;
+    }
+    // read once, so bucket counts and the total agree even while
+    // values are being recorded
+    Histogram& h = histogram(s.name, s.labels);
+    unsigned long long cumulative = 0;
+    for(size_t b=0; b<Histogram::Buckets; ++b)
+    {
+      unsigned long long n = h.inBucket(b);
+      if(n == 0)
+        continue;
+      cumulative += n;
+      std::ostringstream le;
+      le << "le=\"" << Histogram::upper(b) << "\"";
+      out << s.name << "_bucket" << braces(s.labels, le.str()) << " " << cumulative << "\n";
+    }
+    out << s.name << "_bucket" << braces(s.labels, "le=\"+Inf\"") << " " << cumulative << "\n";
+    out << s.name << "_sum" << braces(s.labels) << " " << h.sum() << "\n";
+    out << s.name << "_count" << braces(s.labels) << " " << cumulative << "\n";
+  }
+}
+//----< replace a file with the text format >------------------
+
+bool Metrics::write(const std::string& path)
+{
+  std::string temp = path + ".tmp";
+  {
+    std::ofstream out(temp.c_str());
+    if(!out.good())
+      return false;
+    prometheus(out);
+    if(!out.good())
+      return false;
+  }
+#ifdef _WIN32
+  return ::MoveFileExA(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+  return std::rename(temp.c_str(), path.c_str()) == 0;
+#endif
+}
+
+namespace
+{
+  /////////////////////////////////////////////////////////////
+  // DumpThread - writes the metrics file at an interval
+
+  class DumpThread : public threadBase
+  {
+  public:
+    DumpThread(const std::string& path, unsigned long milliseconds)
+      : _path(path), _milliseconds(milliseconds), _stopping(false) {}
+    void stop();
+  private:
+    void run();
+    std::string _path;
+    unsigned long _milliseconds;
+    bool _stopping;
+    CSLock _lock;
+    CSConditionVariable _cv;
+  };
+
+  //----< write until stopped, and once more on the way out >--
+
+  void DumpThread::run()
+  {
+    _lock.lock();
+    while(!_stopping)
+    {
+      if(!_cv.sleep(_lock, _milliseconds))
+      {
+        _lock.unlock();
+        Metrics::write(_path);
+        _lock.lock();
+      }
+    }
+    _lock.unlock();
+    Metrics::write(_path);
+  }
+  //----< ask the thread to finish >---------------------------
+
+  void DumpThread::stop()
+  {
+    _lock.lock();
+    _stopping = true;
+    _cv.wake();
+    _lock.unlock();
+  }
+
+  DumpThread* pDumper = 0;
+  CSLock dumperLock("Metrics dumper");
+}
+//----< write the metrics file every so many milliseconds >----
+
+void Metrics::dumpEvery(const std::string& path, unsigned long milliseconds)
+{
+  stopDump();
+  dumperLock.lock();
+  pDumper = new DumpThread(path, milliseconds);
+  pDumper->name() = "metrics-dump";
+  pDumper->start();
+  dumperLock.unlock();
+}
+//----< stop the dump thread after a last write >--------------
+
+void Metrics::stopDump()
+{
+  dumperLock.lock();
+  DumpThread* pOld = pDumper;
+  pDumper = 0;
+  dumperLock.unlock();
+  if(pOld == 0)
+    return;
+  pOld->stop();
+  pOld->join();
+  delete pOld;
+}
+
+#ifdef TEST_METRICS
+
+///////////////////////////////////////////////////////////////
+// thread counting into shared metrics
+
+class CountThread : public threadBase
+{
+public:
+  CountThread(size_t n) : _n(n) {}
+private:
+  void run()
+  {
+    Counter& c = Metrics::counter("test_events_total", Metrics::label("stage", "count"));
+    Histogram& h = Metrics::histogram("test_latency_us");
+    for(size_t i=0; i<_n; ++i)
+    {
+      c.add();
+      h.record(i % 1000);
+    }
+  }
+  size_t _n;
+};
+
+//----< test stub >--------------------------------------------
+
+int main()
+{
+  std::cout << "\n  Demonstrating Metrics";
+  std::cout << "\n =======================\n";
+
+  const size_t threads = 4, n = 100000;
+  std::vector<CountThread*> counters;
+  for(size_t i=0; i<threads; ++i)
+  {
+    counters.push_back(new CountThread(n));
+    counters.back()->start();
+  }
+  for(size_t i=0; i<threads; ++i)
+  {
+    counters[i]->join();
+    delete counters[i];
+  }
+  Metrics::gauge("test_queue_depth", Metrics::label("queue", "send \"Q\"")).set(42);
+
+  long long events = Metrics::counter("test_events_total", Metrics::label("stage", "count")).value();
+  std::cout << "\n  " << threads << " threads counted " << events << " events"
+            << (events == (long long)(threads * n) ? ", none lost" : ", SOME LOST");
+  Histogram& h = Metrics::histogram("test_latency_us");
+  std::cout << "\n  latency of 0..999 uniform: p50 " << h.percentile(0.5)
+            << ", p99 " << h.percentile(0.99) << ", p999 " << h.percentile(0.999)
+            << ", max " << h.largest() << ", mean " << h.sum() / h.count();
+  std::cout << "\n  bucket bounds around 1000:";
+  for(size_t b = Histogram::bucket(900); b <= Histogram::bucket(1100); ++b)
+    std::cout << " " << Histogram::upper(b);
+
+  std::cout << "\n\n  Prometheus text format:\n\n";
+  std::ostringstream text;
+  Metrics::prometheus(text);
+  std::string all = text.str();
+  std::cout << all.substr(0, 400) << "...\n  (" << all.size() << " bytes)\n\n";
+}
+
+#endif
@@ -0,0 +1,214 @@
+#ifndef METRICS_H
+#define METRICS_H
+///////////////////////////////////////////////////////////////
+// Metrics.h - Runtime counters, gauges and histograms       //
+// ver 1.0                                                   //
+// Language: standard C++                                    //
+// Platform: Dell Dimension T7400, Windows 7, SP #1          //
+// Application: Resource for DO projects                     //
+///////////////////////////////////////////////////////////////
+/*
+ * Package Operations:
+ * ===================
+ * Metrics is a registry of named measurements a program updates as
+ * it runs, read by snapshot() or written out in the Prometheus text
+ * format:
+ *
+ * - Counter only goes up.  It is striped: each thread adds to one of
+ *   Stripes cache line sized slots, so threads counting the same
+ *   event do not share a cache line, and value() sums the slots.
+ * - Gauge is a value that is set, like a queue depth.
+ * - Histogram counts values in log-linear buckets, as HDR histograms
+ *   do: every power of two range is cut into 16 equal buckets, so a
+ *   percentile is within 1/16 of the recorded value, for values from
+ *   0 to 2^48, at a fixed cost of one increment per value.
+ *
+ * Updates are atomic adds and never lock.  The registry is a list
+ * that is only ever prepended to with compare and swap, so lookups
+ * do not lock either.  Metrics are never freed, so a reference can
+ * be kept and updated without another lookup, which hot paths
+ * should do.  A metric is named, and told apart from others of the
+ * same name by labels in Prometheus form, e.g. peer="10.0.0.1:8080".
+ *
+ * dumpEvery() starts a thread that rewrites a file with the text
+ * format at an interval, for a node exporter's textfile collector
+ * or a person to read.  The file is replaced whole, never seen half
+ * written.
+ */
+/*
+ * Public Interface:
+ * =================
+ * Counter& sent = Metrics::counter("bytes_sent_total", Metrics::label("peer", host));
+ * sent.add(n);                                  // lock free
+ * Metrics::gauge("queue_depth").set(q.size());
+ * Metrics::histogram("connect_us").record(micros);
+ * std::vector<Metrics::Sample> s = Metrics::snapshot();
+ * Metrics::prometheus(std::cout);               // text format
+ * Metrics::dumpEvery("metrics.prom", 10000);    // every 10 seconds
+ * Metrics::stopDump();
+ *
+ * Required Files:
+ * ---------------
+ * Metrics.h, Metrics.cpp, Threads.h, Threads.cpp, Locks.h, Locks.cpp
+ *
+ * Build Process:
+ * --------------
+ * cl /EHa /DTEST_METRICS Metrics.cpp ../Threads/Threads.cpp ../Threads/Locks.cpp
+ *
+ * Maintenance History:
+ * --------------------
+ * ver 1.0 : 19 Oct 2026
+ * - first release
+ */
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstddef>
+
+#ifdef _WIN32
+#define METRICS_THREAD_LOCAL __declspec(thread)
+#else
+#define METRICS_THREAD_LOCAL __thread
+#endif
+
+///////////////////////////////////////////////////////////////
+// Counter - monotonic count, striped over cache lines
+
+class Counter
+{
+public:
+  enum { Stripes = 16 };
+  Counter();
+  void add(long long n = 1);
+  long long value() const;
+private:
+  Counter(const Counter&);
+  Counter& operator=(const Counter&);
+  struct Stripe
+  {
+    std::atomic<long long> n;
+    char pad[64 - sizeof(std::atomic<long long>)];
+  };
+  static size_t stripe();
+  static std::atomic<unsigned int> nextStripe;
+  Stripe stripes[Stripes];
+};
+
+//----< count n events >---------------------------------------
+
+inline void Counter::add(long long n)
+{
+  stripes[stripe()].n.fetch_add(n, std::memory_order_relaxed);
+}
+//----< this thread's stripe, handed out round robin >---------
+
+inline size_t Counter::stripe()
+{
+  static METRICS_THREAD_LOCAL unsigned int mine = 0;  // 0 until first use
+  if(mine == 0)
+    mine = nextStripe.fetch_add(1, std::memory_order_relaxed) % Stripes + 1;
+  return mine - 1;
+}
+
+///////////////////////////////////////////////////////////////
+// Gauge - value that goes up and down
+
+class Gauge
+{
+public:
+  Gauge() { v.store(0); }
+  void set(long long value) { v.store(value, std::memory_order_relaxed); }
+  void add(long long n) { v.fetch_add(n, std::memory_order_relaxed); }
+  long long value() const { return v.load(std::memory_order_relaxed); }
+private:
+  Gauge(const Gauge&);
+  Gauge& operator=(const Gauge&);
+  std::atomic<long long> v;
+};
+
+///////////////////////////////////////////////////////////////
+// Histogram - log-linear bucket counts of recorded values
+
+class Histogram
+{
+public:
+  enum { SubBits = 4, Sub = 1 << SubBits, MaxBits = 48, Buckets = Sub + (MaxBits - SubBits) * Sub };
+  Histogram();
+  void record(unsigned long long value);
+  unsigned long long count() const;
+  unsigned long long sum() const;
+  unsigned long long largest() const;
+  unsigned long long percentile(double fraction) const;
+  unsigned long long inBucket(size_t bucket) const;
+  static size_t bucket(unsigned long long value);
+  static unsigned long long upper(size_t bucket);
+private:
+  Histogram(const Histogram&);
+  Histogram& operator=(const Histogram&);
+  std::atomic<unsigned long long> counts[Buckets];
+  std::atomic<unsigned long long> total;
+  std::atomic<unsigned long long> _sum;
+  std::atomic<unsigned long long> _max;
+};
+
+//----< bucket of a value: exact below Sub, 16 per octave above >
+
+inline size_t Histogram::bucket(unsigned long long value)
+{
+  if(value < Sub)
+    return (size_t)value;
+  if(value >> MaxBits)
+    return Buckets - 1;
+  size_t top = 0;  // index of the highest set bit
+  for(unsigned long long v = value; v > 1; v >>= 1)
+    ++top;
+  size_t shift = top - SubBits;
+  return Sub + shift * Sub + (size_t)((value >> shift) - Sub);
+}
+//----< count one value >--------------------------------------
+
+inline void Histogram::record(unsigned long long value)
+{
+  counts[bucket(value)].fetch_add(1, std::memory_order_relaxed);
+  total.fetch_add(1, std::memory_order_relaxed);
+  _sum.fetch_add(value, std::memory_order_relaxed);
+  unsigned long long old = _max.load(std::memory_order_relaxed);
+  while(value > old && !_max.compare_exchange_weak(old, value, std::memory_order_relaxed))
+    ;
+}
+
+///////////////////////////////////////////////////////////////
+// Metrics - registry of all counters, gauges and histograms
+
+class Metrics
+{
+public:
+  enum Kind { COUNTER, GAUGE, HISTOGRAM };
+  struct Sample
+  {
+    Kind kind;
+    std::string name;
+    std::string labels;
+    long long value;                 // counter or gauge
+    unsigned long long count;        // histogram only, from here on
+    unsigned long long sum;
+    unsigned long long p50, p99, p999, largest;
+  };
+  static Counter& counter(const std::string& name, const std::string& labels = "");
+  static Gauge& gauge(const std::string& name, const std::string& labels = "");
+  static Histogram& histogram(const std::string& name, const std::string& labels = "");
+  static std::string label(const std::string& key, const std::string& value);
+  static std::vector<Sample> snapshot();
+  static void prometheus(std::ostream& out);
+  static bool write(const std::string& path);
+  static void dumpEvery(const std::string& path, unsigned long milliseconds);
+  static void stopDump();
+private:
+  struct Metric;
+  static Metric* find(Kind kind, const std::string& name, const std::string& labels);
+  static std::atomic<Metric*>& head();
+};
+
+#endif
@@ -0,0 +1,135 @@
+///////////////////////////////////////////////////////////////
+// MicroBench.cpp - Cost per call of hot operations          //
+// ver 1.0                                                   //
+// Language: standard C++                                    //
+// Platform: Dell Dimension T7400, Windows 7, SP #1          //
+// Application: Resource for DO projects                     //
+///////////////////////////////////////////////////////////////
+
+#include "MicroBench.h"
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+
+namespace
+{
+  // relaxed: only totals read between measurements are needed
+  std::atomic<unsigned long long> allocCount(0);
+  std::atomic<unsigned long long> allocBytes(0);
+  volatile size_t sink = 0;
+
+  void* counted(size_t size)
+  {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    allocBytes.fetch_add(size, std::memory_order_relaxed);
+    return std::malloc(size > 0 ? size : 1);
+  }
+}
+
+//----< counting replacements of the global allocator >--------
+
+void* operator new(size_t size)
+{
+  void* p = counted(size);
+  if(p == 0)
+    throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](size_t size)
+{
+  void* p = counted(size);
+  if(p == 0)
+    throw std::bad_alloc();
+  return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) throw()
+{
+  return counted(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) throw()
+{
+  return counted(size);
+}
+
+void operator delete(void* p) throw() { std::free(p); }
+void operator delete[](void* p) throw() { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) throw() { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) throw() { std::free(p); }
+
+//----< heap allocations since the program started >-----------
+
+unsigned long long MicroBench::allocations()
+{
+  return allocCount.load(std::memory_order_relaxed);
+}
+
+unsigned long long MicroBench::allocatedBytes()
+{
+  return allocBytes.load(std::memory_order_relaxed);
+}
+//----< make a result observable so its op is not removed >----
+
+void MicroBench::keep(size_t value)
+{
+  sink = sink + value;
+}
+//----< heading of a table of results >------------------------
+
+void MicroBench::title(const std::string& name)
+{
+  std::cout << "\n  " << name;
+  std::cout << "\n " << std::string(name.size() + 2, '=');
+  std::cout << "\n  " << std::left << std::setw(36) << "operation" << std::right
+            << std::setw(12) << "ns/op" << std::setw(12) << "allocs/op" << std::setw(12) << "bytes/op";
+}
+//----< one row of results >-----------------------------------
+
+void MicroBench::report(const std::string& name, const Result& r)
+{
+  std::cout << "\n  " << std::left << std::setw(36) << name << std::right << std::fixed
+            << std::setprecision(1) << std::setw(12) << r.nsPerOp
+            << std::setprecision(2) << std::setw(12) << r.allocsPerOp
+            << std::setprecision(1) << std::setw(12) << r.bytesPerOp;
+}
+
+#ifdef TEST_MICROBENCH
+
+#include <string>
+#include <vector>
+
+//----< test stub >--------------------------------------------
+
+int main()
+{
+  std::cout << "\n  Demonstrating MicroBench";
+  std::cout << "\n ==========================\n";
+
+  MicroBench::title("Library operations");
+  std::string text(100, 'x');
+  MicroBench::report("copy 100 char string", MicroBench::measure(100000, [&]() {
+    std::string copy(text);
+    MicroBench::keep(copy.size());
+  }));
+  MicroBench::report("vector<int> of 1000, reserved", MicroBench::measure(10000, [&]() {
+    std::vector<int> v;
+    v.reserve(1000);
+    for(int i=0; i<1000; ++i)
+      v.push_back(i);
+    MicroBench::keep(v.size());
+  }));
+  std::vector<int> reused;
+  MicroBench::report("vector<int> of 1000, reused", MicroBench::measure(10000, [&]() {
+    reused.clear();
+    for(int i=0; i<1000; ++i)
+      reused.push_back(i);
+    MicroBench::keep(reused.size());
+  }));
+  std::cout << "\n\n  the reused vector allocates only in the warm up pass\n\n";
+}
+
+#endif
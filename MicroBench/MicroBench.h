@@ -0,0 +1,94 @@
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
+///////////////////////////////////////////////////////////////
+// MicroBench.h - Cost per call of hot operations            //
+// ver 1.0                                                   //
+// Language: standard C++                                    //
+// Platform: Dell Dimension T7400, Windows 7, SP #1          //
+// Application: Resource for DO projects                     //
+///////////////////////////////////////////////////////////////
+/*
+ * Package Operations:
+ * ===================
+ * MicroBench runs a small operation many times and reports its cost
+ * per call: nanoseconds, heap allocations and bytes allocated.
+ *
+ * MicroBench.cpp replaces the global operator new and delete with
+ * versions that count calls and bytes, so it must be linked into
+ * the benchmark program and no other.  measure() runs a warm up pass
+ * first, so buffers that grow once are not charged to every call.
+ *
+ * Benchmarks are BENCH_<PACKAGE> stubs in the packages they measure,
+ * each built with this package, e.g. BENCH_MESSAGE in Message.cpp.
+ */
+/*
+ * Public Interface:
+ * =================
+ * MicroBench::title("Message");
+ * MicroBench::Result r = MicroBench::measure(100000, [&]() { op(); });
+ * MicroBench::report("op", r);                // ns/op, allocs/op, bytes/op
+ * MicroBench::keep(value);                    // stop op being optimized away
+ * unsigned long long n = MicroBench::allocations();
+ * unsigned long long b = MicroBench::allocatedBytes();
+ *
+ * Required Files:
+ * ---------------
+ * MicroBench.h, MicroBench.cpp, HiResTimer.h
+ *
+ * Build Process:
+ * --------------
+ * cl /EHa /O2 /DTEST_MICROBENCH MicroBench.cpp
+ *
+ * Maintenance History:
+ * --------------------
+ * ver 1.0 : 19 Oct 2026
+ * - first release
+ */
+
+#include "../HiResTimer/HiResTimer.h"
+#include <string>
+#include <cstddef>
+
+class MicroBench
+{
+public:
+  struct Result
+  {
+    double nsPerOp;
+    double allocsPerOp;
+    double bytesPerOp;
+  };
+  template <typename Op>
+  static Result measure(size_t iterations, Op op);
+  static void title(const std::string& name);
+  static void report(const std::string& name, const Result& r);
+  static void keep(size_t value);
+  static unsigned long long allocations();
+  static unsigned long long allocatedBytes();
+};
+
+//----< cost of one call of op, averaged over iterations >-----
+
+template <typename Op>
+MicroBench::Result MicroBench::measure(size_t iterations, Op op)
+{
+  size_t warmUp = iterations / 10 + 1;
+  for(size_t i=0; i<warmUp; ++i)
+    op();
+
+  unsigned long long allocs = allocations();
+  unsigned long long bytes = allocatedBytes();
+  HRTimer::HiResTimer timer;
+  timer.Start();
+  for(size_t i=0; i<iterations; ++i)
+    op();
+  timer.Stop();
+
+  Result r;
+  r.nsPerOp = double(timer.ElapsedNanoseconds()) / iterations;
+  r.allocsPerOp = double(allocations() - allocs) / iterations;
+  r.bytesPerOp = double(allocatedBytes() - bytes) / iterations;
+  return r;
+}
+
+#endif
@@ -0,0 +1,182 @@
+///////////////////////////////////////////////////////////////
+// RateLimit.cpp - Token buckets pacing bytes sent           //
+// ver 1.1                                                   //
+// Language: standard C++                                    //
+// Platform: Dell Dimension T7400, Windows 7, SP #1          //
+// Application: Resource for DO projects                     //
+///////////////////////////////////////////////////////////////
+
+#include "RateLimit.h"
+#include "../HiResTimer/HiResTimer.h"
+#include <thread>
+#include <chrono>
+#include <unordered_map>
+
+namespace
+{
+  const double MinBurst = 64 * 1024;  // bytes, default burst is at least this
+  const long long MaxSleep = 100;     // millisecs, then look at the rate again
+
+  TokenBucket globalBucket;           // static storage, unlimited until limit()
+
+  // peer host buckets, never freed, so a sender may keep a pointer
+  std::unordered_map<std::string, TokenBucket*> peerBuckets;
+  CSLock peerLock("TokenBucket peers");
+}
+//----< constructor, no limit >--------------------------------
+
+TokenBucket::TokenBucket()
+  : _lock("TokenBucket"), _rate(0), _burst(0), _tokens(0), _last(HRTimer::HiResTimer::Now()) {}
+
+//----< the bucket every sender in the process shares >--------
+
+TokenBucket& TokenBucket::global()
+{
+  return globalBucket;
+}
+//----< the bucket every sender to host shares, made if new >--
+
+TokenBucket& TokenBucket::peer(const std::string& host)
+{
+  peerLock.lock();
+  TokenBucket*& bucket = peerBuckets[host];
+  if(bucket == 0)
+    bucket = new TokenBucket;
+  TokenBucket& found = *bucket;
+  peerLock.unlock();
+  return found;
+}
+//----< host's bucket, 0 if no limit was ever set for it >-----
+
+TokenBucket* TokenBucket::findPeer(const std::string& host)
+{
+  peerLock.lock();
+  auto it = peerBuckets.find(host);
+  TokenBucket* found = it == peerBuckets.end() ? 0 : it->second;
+  peerLock.unlock();
+  return found;
+}
+//----< set the rate, 0 removes the limit >--------------------
+/*
+ * a burst of 0 holds a tenth of a second, and at least MinBurst
+ */
+void TokenBucket::limit(double bytesPerSecond, double burstBytes)
+{
+  _lock.lock();
+  refill();
+  if(burstBytes <= 0)
+    burstBytes = bytesPerSecond / 10 > MinBurst ? bytesPerSecond / 10 : MinBurst;
+  bool wasUnlimited = _rate <= 0;
+  _rate = bytesPerSecond > 0 ? bytesPerSecond : 0;
+  _burst = burstBytes;
+  if(wasUnlimited || _tokens > _burst)
+    _tokens = _burst;
+  _lock.unlock();
+}
+
+double TokenBucket::rate()
+{
+  _lock.lock();
+  double r = _rate;
+  _lock.unlock();
+  return r;
+}
+//----< add the tokens accrued since the last refill >---------
+/*
+ * _lock held
+ */
+void TokenBucket::refill()
+{
+  long long now = HRTimer::HiResTimer::Now();
+  if(_rate > 0)
+  {
+    _tokens += HRTimer::HiResTimer::ToNanoseconds(now - _last) / 1e9 * _rate;
+    if(_tokens > _burst)
+      _tokens = _burst;
+  }
+  _last = now;
+}
+//----< spend tokens on bytes, waiting first if BULK >---------
+/*
+ * returns microseconds spent waiting
+ */
+long long TokenBucket::take(size_t bytes, Priority priority)
+{
+  long long start = 0;
+  while(true)
+  {
+    _lock.lock();
+    if(_rate <= 0)
+    {
+      _lock.unlock();
+      break;
+    }
+    refill();
+    if(priority == INTERACTIVE)
+    {
+      _tokens -= bytes;
+      if(_tokens < -_burst)
+        _tokens = -_burst;
+      _lock.unlock();
+      break;
+    }
+    if(_tokens >= 0)
+    {
+      _tokens -= bytes;                // may go into debt, later sends wait it out
+      _lock.unlock();
+      break;
+    }
+    long long wait = (long long)(-_tokens / _rate * 1000) + 1;
+    _lock.unlock();
+    if(start == 0)
+      start = HRTimer::HiResTimer::Now();
+    std::this_thread::sleep_for(std::chrono::milliseconds(wait < MaxSleep ? wait : MaxSleep));
+  }
+  if(start == 0)
+    return 0;
+  return HRTimer::HiResTimer::ToNanoseconds(HRTimer::HiResTimer::Now() - start) / 1000;
+}
+
+#ifdef TEST_RATELIMIT
+
+#include <iostream>
+
+//----< test stub >--------------------------------------------
+
+int main()
+{
+  std::cout << "\n  Demonstrating RateLimit";
+  std::cout << "\n =========================\n";
+
+  const size_t Block = 64 * 1024;
+  TokenBucket b;
+  b.limit(4 << 20);                    // 4 MB/s, burst of 409 KB
+  HRTimer::HiResTimer timer;
+  timer.Start();
+  for(size_t i=0; i<64; ++i)           // 4 MB of bulk blocks
+    b.take(Block, TokenBucket::BULK);
+  timer.Stop();
+  std::cout << "\n  4 MB of bulk blocks at 4 MB/s took " << timer.ElapsedMicroseconds() / 1000
+            << " ms, expected about 900";
+
+  timer.Start();
+  for(size_t i=0; i<64; ++i)
+    b.take(Block, TokenBucket::INTERACTIVE);
+  timer.Stop();
+  std::cout << "\n  4 MB of interactive blocks took " << timer.ElapsedMicroseconds() / 1000
+            << " ms, expected 0";
+
+  TokenBucket::peer("10.0.0.1").limit(1 << 20);
+  std::cout << "\n  peer bucket shared: " << (TokenBucket::findPeer("10.0.0.1") == &TokenBucket::peer("10.0.0.1") ? "yes" : "NO")
+            << ", unknown host: " << (TokenBucket::findPeer("10.0.0.2") == 0 ? "none" : "FOUND");
+
+  b.limit(0);                          // limit removed at runtime
+  timer.Start();
+  for(size_t i=0; i<64; ++i)
+    b.take(Block, TokenBucket::BULK);
+  timer.Stop();
+  std::cout << "\n  unlimited, 4 MB took " << timer.ElapsedMicroseconds() / 1000 << " ms, expected 0\n\n";
+  return 0;
+}
+
+#endif
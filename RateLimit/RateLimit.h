@@ -0,0 +1,89 @@
+#ifndef RATELIMIT_H
+#define RATELIMIT_H
+///////////////////////////////////////////////////////////////
+// RateLimit.h - Token buckets pacing bytes sent             //
+// ver 1.1                                                   //
+// Language: standard C++                                    //
+// Platform: Dell Dimension T7400, Windows 7, SP #1          //
+// Application: Resource for DO projects                     //
+///////////////////////////////////////////////////////////////
+/*
+ * Package Operations:
+ * ===================
+ * TokenBucket paces a stream of sends to a rate in bytes per second.
+ * Tokens accrue at the rate, up to a burst, and take() spends them,
+ * sleeping first while the bucket is empty.  A send larger than what
+ * is left is let through and leaves the bucket in debt, which later
+ * sends wait out, so a block is never split to fit the bucket.  A
+ * rate of zero means no limit and costs one lock per take().
+ *
+ * Each take() has a priority.  BULK waits for tokens.  INTERACTIVE
+ * never waits, but what it sends is still charged, so bulk senders
+ * sharing the bucket fall back while interactive traffic flows; its
+ * debt is capped at one burst, so a bulk sender is never held back
+ * by more than a burst's worth of it.
+ *
+ * limit() may be called at any time, from any thread.  A sender
+ * sleeping in take() wakes at least every 100 ms to see a new rate.
+ * global() is one bucket for the whole process, and peer() one per
+ * peer host for the whole process, made on first use and kept until
+ * it ends.  findPeer() looks a host's bucket up without making one.
+ */
+/*
+ * Public Interface:
+ * =================
+ * TokenBucket b;
+ * b.limit(10 << 20);                           // 10 MB/s, burst of 1 MB
+ * b.limit(10 << 20, 64 << 10);                 // burst of 64 KB
+ * long long us = b.take(block.size(), TokenBucket::BULK);  // waits, returns micros waited
+ * b.take(ack.size(), TokenBucket::INTERACTIVE);            // never waits
+ * double r = b.rate();                         // 0 when unlimited
+ * TokenBucket::global().limit(100 << 20);      // cap for every sender
+ * TokenBucket::peer("host").limit(10 << 20);    // cap for every sender to host
+ * TokenBucket* p = TokenBucket::findPeer("host");  // null if never limited
+ *
+ * Required Files:
+ * ---------------
+ * RateLimit.h, RateLimit.cpp, Locks.h, Locks.cpp, HiResTimer.h
+ *
+ * Build Process:
+ * --------------
+ * cl /EHa /DTEST_RATELIMIT RateLimit.cpp ../Threads/Locks.cpp
+ *
+ * Maintenance History:
+ * --------------------
+ * ver 1.1 : 19 Oct 2026
+ * - added peer buckets, one per host for the whole process
+ * ver 1.0 : 19 Oct 2026
+ * - first release
+ */
+
+#include "../Threads/Locks.h"
+#include <string>
+
+///////////////////////////////////////////////////////////////
+// TokenBucket - bytes per second, with a burst
+
+class TokenBucket
+{
+public:
+  enum Priority { INTERACTIVE, BULK };
+  TokenBucket();
+  void limit(double bytesPerSecond, double burstBytes = 0);
+  double rate();
+  long long take(size_t bytes, Priority priority);
+  static TokenBucket& global();
+  static TokenBucket& peer(const std::string& host);
+  static TokenBucket* findPeer(const std::string& host);
+private:
+  TokenBucket(const TokenBucket&);
+  TokenBucket& operator=(const TokenBucket&);
+  void refill();
+  CSLock _lock;
+  double _rate;          // bytes per second, 0 for no limit
+  double _burst;         // most tokens held
+  double _tokens;        // below zero while in debt
+  long long _last;       // timer ticks of the last refill
+};
+
+#endif
@@ -0,0 +1,175 @@
+///////////////////////////////////////////////////////////////
+// SHA256.cpp - SHA-256 content hash                         //
+// ver 1.0                                                   //
+// Language: standard C++                                    //
+// Platform: Dell Dimension T7400, Windows 7, SP #1          //
+// Application: Resource for DO projects                     //
+///////////////////////////////////////////////////////////////
+
+#include "SHA256.h"
+#include <cstring>
+
+namespace
+{
+  const unsigned int K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+  };
+
+  inline unsigned int rotr(unsigned int x, int n)
+  {
+    return (x >> n) | (x << (32 - n));
+  }
+}
+
+//----< constructor, starts an empty stream >--------------------
+
+SHA256::SHA256() : buffered(0), total(0)
+{
+  const unsigned int initial[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+  };
+  ::memcpy(state, initial, sizeof(state));
+}
+//----< process one 64 byte block >------------------------------
+
+void SHA256::compress(const unsigned char* block)
+{
+  unsigned int w[64];
+  for(int i=0; i<16; ++i)
+    w[i] = (block[4*i] << 24) | (block[4*i+1] << 16) | (block[4*i+2] << 8) | block[4*i+3];
+  for(int i=16; i<64; ++i)
+  {
+    unsigned int s0 = rotr(w[i-15], 7) ^ rotr(w[i-15], 18) ^ (w[i-15] >> 3);
+    unsigned int s1 = rotr(w[i-2], 17) ^ rotr(w[i-2], 19) ^ (w[i-2] >> 10);
+    w[i] = w[i-16] + s0 + w[i-7] + s1;
+  }
+  unsigned int a = state[0], b = state[1], c = state[2], d = state[3];
+  unsigned int e = state[4], f = state[5], g = state[6], h = state[7];
+  for(int i=0; i<64; ++i)
+  {
+    unsigned int t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+    unsigned int t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+    h = g; g = f; f = e; e = d + t1;
+    d = c; c = b; b = a; a = t1 + t2;
+  }
+  state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+  state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+//----< add bytes to the stream >--------------------------------
+
+void SHA256::update(const void* data, size_t len)
+{
+  const unsigned char* next = static_cast<const unsigned char*>(data);
+  total += len;
+  if(buffered > 0)
+  {
+    size_t take = len < 64 - buffered ? len : 64 - buffered;
+    ::memcpy(buffer + buffered, next, take);
+    buffered += take;
+    next += take;
+    len -= take;
+    if(buffered < 64)
+      return;
+    compress(buffer);
+    buffered = 0;
+  }
+  for(; len >= 64; len -= 64, next += 64)
+    compress(next);
+  ::memcpy(buffer, next, len);
+  buffered = len;
+}
+//----< pad, end the stream and return the digest in hex >-------
+
+std::string SHA256::hex()
+{
+  unsigned long long bits = total * 8;
+  unsigned char pad[72] = { 0x80 };
+  size_t padLen = (buffered < 56 ? 56 : 120) - buffered;
+  for(int i=0; i<8; ++i)
+    pad[padLen + i] = (unsigned char)(bits >> (56 - 8 * i));
+  update(pad, padLen + 8);
+  static const char digits[] = "0123456789abcdef";
+  std::string digest;
+  for(int i=0; i<8; ++i)
+    for(int shift=28; shift>=0; shift-=4)
+      digest += digits[(state[i] >> shift) & 0xf];
+  return digest;
+}
+//----< digest of one piece of data >----------------------------
+
+std::string SHA256::of(const void* data, size_t len)
+{
+  SHA256 h;
+  h.update(data, len);
+  return h.hex();
+}
+
+#ifdef TEST_SHA256
+
+#include <iostream>
+
+//----< test stub >----------------------------------------------
+
+int main()
+{
+  std::cout << "\n  Demonstrating SHA256";
+  std::cout << "\n ======================\n";
+
+  struct { const char* text; const char* digest; } vectors[] = {
+    { "", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+    { "abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+    { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+      "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+  };
+  for(size_t i=0; i<3; ++i)
+  {
+    std::string digest = SHA256::of(vectors[i].text, ::strlen(vectors[i].text));
+    std::cout << "\n  \"" << vectors[i].text << "\"\n    " << digest
+              << (digest == vectors[i].digest ? "  ok" : "  WRONG");
+  }
+
+  // feeding a million 'a's in odd sized pieces
+  SHA256 h;
+  std::string piece(997, 'a');
+  size_t left = 1000000;
+  while(left > 0)
+  {
+    size_t n = left < piece.size() ? left : piece.size();
+    h.update(piece.data(), n);
+    left -= n;
+  }
+  std::string digest = h.hex();
+  std::cout << "\n  one million 'a'\n    " << digest
+            << (digest == "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" ? "  ok" : "  WRONG");
+  std::cout << "\n\n";
+}
+
+#endif
+
+#ifdef BENCH_SHA256
+
+#include "../HiResTimer/HiResTimer.h"
+#include <iostream>
+#include <vector>
+
+//----< benchmark >----------------------------------------------
+
+int main()
+{
+  std::vector<char> data(64 * 1024 * 1024, 'x');
+  HRTimer::HiResTimer timer;
+  timer.Start();
+  std::string digest = SHA256::of(&data[0], data.size());
+  timer.Stop();
+  std::cout << "\n  SHA256 of 64 MB: " << digest;
+  std::cout << "\n  " << double(data.size()) / timer.ElapsedMicroseconds() << " MB/s\n\n";
+}
+
+#endif
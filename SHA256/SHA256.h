@@ -0,0 +1,60 @@
+#ifndef SHA256_H
+#define SHA256_H
+///////////////////////////////////////////////////////////////
+// SHA256.h - SHA-256 content hash                           //
+// ver 1.0                                                   //
+// Language: standard C++                                    //
+// Platform: Dell Dimension T7400, Windows 7, SP #1          //
+// Application: Resource for DO projects                     //
+///////////////////////////////////////////////////////////////
+/*
+ * Package Operations:
+ * ===================
+ * SHA256 computes the FIPS 180-4 SHA-256 digest of a byte stream.
+ * Data is fed in pieces of any size with update(), which lets a
+ * message be hashed block by block without joining its blocks.
+ * hex() ends the stream and returns the digest as 64 lowercase hex
+ * digits, the form used to name objects in a content store.
+ */
+/*
+ * Public Interface:
+ * =================
+ * SHA256 h;
+ * h.update(data, len);                       // any number of times
+ * std::string digest = h.hex();              // ends the stream
+ * std::string d = SHA256::of(data, len);     // one piece
+ *
+ * Required Files:
+ * ---------------
+ * SHA256.h, SHA256.cpp
+ *
+ * Build Process:
+ * --------------
+ * cl /EHa /DTEST_SHA256 SHA256.cpp
+ * cl /EHa /O2 /DBENCH_SHA256 SHA256.cpp
+ *
+ * Maintenance History:
+ * --------------------
+ * ver 1.0 : 19 Oct 2026
+ * - first release
+ */
+
+#include <string>
+#include <cstddef>
+
+class SHA256
+{
+public:
+  SHA256();
+  void update(const void* data, size_t len);
+  std::string hex();
+  static std::string of(const void* data, size_t len);
+private:
+  void compress(const unsigned char* block);
+  unsigned int state[8];
+  unsigned char buffer[64];
+  size_t buffered;
+  unsigned long long total;
+};
+
+#endif
@@ -72,6 +72,7 @@ void main() {
 			std::ostringstream os;
 			os << "CH" << i;
 			ch[i] = new Channel(os.str(), *p[i]);
+			ch[i]->enableDedup() = true;	// files the receiver already stores are linked, not sent
 			r[i] = new ReceiverHelperThread(*ch[i]);
 			s[i] = new SenderHelperThread(*ch[i], m[i]);
 			s[i]->start();
@@ -0,0 +1,563 @@
+///////////////////////////////////////////////////////////////
+// SharedMemory.cpp - Frames and sections shared by processes//
+// ver 1.2                                                   //
+// Language: standard C++                                    //
+// Platform: Dell Dimension T7400, Windows 7, SP #1          //
+// Application: Resource for DO projects                     //
+///////////////////////////////////////////////////////////////
+
+#include "SharedMemory.h"
+#include <cstring>
+
+namespace
+{
+  const LONG Magic = 0x52494e47;       // "RING"
+  const ULONG Skip = 0xffffffff;       // length of the filler before a wrapped frame
+  const size_t MinCapacity = 64 * 1024;
+  const size_t MaxCapacity = 1 << 30;
+  const int SpinCount = 200;           // looks at a held write lock before sleeping
+  const DWORD OwnerCheck = 100;        // millisecs between checks that a holder is alive
+
+  //----< bytes a frame of len bytes takes, with its length >---
+
+  ULONG footprint(size_t len)
+  {
+    return (ULONG)((sizeof(ULONG) + len + 7) & ~(size_t)7);
+  }
+  //----< is the process still running >-----------------------
+
+  bool alive(DWORD processId)
+  {
+    HANDLE h = ::OpenProcess(SYNCHRONIZE, FALSE, processId);
+    if(h == NULL)
+      return false;
+    bool running = ::WaitForSingleObject(h, 0) == WAIT_TIMEOUT;
+    ::CloseHandle(h);
+    return running;
+  }
+  //----< is the thread still running >------------------------
+
+  bool threadAlive(DWORD threadId)
+  {
+    HANDLE h = ::OpenThread(SYNCHRONIZE, FALSE, threadId);
+    if(h == NULL)
+      return false;
+    bool running = ::WaitForSingleObject(h, 0) == WAIT_TIMEOUT;
+    ::CloseHandle(h);
+    return running;
+  }
+  //----< millisecs left of a wait, INFINITE stays INFINITE >---
+
+  DWORD remaining(DWORD milliseconds, DWORD start)
+  {
+    if(milliseconds == INFINITE)
+      return INFINITE;
+    DWORD waited = ::GetTickCount() - start;
+    return waited < milliseconds ? milliseconds - waited : 0;
+  }
+}
+
+///////////////////////////////////////////////////////////////
+// shared state at the start of the mapping, each side's
+// position on its own cache line
+
+struct SharedRing::Control
+{
+  LONG magic;
+  LONG capacity;
+  volatile LONG closed;
+  volatile LONG ownerId;
+  char pad0[64 - 4 * sizeof(LONG)];
+  volatile LONG head;            // bytes consumed, moved by the reader
+  volatile LONG readerWaiting;   // reader sleeps on the data event
+  char pad1[64 - 2 * sizeof(LONG)];
+  volatile LONG tail;            // bytes produced, moved by writers
+  volatile LONG writerWaiting;   // a writer sleeps on the space event
+  volatile LONG writer;          // thread id holding the write lock, 0 if free
+  volatile LONG writersQueued;   // writers sleeping on the lock event
+  char pad2[64 - 4 * sizeof(LONG)];
+};
+
+//----< constructor >------------------------------------------
+
+SharedRing::SharedRing()
+  : _mapping(NULL), _dataEvent(NULL), _spaceEvent(NULL), _lockEvent(NULL),
+    _control(0), _ring(0), _owner(false), _pending(0), _written(0) {}
+
+SharedRing::~SharedRing()
+{
+  if(_owner)
+    close();
+  detach();
+}
+//----< map the ring and open its events >---------------------
+
+bool SharedRing::attach(const std::string& name, bool owner, size_t capacity)
+{
+  std::string base = "Local\\" + name;
+  DWORD bytes = (DWORD)(sizeof(Control) + capacity);
+  if(owner)
+    _mapping = ::CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, bytes, (base + ".ring").c_str());
+  else
+    _mapping = ::OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, (base + ".ring").c_str());
+  if(_mapping == NULL)
+    return false;
+  _control = (Control*)::MapViewOfFile(_mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+  _dataEvent = ::CreateEventA(NULL, FALSE, FALSE, (base + ".data").c_str());
+  _spaceEvent = ::CreateEventA(NULL, FALSE, FALSE, (base + ".space").c_str());
+  _lockEvent = ::CreateEventA(NULL, FALSE, FALSE, (base + ".lock").c_str());
+  if(_control == 0 || _dataEvent == NULL || _spaceEvent == NULL || _lockEvent == NULL)
+  {
+    detach();
+    return false;
+  }
+  _ring = (char*)_control + sizeof(Control);
+  return true;
+}
+//----< unmap and close handles >------------------------------
+
+void SharedRing::detach()
+{
+  if(_control)
+    ::UnmapViewOfFile(_control);
+  HANDLE handles[] = { _mapping, _dataEvent, _spaceEvent, _lockEvent };
+  for(size_t i=0; i<4; ++i)
+    if(handles[i] != NULL)
+      ::CloseHandle(handles[i]);
+  _mapping = _dataEvent = _spaceEvent = _lockEvent = NULL;
+  _control = 0;
+  _ring = 0;
+  _owner = false;
+  _pending = 0;
+}
+//----< create as the reader, capacity rounded to a power of 2 >
+
+bool SharedRing::create(const std::string& name, size_t capacity)
+{
+  detach();
+  size_t cap = MinCapacity;
+  while(cap < capacity && cap < MaxCapacity)
+    cap <<= 1;
+  if(!attach(name, true, cap))
+    return false;
+  // a ring left by a reader that died, or closed, is taken over
+  if(!lock(INFINITE))
+  {
+    detach();
+    return false;
+  }
+  bool taken = _control->magic == Magic && !_control->closed
+    && (DWORD)_control->ownerId != ::GetCurrentProcessId() && alive((DWORD)_control->ownerId);
+  if(!taken)
+  {
+    if(_control->magic != Magic)
+    {
+      _control->capacity = (LONG)cap;
+      _control->tail = 0;
+      _control->magic = Magic;
+    }
+    _control->head = _control->tail;  // drop what the last reader left
+    _control->readerWaiting = 0;
+    _control->writerWaiting = 0;
+    _control->ownerId = (LONG)::GetCurrentProcessId();
+    _control->closed = 0;
+  }
+  unlock();
+  if(taken)
+  {
+    detach();
+    return false;
+  }
+  _owner = true;
+  return true;
+}
+//----< open as a writer >-------------------------------------
+
+bool SharedRing::open(const std::string& name)
+{
+  detach();
+  if(!attach(name, false, 0))
+    return false;
+  if(_control->magic != Magic || !isOpen())
+  {
+    detach();
+    return false;
+  }
+  return true;
+}
+//----< reader: make writers fail, wake all sides >------------
+/*
+ * Frames already written can still be peeked.
+ */
+void SharedRing::close()
+{
+  if(_control == 0)
+    return;
+  if(_owner)
+  {
+    ::InterlockedExchange(&_control->closed, 1);
+    ::SetEvent(_dataEvent);
+    ::SetEvent(_spaceEvent);
+  }
+}
+
+//----< not closed, and its reader still running >-------------
+/*
+ * A writer asks the system whether the reader is alive, so this is
+ * called once per batch of writes, not per frame.  A ring whose
+ * reader died without closing it is closed here.
+ */
+bool SharedRing::isOpen()
+{
+  if(_control == 0 || _control->closed)
+    return false;
+  if(_owner || alive((DWORD)_control->ownerId))
+    return true;
+  if(lock(OwnerCheck))
+  {
+    readerGone();  // looks again under the lock, a new reader may have taken over
+    unlock();
+  }
+  return !_control->closed;
+}
+//----< writer, lock held: close the ring if its reader died >--
+
+bool SharedRing::readerGone()
+{
+  if(_control->closed)
+    return true;
+  if(alive((DWORD)_control->ownerId))
+    return false;
+  ::InterlockedExchange(&_control->closed, 1);
+  return true;
+}
+//----< take the write lock, false on time out >----------------
+/*
+ * An uncontended lock is one interlocked instruction.  A writer
+ * which finds it held spins a little, then sleeps on the lock event
+ * and looks every OwnerCheck millisecs whether the holder died.
+ */
+bool SharedRing::lock(DWORD milliseconds)
+{
+  LONG me = (LONG)::GetCurrentThreadId();
+  for(int i=0; i<SpinCount; ++i)
+  {
+    if(_control->writer == 0 && ::InterlockedCompareExchange(&_control->writer, me, 0) == 0)
+      return true;
+    ::YieldProcessor();
+  }
+  DWORD start = ::GetTickCount();
+  bool locked = false;
+  ::InterlockedIncrement(&_control->writersQueued);
+  for(;;)
+  {
+    if(::InterlockedCompareExchange(&_control->writer, me, 0) == 0)
+    {
+      locked = true;
+      break;
+    }
+    DWORD left = remaining(milliseconds, start);
+    if(left == 0)
+      break;
+    if(::WaitForSingleObject(_lockEvent, left < OwnerCheck ? left : OwnerCheck) == WAIT_TIMEOUT)
+    {
+      LONG holder = _control->writer;
+      if(holder != 0 && !threadAlive((DWORD)holder))
+        ::InterlockedCompareExchange(&_control->writer, 0, holder);  // it died holding the lock
+    }
+  }
+  ::InterlockedDecrement(&_control->writersQueued);
+  return locked;
+}
+//----< release the write lock, waking a sleeping writer >------
+
+void SharedRing::unlock()
+{
+  ::InterlockedExchange(&_control->writer, 0);
+  if(_control->writersQueued)
+    ::SetEvent(_lockEvent);
+}
+
+size_t SharedRing::maxFrame()
+{
+  return _control ? (size_t)_control->capacity / 2 - sizeof(ULONG) - 7 : 0;
+}
+
+DWORD SharedRing::ownerId()
+{
+  return _control ? (DWORD)_control->ownerId : 0;
+}
+//----< append one frame made of slices >----------------------
+/*
+ * Waits up to milliseconds for the write lock and for space.  Returns
+ * false when the frame is too big, the ring is closed, its reader
+ * died, or time runs out.
+ */
+bool SharedRing::write(const Slice* slices, size_t count, DWORD milliseconds)
+{
+  size_t len = 0;
+  for(size_t i=0; i<count; ++i)
+    len += slices[i].size;
+  if(_control == 0 || len > maxFrame())
+    return false;
+  DWORD start = ::GetTickCount();
+  if(!lock(milliseconds))
+    return false;
+  ULONG cap = (ULONG)_control->capacity;
+  ULONG need = footprint(len);
+  bool written = false;
+  while(!_control->closed)
+  {
+    ULONG tail = (ULONG)_control->tail;
+    ULONG off = tail & (cap - 1);
+    ULONG room = cap - off;                      // before the end of the ring
+    ULONG total = need <= room ? need : room + need;
+    if(cap - (tail - (ULONG)_control->head) >= total)
+    {
+      if(need > room)
+      {
+        *(ULONG*)(_ring + off) = Skip;
+        tail += room;
+        off = 0;
+      }
+      *(ULONG*)(_ring + off) = (ULONG)len;
+      char* p = _ring + off + sizeof(ULONG);
+      for(size_t i=0; i<count; ++i)
+      {
+        std::memcpy(p, slices[i].data, slices[i].size);
+        p += slices[i].size;
+      }
+      ::InterlockedExchange(&_control->tail, (LONG)(tail + need));
+      _written = tail + need;
+      if(_control->readerWaiting && ::InterlockedExchange(&_control->readerWaiting, 0))
+        ::SetEvent(_dataEvent);
+      written = true;
+      break;
+    }
+    DWORD left = remaining(milliseconds, start);
+    if(left == 0)
+      break;
+    // announce the wait, then look again, so the reader's release
+    // either is seen here or sees the announcement
+    ::InterlockedExchange(&_control->writerWaiting, 1);
+    if(cap - ((ULONG)_control->tail - (ULONG)_control->head) >= total)
+      continue;
+    // a full ring may mean a dead reader, which frees no space
+    if(::WaitForSingleObject(_spaceEvent, left < OwnerCheck ? left : OwnerCheck) == WAIT_TIMEOUT && readerGone())
+      break;
+  }
+  unlock();
+  return written;
+}
+//----< oldest frame, in place, 0 on time out or when closed >-
+
+const char* SharedRing::peek(size_t& size, DWORD milliseconds)
+{
+  size = 0;
+  if(_control == 0)
+    return 0;
+  ULONG cap = (ULONG)_control->capacity;
+  for(;;)
+  {
+    ULONG head = (ULONG)_control->head;
+    if(head != (ULONG)_control->tail)
+    {
+      ULONG off = head & (cap - 1);
+      ULONG len = *(ULONG*)(_ring + off);
+      if(len == Skip)
+      {
+        _pending = cap - off;
+        release();
+        continue;
+      }
+      _pending = footprint(len);
+      size = len;
+      return _ring + off + sizeof(ULONG);
+    }
+    if(_control->closed)
+      return 0;
+    ::InterlockedExchange(&_control->readerWaiting, 1);
+    if((ULONG)_control->tail != head || _control->closed)
+      continue;
+    if(::WaitForSingleObject(_dataEvent, milliseconds) == WAIT_TIMEOUT)
+      return 0;
+  }
+}
+//----< has the reader released the frames before position >--
+/*
+ * A ring taken over by a new reader drops the frames left in it,
+ * which counts as released.  Once this side detached, nobody reads.
+ */
+bool SharedRing::consumed(unsigned long position)
+{
+  return _control == 0 || (LONG)((ULONG)_control->head - (ULONG)position) >= 0;
+}
+//----< give the peeked frame's space back to writers >--------
+
+void SharedRing::release()
+{
+  if(_control == 0 || _pending == 0)
+    return;
+  ::InterlockedExchange(&_control->head, (LONG)((ULONG)_control->head + (ULONG)_pending));
+  _pending = 0;
+  if(_control->writerWaiting && ::InterlockedExchange(&_control->writerWaiting, 0))
+    ::SetEvent(_spaceEvent);
+}
+
+//----< constructor >------------------------------------------
+
+SharedSection::SharedSection() : _mapping(NULL), _view(0), _size(0) {}
+
+SharedSection::~SharedSection()
+{
+  close();
+}
+//----< pagefile backed memory of size bytes, named >----------
+/*
+ * Fails if an object of that name exists already, it could have
+ * been made by anybody.
+ */
+bool SharedSection::create(const std::string& name, size_t size)
+{
+  close();
+  unsigned long long bytes = size > 0 ? size : 1;
+  _mapping = ::CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+    (DWORD)(bytes >> 32), (DWORD)bytes, ("Local\\" + name).c_str());
+  if(_mapping != NULL && ::GetLastError() == ERROR_ALREADY_EXISTS)
+  {
+    close();
+    return false;
+  }
+  if(_mapping == NULL)
+    return false;
+  _view = (char*)::MapViewOfFile(_mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+  if(_view == 0)
+  {
+    close();
+    return false;
+  }
+  _size = size;
+  return true;
+}
+//----< map size bytes of a section by name, to read them >----
+/*
+ * Fails if there is no such section, or it is smaller than size.
+ */
+bool SharedSection::open(const std::string& name, size_t size)
+{
+  close();
+  _mapping = ::OpenFileMappingA(FILE_MAP_READ, FALSE, ("Local\\" + name).c_str());
+  if(_mapping == NULL)
+    return false;
+  _view = (char*)::MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, size);
+  if(_view == 0)
+  {
+    close();
+    return false;
+  }
+  _size = size;
+  return true;
+}
+//----< unmap, the memory goes when no process holds it >------
+
+void SharedSection::close()
+{
+  if(_view)
+    ::UnmapViewOfFile(_view);
+  if(_mapping != NULL)
+    ::CloseHandle(_mapping);
+  _mapping = NULL;
+  _view = 0;
+  _size = 0;
+}
+
+#ifdef TEST_SHAREDMEMORY
+
+#include "../Threads/Threads.h"
+#include <iostream>
+#include <vector>
+
+///////////////////////////////////////////////////////////////
+// writer of numbered frames of varying size
+
+class WriterThread : public threadBase
+{
+public:
+  WriterThread(const std::string& name, size_t frames) : _name(name), _frames(frames), failed(0) {}
+  size_t failed;
+private:
+  void run()
+  {
+    SharedRing ring;
+    if(!ring.open(_name))
+    {
+      failed = _frames;
+      return;
+    }
+    std::vector<char> body(40000);
+    for(size_t i=0; i<_frames; ++i)
+    {
+      size_t len = (i * 7919) % body.size();
+      for(size_t k=0; k<len; ++k)
+        body[k] = (char)(i + k);
+      SharedRing::Slice s[] = { { (const char*)&i, sizeof(i) }, { &body[0], len } };
+      if(!ring.write(s, 2, 10000))
+        ++failed;
+    }
+  }
+  std::string _name;
+  size_t _frames;
+};
+
+//----< test stub >--------------------------------------------
+
+int main()
+{
+  std::cout << "\n  Demonstrating SharedMemory";
+  std::cout << "\n ============================\n";
+
+  const size_t frames = 20000;
+  SharedRing ring;
+  if(!ring.create("SharedMemoryTest", 256 * 1024))
+  {
+    std::cout << "\n  can't create ring\n\n";
+    return 1;
+  }
+  WriterThread writer("SharedMemoryTest", frames);
+  writer.start();
+  size_t good = 0, bad = 0;
+  for(size_t n=0; n<frames; ++n)
+  {
+    size_t len;
+    const char* f = ring.peek(len, 10000);
+    if(f == 0)
+      break;
+    size_t i = *(const size_t*)f;
+    bool ok = i == n && len - sizeof(i) == (i * 7919) % 40000;
+    for(size_t k=0; ok && k<len - sizeof(i); ++k)
+      ok = f[sizeof(i) + k] == (char)(i + k);
+    ok ? ++good : ++bad;
+    ring.release();
+  }
+  writer.join();
+  std::cout << "\n  " << good << " frames intact, " << bad << " damaged, "
+            << writer.failed << " writes failed";
+
+  SharedSection sec;
+  sec.create("SharedMemoryTest.sec", 1 << 20);
+  std::memset(sec.data(), 'x', sec.size());
+  SharedSection got;
+  bool opened = got.open("SharedMemoryTest.sec", 1 << 20);
+  std::cout << "\n  section opened by name: " << (opened && got.data()[12345] == 'x' ? "ok" : "failed");
+  SharedSection twin;
+  std::cout << "\n  name taken twice: " << (twin.create("SharedMemoryTest.sec", 1 << 20) ? "created, wrong" : "refused");
+  SharedSection small;
+  std::cout << "\n  opened past its end: " << (small.open("SharedMemoryTest.sec", 2 << 20) ? "mapped, wrong" : "refused");
+
+  ring.close();
+  SharedRing late;
+  std::cout << "\n  open after close: " << (late.open("SharedMemoryTest") ? "opened, wrong" : "refused") << "\n\n";
+  return 0;
+}
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef SHAREDMEMORY_H
+#define SHAREDMEMORY_H
+///////////////////////////////////////////////////////////////
+// SharedMemory.h - Frames and sections shared by processes  //
+// ver 1.2                                                   //
+// Language: standard C++                                    //
+// Platform: Dell Dimension T7400, Windows 7, SP #1          //
+// Application: Resource for DO projects                     //
+///////////////////////////////////////////////////////////////
+/*
+ * Package Operations:
+ * ===================
+ * SharedRing passes frames of bytes from any number of writing
+ * processes to one reading process on the same host, through a
+ * named file mapping, with no system call per frame unless a side
+ * has to wait.
+ *
+ * The reader creates the ring.  Writers open it by name and take a
+ * write lock in the shared memory to append a frame: one interlocked
+ * instruction when no other writer holds it, else a short spin and
+ * then a sleep on a named event.  A writer that dies holding the lock
+ * is found by the sleepers, which take the lock from it.  Frames
+ * never wrap, a frame which does not fit before the end of the ring
+ * starts again at its beginning.  The reader looks at the oldest frame in place with
+ * peek() and gives its space back with release().  Two auto reset
+ * named events wake the reader when data arrives and a waiting
+ * writer when space is freed; Windows has no futex shared between
+ * processes, and an event left set by a side that did not have to
+ * wait only costs the other side one extra look.
+ *
+ * Positions are 32 bit counters that wrap, and the capacity is a
+ * power of two, so a position's offset survives the wrap.  A frame
+ * may be at most half the capacity.
+ *
+ * SharedSection is a block of memory of any size for a payload too
+ * big for a ring.  Its creator names and fills it, and only the name
+ * travels through the ring; the reader opens it by that name, so it
+ * never uses a handle value taken from a frame.  The creator keeps
+ * the section until consumed() says the reader released the frame
+ * that named it, which is after the reader opened the section.  A
+ * name somebody else already holds is refused.
+ *
+ * A reader which creates a ring left by a reader that died takes it
+ * over and drops the frames left in it.  Writers find out that the
+ * reader died from isOpen(), which asks the system and so is meant
+ * for once per batch of writes, and from write() when the ring stays
+ * full; either closes the ring.  Frames written after the reader died
+ * and before that are lost.
+ */
+/*
+ * Public Interface:
+ * =================
+ * SharedRing r;
+ * r.create("SocketComm.8080", 1 << 22);         // reader side
+ * const char* f = r.peek(len, INFINITE);         // oldest frame, 0 when closed
+ * r.release();                                   // done with it
+ * r.close();                                     // writers fail from now on
+ *
+ * SharedRing w;
+ * w.open("SocketComm.8080");                     // writer side
+ * if(w.isOpen()) ...                             // not closed, reader alive
+ * SharedRing::Slice s[] = { { head, n }, { body, m } };
+ * bool ok = w.write(s, 2, 5000);                 // one frame, waits up to 5 sec
+ * unsigned long end = w.written();               // ring position after that frame
+ * if(w.consumed(end)) ...                        // reader released it
+ *
+ * SharedSection sec;
+ * sec.create("SocketComm.sec.1", size);  memcpy(sec.data(), ...);
+ * SharedSection got;
+ * got.open("SocketComm.sec.1", size);            // reader maps it, read only
+ *
+ * Required Files:
+ * ---------------
+ * SharedMemory.h, SharedMemory.cpp
+ *
+ * Build Process:
+ * --------------
+ * cl /EHa /DTEST_SHAREDMEMORY SharedMemory.cpp
+ *
+ * Maintenance History:
+ * --------------------
+ * ver 1.2 : 19 Oct 2026
+ * - sections are named and opened by name, replacing handOver, revoke
+ *   and adopt; added written and consumed
+ * ver 1.1 : 19 Oct 2026
+ * - writers lock the ring in shared memory, not with a named mutex
+ * - isOpen and a write waiting for space see a dead reader
+ * ver 1.0 : 19 Oct 2026
+ * - first release
+ */
+
+#include <Windows.h>
+#include <string>
+#include <cstddef>
+
+///////////////////////////////////////////////////////////////
+// SharedRing - frames from many writers to one reader
+
+class SharedRing
+{
+public:
+  struct Slice
+  {
+    const char* data;
+    size_t size;
+  };
+  SharedRing();
+  ~SharedRing();
+  bool create(const std::string& name, size_t capacity);
+  bool open(const std::string& name);
+  void close();
+  bool isOpen();
+  size_t maxFrame();
+  DWORD ownerId();
+  bool write(const Slice* slices, size_t count, DWORD milliseconds);
+  unsigned long written() { return _written; }
+  bool consumed(unsigned long position);
+  const char* peek(size_t& size, DWORD milliseconds);
+  void release();
+private:
+  SharedRing(const SharedRing&);
+  SharedRing& operator=(const SharedRing&);
+  struct Control;
+  bool attach(const std::string& name, bool owner, size_t capacity);
+  void detach();
+  bool lock(DWORD milliseconds);
+  void unlock();
+  bool readerGone();
+  HANDLE _mapping;
+  HANDLE _dataEvent;     // set by writers
+  HANDLE _spaceEvent;    // set by the reader
+  HANDLE _lockEvent;     // set by a writer unlocking, wakes a queued writer
+  Control* _control;
+  char* _ring;
+  bool _owner;
+  size_t _pending;       // bytes of the peeked frame, 0 if none
+  unsigned long _written;  // position after the last frame this side wrote
+};
+
+///////////////////////////////////////////////////////////////
+// SharedSection - memory handed from one process to another
+
+class SharedSection
+{
+public:
+  SharedSection();
+  ~SharedSection();
+  bool create(const std::string& name, size_t size);
+  bool open(const std::string& name, size_t size);
+  void close();
+  char* data() { return _view; }
+  size_t size() { return _size; }
+private:
+  SharedSection(const SharedSection&);
+  SharedSection& operator=(const SharedSection&);
+  HANDLE _mapping;
+  char* _view;
+  size_t _size;
+};
+
+#endif
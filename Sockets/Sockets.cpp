@@ -1,6 +1,6 @@
 /////////////////////////////////////////////////////////////////////
 // Sockets.cpp - Provides basic network communication services     //
-// ver 3.1                                                         //
+// ver 3.8                                                         //
 // Language:      Visual C++, 2005                                 //
 // Platform:      Dell Dimension 9150, Windows XP Pro, SP 2.0      //
 // Application:   Utility for CSE687 and CSE775 projects           //
@@ -10,7 +10,11 @@
 
 #include "Sockets.h"
 #include "../threads/locks.h"
+#include "../Threads/Threads.h"
 #include <sstream>
+#include <map>
+#include <cstdlib>
+#include <cstring>
 
 #ifdef TRACING
   #include "..\threads\locks.h"
@@ -21,6 +25,140 @@
 
 long SocketSystem::count = 0;
 
+namespace
+{
+  const size_t AheadSize = 64 * 1024;   // bytes readLine reads ahead
+
+  // backoff jitter, one generator per thread, seeded on first use
+  // from the time and the thread's id; rand() would start every
+  // thread on the same sequence, so retries would not spread out
+  __declspec(thread) unsigned long jitterState = 0;
+
+  unsigned long jitter()
+  {
+    if(jitterState == 0)
+      jitterState = (::GetTickCount() ^ (::GetCurrentThreadId() * 2654435761UL)) | 1;
+    jitterState ^= jitterState << 13;   // xorshift32
+    jitterState ^= jitterState >> 17;
+    jitterState ^= jitterState << 5;
+    return jitterState;
+  }
+}
+
+//----< default connect policy >-------------------------------------
+/*
+ * worst case for a dead peer is roughly maxTries*attemptTimeout plus
+ * about 1.5 secs of backoff, after which its circuit opens
+ */
+ConnectPolicy::ConnectPolicy()
+  : maxTries(6), attemptTimeout(1000), backoffBase(50), backoffMax(1000),
+    breakerThreshold(3), breakerCooldown(5000) {}
+
+//----< default socket options, the system's own >------------------
+
+SocketOptions::SocketOptions()
+  : noDelay(false), sendBuffer(0), recvBuffer(0), keepAliveTime(0), keepAliveInterval(0),
+    quickAck(false), cork(false), busyPoll(0) {}
+
+//----< options for short messages which should not wait >-----------
+
+SocketOptions SocketOptions::latency()
+{
+  SocketOptions o;
+  o.noDelay = true;
+  o.quickAck = true;
+  o.keepAliveTime = 10000;
+  o.keepAliveInterval = 1000;
+#ifdef SO_BUSY_POLL
+  o.busyPoll = 50;
+#endif
+  return o;
+}
+//----< options for large transfers over high bandwidth links >------
+/*
+ * buffers are set before connect or listen, so the window scale
+ * offered in the handshake allows the full window
+ */
+SocketOptions SocketOptions::bulk()
+{
+  SocketOptions o;
+  o.sendBuffer = 4 << 20;
+  o.recvBuffer = 4 << 20;
+  o.keepAliveTime = 60000;
+  o.keepAliveInterval = 5000;
+  o.cork = true;
+  return o;
+}
+
+/////////////////////////////////////////////////////////////////////
+// circuit breaker state, one entry per remote endpoint
+
+namespace
+{
+  struct BreakerState
+  {
+    BreakerState() : failures(0), openedAt(0), trial(false) {}
+    size_t failures;  // consecutive failed connects
+    DWORD openedAt;   // tick count when circuit last opened
+    bool trial;       // a half-open trial connect is in progress
+  };
+  std::map<std::string, BreakerState> breakers;
+  CSLock breakerLock("CircuitBreaker");
+}
+//----< may we try to connect to this endpoint? >--------------------
+/*
+ * - closed circuit: always allowed
+ * - open circuit: refused until cooldown has elapsed, then a single
+ *   trial connect is let through (half-open) to probe the peer
+ */
+bool CircuitBreaker::allow(const std::string& endpoint, const ConnectPolicy& policy)
+{
+  bool allowed = true;
+  breakerLock.lock();
+  BreakerState& state = breakers[endpoint];
+  if(state.failures >= policy.breakerThreshold)
+  {
+    if(state.trial || GetTickCount() - state.openedAt < policy.breakerCooldown)
+      allowed = false;
+    else
+      state.trial = true;
+  }
+  breakerLock.unlock();
+  return allowed;
+}
+//----< record a successful connect, closing the circuit >-----------
+
+void CircuitBreaker::succeeded(const std::string& endpoint)
+{
+  breakerLock.lock();
+  breakers.erase(endpoint);
+  breakerLock.unlock();
+}
+//----< record a failed connect, opening circuit at threshold >------
+
+void CircuitBreaker::failed(const std::string& endpoint, const ConnectPolicy& policy)
+{
+  breakerLock.lock();
+  BreakerState& state = breakers[endpoint];
+  ++state.failures;
+  state.trial = false;
+  if(state.failures >= policy.breakerThreshold)
+    state.openedAt = GetTickCount();
+  breakerLock.unlock();
+}
+//----< is endpoint currently refusing connects? >-------------------
+
+bool CircuitBreaker::isOpen(const std::string& endpoint, const ConnectPolicy& policy)
+{
+  breakerLock.lock();
+  bool open = false;
+  std::map<std::string, BreakerState>::iterator it = breakers.find(endpoint);
+  if(it != breakers.end() && it->second.failures >= policy.breakerThreshold)
+    open = it->second.trial || GetTickCount() - it->second.openedAt < policy.breakerCooldown;
+  breakerLock.unlock();
+  return open;
+}
+
 //----< convert integer to string >----------------------------------
 
 std::string IntToString(const int num)
@@ -125,6 +263,132 @@ std::string SocketSystem::getIpFromName(const std::string& name)
   }
   return inet_ntoa(tcpAddr.sin_addr);
 }
+/////////////////////////////////////////////////////////////////////
+// resolver cache, shared by all SocketSystem instances
+
+namespace
+{
+  struct ResolveEntry
+  {
+    ResolveEntry() : resolvedAt(0), valid(false), refreshing(false) {}
+    std::string ip;   // dotted address, empty if lookup failed
+    DWORD resolvedAt; // tick count of last lookup
+    bool valid;       // false caches a failed lookup
+    bool refreshing;  // background refresh in progress
+  };
+  std::map<std::string, ResolveEntry> resolved;
+  CSLock resolveLock("resolver");
+  DWORD positiveTTL = 60000;  // millisecs a resolved name is used
+  DWORD negativeTTL = 5000;   // millisecs a failed lookup is remembered
+
+  //----< store result of one lookup in the cache >------------------
+
+  void storeLookup(const std::string& name, const std::string& ip, bool valid)
+  {
+    resolveLock.lock();
+    ResolveEntry& entry = resolved[name];
+    entry.ip = ip;
+    entry.valid = valid;
+    entry.resolvedAt = GetTickCount();
+    entry.refreshing = false;
+    resolveLock.unlock();
+  }
+
+  ///////////////////////////////////////////////////////////////////
+  // ResolveThread looks up a name off the connect path and deletes
+  // itself when done
+
+  class ResolveThread : public tthreadBase
+  {
+  public:
+    ResolveThread(const std::string& name) : name_(name) {}
+  private:
+    virtual void run()
+    {
+      try {
+        storeLookup(name_, ss_.getIpFromName(name_), true);
+      }
+      catch(...)
+      {
+        // keep serving the old address until it expires
+        resolveLock.lock();
+        resolved[name_].refreshing = false;
+        resolveLock.unlock();
+      }
+    }
+    std::string name_;
+    SocketSystem ss_;
+  };
+}
+//----< get ip address of network machine, using resolver cache >----
+/*
+ * - an entry past three quarters of its TTL is returned as is while a
+ *   background thread refreshes it
+ * - an expired or missing entry is looked up on the caller's thread
+ * - a cached failure throws without a lookup until negativeTTL passes
+ */
+std::string SocketSystem::resolve(const std::string& name)
+{
+  DWORD now = GetTickCount();
+  bool refresh = false;
+  resolveLock.lock();
+  std::map<std::string, ResolveEntry>::iterator it = resolved.find(name);
+  if(it != resolved.end())
+  {
+    ResolveEntry& entry = it->second;
+    DWORD age = now - entry.resolvedAt;
+    if(!entry.valid && age < negativeTTL)
+    {
+      resolveLock.unlock();
+      throw std::exception("invalid name (cached)");
+    }
+    if(entry.valid && age < positiveTTL)
+    {
+      std::string ip = entry.ip;
+      if(age >= positiveTTL - positiveTTL/4 && !entry.refreshing)
+        refresh = entry.refreshing = true;
+      resolveLock.unlock();
+      if(refresh)
+      {
+        try {
+          (new ResolveThread(name))->start();
+        }
+        catch(...) { storeLookup(name, ip, true); }
+      }
+      return ip;
+    }
+  }
+  resolveLock.unlock();
+
+  std::string ip;
+  try {
+    ip = getIpFromName(name);
+  }
+  catch(...)
+  {
+    storeLookup(name, "", false);
+    throw;
+  }
+  storeLookup(name, ip, true);
+  return ip;
+}
+//----< set how long lookups and failed lookups are cached >---------
+
+void SocketSystem::setResolverTTL(DWORD positive, DWORD negative)
+{
+  resolveLock.lock();
+  positiveTTL = positive;
+  negativeTTL = negative;
+  resolveLock.unlock();
+}
+//----< discard all cached lookups >---------------------------------
+
+void SocketSystem::flushResolverCache()
+{
+  resolveLock.lock();
+  resolved.clear();
+  resolveLock.unlock();
+}
 //----< get network name of machine from ip address >----------------
 
 std::string SocketSystem::getNameFromIp(const std::string& ip)
@@ -139,7 +403,7 @@ std::string SocketSystem::getNameFromIp(const std::string& ip)
 }
 //----< constructor creates TCP Stream socket >----------------------
 
-Socket::Socket()
+Socket::Socket() : attached_(false), io_(0), aheadPos_(0), aheadEnd_(0)
 {
   s_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
   if(s_ == INVALID_SOCKET)
@@ -148,6 +412,7 @@ Socket::Socket()
 //----< copy constructor >-------------------------------------------
 
 Socket::Socket(const Socket& sock)
+  : attached_(false), io_(0), aheadPos_(0), aheadEnd_(0), policy_(sock.policy_), options_(sock.options_)
 {
   TRACE("copying socket");
   DuplicateHandle(GetCurrentProcess(),(HANDLE)sock.s_,GetCurrentProcess(),(HANDLE*)&s_,0,false,DUPLICATE_SAME_ACCESS);
@@ -156,7 +421,7 @@ Socket::Socket(const Socket& sock)
 }
 //----< promotes WinSock SOCKET handle to Socket object >------------
 
-Socket::Socket(SOCKET s) : s_(s) {}
+Socket::Socket(SOCKET s) : s_(s), attached_(false), io_(0), aheadPos_(0), aheadEnd_(0) {}
 
 //----< destructor closes socket handle >----------------------------
 
@@ -164,6 +429,7 @@ Socket::~Socket()
 { 
   TRACE("destroying socket");
   closesocket(s_);
+  delete io_;
   //disconnect();
 }
 //----< assignment >-------------------------------------------------
@@ -172,6 +438,9 @@ Socket& Socket::operator=(const Socket& sock)
 {
   if(this == &sock) return *this;
   TRACE("copying socket");
+  policy_ = sock.policy_;
+  options_ = sock.options_;
+  reset();
   DuplicateHandle(GetCurrentProcess(),(HANDLE)sock.s_,GetCurrentProcess(),(HANDLE*)&s_,0,false,DUPLICATE_SAME_ACCESS);
   return *this;
 }
@@ -180,19 +449,33 @@ Socket& Socket::operator=(const Socket& sock)
 Socket& Socket::operator =(SOCKET sock)
 {
   TRACE("assigning from SOCKET");
+  reset();
   s_ = sock;
   return *this;
 }
 //----< connects to IP address or network host >---------------------
-
+/*
+ * - MaxTries of zero uses connectPolicy().maxTries
+ * - returns false, or throws if throwError, without touching the
+ *   network when the endpoint's circuit is open
+ */
 bool Socket::connect(std::string url, int port, bool throwError, size_t MaxTries)
 {
+  std::string endpoint = url + ":" + IntToString(port);
+  if(!CircuitBreaker::allow(endpoint, policy_))
+  {
+    TRACE("circuit open, refusing connect to " + endpoint);
+    if(throwError)
+      throw std::exception("circuit open for remote endpoint");
+    return false;
+  }
   try {
     if(isalpha(url[0]))
-      url = SocketSystem().getIpFromName(url);
+      url = ss_.resolve(url);
   }
   catch(...)
   {
+    CircuitBreaker::failed(endpoint, policy_);
     if(throwError)
       throw std::exception(ss_.GetLastMsg(true).c_str());
     return false;
@@ -201,35 +484,142 @@ bool Socket::connect(std::string url, int port, bool throwError, size_t MaxTries
   tcpAddr.sin_family = AF_INET;
   tcpAddr.sin_addr.s_addr = inet_addr(url.c_str());
   tcpAddr.sin_port = htons(port);
-  if(s_ == INVALID_SOCKET)
-  {
-    s_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-  }
+  if(MaxTries == 0)
+    MaxTries = policy_.maxTries;
   size_t tryCount = 0;
-  std::string countStr;
   while(true)
   {
     ++tryCount;
     TRACE("attempt to connect #" + IntToString(tryCount));
-    int err = ::connect(s_, (sockaddr*)&tcpAddr, sizeof(tcpAddr));
-     //std::string rip = System().getRemoteIP(this);
-    int rport = System().getRemotePort(this);
+    if(s_ == INVALID_SOCKET)
+    {
+      s_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    }
+    if(connectOnce((sockaddr*)&tcpAddr, sizeof(tcpAddr), policy_.attemptTimeout))
+      break;
 
-    // error return from connect does not appear to be reliable
-  
-    if(err != SOCKET_ERROR && rport != -1)
+    // a failed connect leaves the socket in an undefined state,
+    // so the next attempt starts with a fresh one
+    closesocket(s_);
+    s_ = INVALID_SOCKET;
+
+    if(tryCount >= MaxTries)
+    {
+      CircuitBreaker::failed(endpoint, policy_);
+      if(throwError)
+        throw std::exception(ss_.GetLastMsg(true).c_str());
+      return false;
+    }
+    ::Sleep(backoff(tryCount));
+  }
+  CircuitBreaker::succeeded(endpoint);
+  return true;
+}
+//----< connects to a local path over an AF_UNIX socket >------------
+/*
+ * - retries and circuit breaker work as for connect, the path is
+ *   the endpoint
+ * - the socket is replaced by an AF_UNIX one, connect makes a TCP
+ *   socket again after disconnect
+ */
+bool Socket::connectLocal(const std::string& path, bool throwError, size_t MaxTries)
+{
+  if(!CircuitBreaker::allow(path, policy_))
+  {
+    TRACE("circuit open, refusing connect to " + path);
+    if(throwError)
+      throw std::exception("circuit open for local endpoint");
+    return false;
+  }
+  SOCKADDR_UN localAddr = { 0 };
+  if(path.size() >= sizeof(localAddr.sun_path))
+  {
+    if(throwError)
+      throw std::exception("local socket path too long");
+    return false;
+  }
+  localAddr.sun_family = AF_UNIX;
+  path.copy(localAddr.sun_path, path.size());
+  if(MaxTries == 0)
+    MaxTries = policy_.maxTries;
+  if(s_ != INVALID_SOCKET)
+    closesocket(s_);
+  s_ = INVALID_SOCKET;
+  size_t tryCount = 0;
+  while(true)
+  {
+    ++tryCount;
+    TRACE("attempt to connect locally #" + IntToString(tryCount));
+    s_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(s_ != INVALID_SOCKET && connectOnce((sockaddr*)&localAddr, sizeof(localAddr), policy_.attemptTimeout))
       break;
+    if(s_ != INVALID_SOCKET)
+      closesocket(s_);
+    s_ = INVALID_SOCKET;
+
     if(tryCount >= MaxTries)
     {
+      CircuitBreaker::failed(path, policy_);
       if(throwError)
         throw std::exception(ss_.GetLastMsg(true).c_str());
       return false;
     }
-    ::Sleep(100);
+    ::Sleep(backoff(tryCount));
   }
-  
+  CircuitBreaker::succeeded(path);
   return true;
 }
+//----< one non-blocking connect attempt, bounded by timeout >-------
+/*
+ * socket is returned to blocking mode on success, as the rest of
+ * Socket uses blocking sends and receives
+ */
+bool Socket::connectOnce(const sockaddr* addr, int len, DWORD timeout)
+{
+  reset();
+  if(addr->sa_family == AF_INET)
+    apply(s_, options_);  // best effort, a setting the system lacks is skipped
+  unsigned long nonBlocking = 1;
+  if(::ioctlsocket(s_, FIONBIO, &nonBlocking) == SOCKET_ERROR)
+    return false;
+  int err = ::connect(s_, addr, len);
+  if(err == SOCKET_ERROR && WSAGetLastError() != WSAEWOULDBLOCK)
+    return false;
+  if(err == SOCKET_ERROR)
+  {
+    fd_set writeSet, errorSet;
+    FD_ZERO(&writeSet);
+    FD_ZERO(&errorSet);
+    FD_SET(s_, &writeSet);
+    FD_SET(s_, &errorSet);
+    timeval tv;
+    tv.tv_sec = timeout / 1000;
+    tv.tv_usec = (timeout % 1000) * 1000;
+
+    // WinSock reports a refused connect in the error set
+    if(::select(0, 0, &writeSet, &errorSet, &tv) <= 0 || !FD_ISSET(s_, &writeSet))
+      return false;
+    int sockErr = 0;
+    int len = sizeof(sockErr);
+    if(::getsockopt(s_, SOL_SOCKET, SO_ERROR, (char*)&sockErr, &len) == SOCKET_ERROR || sockErr != 0)
+      return false;
+  }
+  unsigned long blocking = 0;
+  return ::ioctlsocket(s_, FIONBIO, &blocking) != SOCKET_ERROR;
+}
+//----< delay before next attempt, exponential with jitter >---------
+/*
+ * waits between half and all of backoffBase*2^(tryCount-1), capped
+ * at backoffMax, so senders retrying one peer don't synchronize
+ */
+DWORD Socket::backoff(size_t tryCount)
+{
+  DWORD delay = policy_.backoffMax;
+  if(tryCount <= 16 && (policy_.backoffBase << (tryCount-1)) < policy_.backoffMax)
+    delay = policy_.backoffBase << (tryCount-1);
+  DWORD half = delay / 2;
+  return half + (DWORD)(jitter() % (half + 1));
+}
 //
 //----< disconnect socket >------------------------------------------
 
@@ -238,6 +628,45 @@ void Socket::disconnect()
   shutdown(s_, SD_BOTH); 
   closesocket(s_);
   s_ = INVALID_SOCKET;
+  reset();
+}
+//----< forget what belonged to the connection just replaced >-------
+
+void Socket::reset()
+{
+  attached_ = false;
+  aheadPos_ = aheadEnd_ = 0;
+}
+//----< true when sends and receives go through IoEngine >-----------
+/*
+ * attaches the socket on first use after each new connection
+ */
+bool Socket::overlapped()
+{
+  if(!IoEngine::running() || s_ == INVALID_SOCKET)
+    return false;
+  if(!attached_)
+  {
+    if(!IoEngine::attach((HANDLE)s_))
+      return false;
+    attached_ = true;
+  }
+  if(io_ == 0)
+    io_ = new IoBatch;
+  return true;
+}
+//----< refill the read ahead buffer, one overlapped receive >-------
+
+bool Socket::readAhead()
+{
+  if(ahead_.empty())
+    ahead_.resize(AheadSize);
+  aheadPos_ = aheadEnd_ = 0;
+  io_->recv(s_, &ahead_[0], ahead_.size(), false);
+  if(!io_->wait())
+    return false;
+  aheadEnd_ = io_->received();
+  return aheadEnd_ > 0;
 }
 //----< casts Socket to WinSock SOCKET handle >----------------------
 
@@ -263,12 +692,17 @@ int Socket::bytesLeft()
 {
   unsigned long bytes;
   ::ioctlsocket(s_,FIONREAD,&bytes);
-  return bytes;
+  return bytes + (int)(aheadEnd_ - aheadPos_);
 }
 //----< send blocks until all characters are sent >------------------
 
 bool Socket::sendAll(const char* block, size_t len, bool throwError)
 {
+  if(overlapped())
+  {
+    IoBuffer piece = { block, len };
+    return sendAll(&piece, 1, throwError);
+  }
   size_t bytesSent;       // current number of bytes sent
   size_t blockIndx = 0;   // place in buffer to send next
   size_t count = 0;       // number of send failures
@@ -306,10 +740,64 @@ bool Socket::sendAll(const char* block, size_t len, bool throwError)
   }
   return true;
 }
-//----< blocks until len characters have been sent >-----------------
-
+//----< send several buffers, in order, as one stream of bytes >------
+/*
+ * - one gather send through IoEngine, else one sendAll per buffer
+ * - buffers are sent in place, none is copied
+ */
+bool Socket::sendAll(const IoBuffer* pieces, size_t count, bool throwError)
+{
+  if(!overlapped())
+  {
+    for(size_t i=0; i<count; ++i)
+      if(!sendAll(pieces[i].data, pieces[i].size, throwError))
+        return false;
+    return true;
+  }
+  bool ok = io_->send(s_, pieces, count);
+  ok = io_->wait() && ok;
+  if(!ok)
+  {
+    sout << "\n  connection broken";
+    if(throwError)
+      throw std::exception("connection closed");
+  }
+  return ok;
+}
+//----< blocks until len characters have been received >-------------
+/*
+ * - takes bytes read ahead by readLine first
+ * - through IoEngine, a large remainder is received in place with
+ *   one submission, a small one through the read ahead buffer
+ */
 bool Socket::recvAll(char* block, size_t len, bool throwError)
 {
+  bool overlap = overlapped();
+  while(len > 0 && (aheadPos_ < aheadEnd_ || (overlap && len < AheadSize / 2)))
+  {
+    if(aheadPos_ == aheadEnd_ && !readAhead())
+    {
+      if(throwError)
+        throw(std::exception("remote connection closed"));
+      return false;
+    }
+    size_t n = aheadEnd_ - aheadPos_ < len ? aheadEnd_ - aheadPos_ : len;
+    memcpy(block, &ahead_[aheadPos_], n);
+    aheadPos_ += n;
+    block += n;
+    len -= n;
+  }
+  if(len > 0 && overlap)
+  {
+    io_->recv(s_, block, len, true);
+    if(!io_->wait())
+    {
+      if(throwError)
+        throw(std::exception("remote connection closed"));
+      return false;
+    }
+    return true;
+  }
   const size_t recvRetries = 100;
   size_t bytesRecvd, bytesLeft = len;
   size_t blockIndx = 0, count = 0;
@@ -373,6 +861,26 @@ bool Socket::writeLine(const std::string& str)
 std::string Socket::readLine()
 {
   std::string temp;
+  if(overlapped())
+  {
+    while(true)
+    {
+      if(aheadPos_ == aheadEnd_ && !readAhead())
+        return "";
+      char c = ahead_[aheadPos_++];
+      if(c != '\n' && c != '\r')
+        temp += c;
+      else
+      {
+        // remove remaining newline or carriage return if next in buffer
+        if(aheadPos_ == aheadEnd_ && bytesLeft() > 0)
+          readAhead();
+        if(aheadPos_ < aheadEnd_ && (ahead_[aheadPos_] == '\n' || ahead_[aheadPos_] == '\r'))
+          ++aheadPos_;
+        return temp;
+      }
+    }
+  }
   char block[1];
   //while(bytesLeft() > 0)  // don't block
   while(true)
@@ -396,6 +904,95 @@ std::string Socket::readLine()
   }
   return temp;
 }
+//----< apply options, false if any of them could not be set >-------
+
+bool Socket::apply(SOCKET s, const SocketOptions& options)
+{
+  bool ok = true;
+  if(options.noDelay)
+  {
+    BOOL on = TRUE;
+    ok = ::setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof(on)) == 0 && ok;
+  }
+  if(options.sendBuffer > 0)
+    ok = ::setsockopt(s, SOL_SOCKET, SO_SNDBUF, (const char*)&options.sendBuffer, sizeof(int)) == 0 && ok;
+  if(options.recvBuffer > 0)
+    ok = ::setsockopt(s, SOL_SOCKET, SO_RCVBUF, (const char*)&options.recvBuffer, sizeof(int)) == 0 && ok;
+  DWORD bytes = 0;
+  if(options.keepAliveTime > 0)
+  {
+    tcp_keepalive keepAlive;
+    keepAlive.onoff = 1;
+    keepAlive.keepalivetime = options.keepAliveTime;
+    keepAlive.keepaliveinterval = options.keepAliveInterval > 0 ? options.keepAliveInterval : 1000;
+    ok = ::WSAIoctl(s, SIO_KEEPALIVE_VALS, &keepAlive, sizeof(keepAlive), NULL, 0, &bytes, NULL, NULL) == 0 && ok;
+  }
+  if(options.quickAck)
+  {
+#if defined(SIO_TCP_SET_ACK_FREQUENCY)
+    DWORD every = 1;      // ACK every segment, stays set
+    ok = ::WSAIoctl(s, SIO_TCP_SET_ACK_FREQUENCY, &every, sizeof(every), NULL, 0, &bytes, NULL, NULL) == 0 && ok;
+#elif defined(TCP_QUICKACK)
+    int on = 1;           // cleared again by the stack, good for the handshake and first reads
+    ok = ::setsockopt(s, IPPROTO_TCP, TCP_QUICKACK, (const char*)&on, sizeof(on)) == 0 && ok;
+#else
+    ok = false;
+#endif
+  }
+  if(options.busyPoll > 0)
+  {
+#ifdef SO_BUSY_POLL
+    ok = ::setsockopt(s, SOL_SOCKET, SO_BUSY_POLL, (const char*)&options.busyPoll, sizeof(int)) == 0 && ok;
+#else
+    ok = false;
+#endif
+  }
+  return ok;
+}
+//----< hold back partial segments until uncorked >------------------
+/*
+ * returns false where TCP_CORK does not exist, as on Windows
+ */
+bool Socket::cork(bool on)
+{
+#ifdef TCP_CORK
+  int value = on ? 1 : 0;
+  return ::setsockopt(s_, IPPROTO_TCP, TCP_CORK, (const char*)&value, sizeof(value)) == 0;
+#else
+  return false;
+#endif
+}
+//----< process at the other end of a local socket >----------------
+/*
+ * returns 0 for a TCP socket, or if Windows cannot tell
+ */
+DWORD Socket::peerProcessId()
+{
+  ULONG pid = 0;
+  DWORD bytes = 0;
+  if(WSAIoctl(s_, SIO_AF_UNIX_GETPEERPID, NULL, 0, &pid, sizeof(pid), &bytes, NULL, NULL) == SOCKET_ERROR)
+    return 0;
+  return pid;
+}
+//----< take a handle out of the peer of a local socket >-----------
+/*
+ * - handle is a value in the peer's handle table, it is closed there
+ *   in any case, so the peer can only lend a handle of its own
+ * - returns the duplicate, owned by this process, or NULL
+ */
+HANDLE Socket::take(unsigned long long handle)
+{
+  DWORD pid = peerProcessId();
+  HANDLE peer = pid == 0 ? NULL : ::OpenProcess(PROCESS_DUP_HANDLE, FALSE, pid);
+  if(peer == NULL)
+    return NULL;
+  HANDLE mine = NULL;
+  if(!::DuplicateHandle(peer, (HANDLE)(ULONG_PTR)handle, ::GetCurrentProcess(), &mine, 0, FALSE,
+      DUPLICATE_SAME_ACCESS | DUPLICATE_CLOSE_SOURCE))
+    mine = NULL;
+  ::CloseHandle(peer);
+  return mine;
+}
 //----< get local ip address >---------------------------------------
 
 std::string SocketSystem::getLocalIP()
@@ -447,15 +1044,40 @@ int SocketSystem::getRemotePort(Socket* pSock)
   }
   return -1;
 }
+//----< get remote and local addresses with two calls >--------------
+
+bool SocketSystem::getEndpoints(Socket* pSock, SOCKADDR_IN& remote, SOCKADDR_IN& local)
+{
+  int len = sizeof(remote);
+  if(getpeername(*pSock, (sockaddr*)&remote, &len) != 0)
+    return false;
+  len = sizeof(local);
+  return getsockname(*pSock, (sockaddr*)&local, &len) == 0;
+}
+//----< get path of a local socket, empty for TCP >------------------
+
+std::string SocketSystem::getLocalPath(Socket* pSock)
+{
+  SOCKADDR_UN name = { 0 };
+  int len = sizeof(name);
+  if(getsockname(*pSock, (sockaddr*)&name, &len) != 0 || name.sun_family != AF_UNIX)
+    return "";
+  size_t n = 0;
+  while(n < sizeof(name.sun_path) && name.sun_path[n] != '\0')
+    ++n;
+  return std::string(name.sun_path, n);
+}
 //
 //----< starts listener socket listening for connections >-----------
 
-SocketListener::SocketListener(int port) : InvalidSocketCount(0)
+SocketListener::SocketListener(int port, int backLog, const SocketOptions& options)
+  : options_(options), InvalidSocketCount(0), Stopped(false)
 {
   tcpAddr.sin_family = AF_INET;   // TCP/IP
   tcpAddr.sin_port = htons(port); // listening port
   tcpAddr.sin_addr.s_addr = INADDR_ANY;
                                   // listen over every network interface
+  Socket::apply(s_, options_);    // buffer sizes must be set before listen
   int err = bind(s_, (SOCKADDR*)&tcpAddr, sizeof(tcpAddr));
 
   if(err == SOCKET_ERROR)
@@ -466,7 +1088,41 @@ SocketListener::SocketListener(int port) : InvalidSocketCount(0)
   /////////////////////////////////////////////////////////////////
   // listen for incoming connection requests
 
-  int backLog = 10;
+  err = listen(s_, backLog);
+
+  if(err == SOCKET_ERROR)
+    throw std::exception("listen mode error");
+}
+//----< starts listener listening on a local path >------------------
+/*
+ * a path still bound by a listener which answers is not taken over,
+ * a socket file nobody answers on is removed and bound again
+ */
+SocketListener::SocketListener(const std::string& path, int backLog)
+  : path_(path), InvalidSocketCount(0), Stopped(false)
+{
+  SOCKADDR_UN localAddr = { 0 };
+  if(path.size() >= sizeof(localAddr.sun_path))
+    throw std::exception("local socket path too long");
+  localAddr.sun_family = AF_UNIX;
+  path.copy(localAddr.sun_path, path.size());
+  closesocket(s_);
+  s_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(s_ == INVALID_SOCKET)
+    throw std::exception("local sockets not supported");
+
+  int err = bind(s_, (SOCKADDR*)&localAddr, sizeof(localAddr));
+  if(err == SOCKET_ERROR && WSAGetLastError() == WSAEADDRINUSE)
+  {
+    Socket probe;
+    if(probe.connectLocal(path, false, 1))
+      throw std::exception("binding error, path in use");
+    ::DeleteFileA(path.c_str());
+    err = bind(s_, (SOCKADDR*)&localAddr, sizeof(localAddr));
+  }
+  if(err == SOCKET_ERROR)
+    throw std::exception("binding error type:");
+
   err = listen(s_, backLog);
 
   if(err == SOCKET_ERROR)
@@ -484,31 +1140,65 @@ SocketListener::~SocketListener()
   catch(...) { /* don't let exception propagate on shutdown */}
 }
 //----< blocks until a connection request has been received >--------
+/*
+ * returns INVALID_SOCKET if the listener is stopped while waiting
+ */
 
 SOCKET SocketListener::waitForConnect()
 {
   const long MaxCount = 20;
-  InvalidSocketCount = 0;
+  long failures = 0;      // other errors in a row, per calling thread
   TRACE("listener waiting for connection request");
-  int size = sizeof(tcpAddr);
   SOCKET toClient;
   do {
-    toClient = accept(s_, (SOCKADDR*)&tcpAddr, &size); 
-    ++InvalidSocketCount;
-    if(InvalidSocketCount >= 20)
+    toClient = accept(s_, NULL, NULL); 
+    if(toClient != INVALID_SOCKET)
+    {
+      Socket::apply(toClient, options_);
+      break;
+    }
+    if(Stopped)
+      return INVALID_SOCKET;
+    InterlockedIncrement(&InvalidSocketCount);
+    int err = WSAGetLastError();
+    if(transient(err))
+    {
+      if(err == WSAEMFILE || err == WSAENOBUFS)
+        ::Sleep(10);      // let connections close and give back sockets
+      continue;
+    }
+    if(++failures >= MaxCount)
       throw std::exception("invalid socket connection");
   } while (toClient == INVALID_SOCKET);
   TRACE("connection establishted");
   return toClient;
 }
+//----< accept errors which leave the listener usable >--------------
+
+bool SocketListener::transient(int error)
+{
+  switch(error)
+  {
+  case WSAECONNRESET:     // client gave up before it was accepted
+  case WSAEINTR:
+  case WSAEWOULDBLOCK:
+  case WSAEMFILE:         // out of sockets for now
+  case WSAENOBUFS:
+    return true;
+  }
+  return false;
+}
 //
 //----< shuts down listerner >---------------------------------------
 
 void SocketListener::stop()
 {
   TRACE("shutting down listener in SocketListerer");
+  Stopped = true;
   shutdown(s_,SD_BOTH);
   closesocket(s_);
+  if(!path_.empty())
+    ::DeleteFileA(path_.c_str());
 }
 //----< test stub >--------------------------------------------------
 
@@ -534,6 +1224,8 @@ void main()
     std::cout << "\n  host machine name:           " << host.c_str();
     std::string ip = su.getIpFromName(host);
     std::cout << "\n  IP Address of machine:       " << ip.c_str();
+    su.resolve(host);  // first call fills the cache, second is served from it
+    std::cout << "\n  cached IP Address:           " << su.resolve(host).c_str();
     std::string name = su.getNameFromIp(ip);
     std::cout << "\n  DNS name of machine from ip: " << name.c_str() << '\n';
   
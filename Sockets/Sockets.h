@@ -2,7 +2,7 @@
 #define SOCKETS_H
 /////////////////////////////////////////////////////////////////////
 // Sockets.h   -  Provides basic network communication services    //
-// ver 3.1                                                         //
+// ver 3.8                                                         //
 // Language:      Visual C++, 2005                                 //
 // Platform:      Dell Dimension 9150, Windows XP Pro, SP 2.0      //
 // Application:   Utility for CSE687 and CSE775 projects           //
@@ -19,6 +19,10 @@
    SocketSystem:
    -------------
    provides WinSock loading, unloading and a few program wide services.
+   Name lookups made through resolve() are cached for the whole program.
+   Entries are refreshed in the background shortly before they expire,
+   and failed lookups are remembered briefly so a bad name doesn't hit
+   DNS on every connect.
    A recent change has ensured that the WinSock library is only loaded
    once, no matter how many times you construct SocketSystem objects.
    So now, the Socket class has a SocketSystem instance so you don't
@@ -27,21 +31,71 @@
 
    Socket:
    -------
-   Provides connect request and read/write services.
+   Provides connect request and read/write services.  Connect requests
+   are non-blocking with a per-attempt timeout, and failed attempts are
+   retried with jittered exponential backoff as set by ConnectPolicy.
+   connectLocal() connects to a local path instead, over an AF_UNIX
+   stream socket, which needs Windows 10 1803 or later.  The peer of a
+   local socket is a process on this host, and take() duplicates a
+   handle out of it, given the handle's value there, the way SCM_RIGHTS
+   passes a descriptor on Unix, which Windows AF_UNIX sockets do not
+   support.  Taking, not handing over, means a handle can only come from
+   the process at the other end of the socket.
+   SocketOptions is a profile of TCP settings a socket gets before it
+   connects, and a listener gets before it listens and gives each
+   socket it accepts: TCP_NODELAY, send and receive buffer sizes,
+   keepalive probes, immediate ACKs (SIO_TCP_SET_ACK_FREQUENCY, or
+   TCP_QUICKACK elsewhere), and, where the headers define them, TCP_CORK
+   and SO_BUSY_POLL.  Settings left at zero or false are not touched.
+   Windows has neither cork nor busy polling, so cork() returns false
+   there; sendAll of several buffers keeps a header and its payload in
+   one send instead.
+   Once IoEngine is started, sends and receives are overlapped and
+   complete on the engine's port.  A send of several buffers is one
+   gather submission, and readLine reads ahead into a buffer instead
+   of making one receive per character; recvAll takes what was read
+   ahead first.  Bytes read ahead stay with the Socket, a copy does
+   not see them.
+
+   CircuitBreaker:
+   ---------------
+   Counts failed connects per remote endpoint.  Once a peer has failed
+   often enough its circuit opens, and connect requests to it fail
+   immediately until a cool-down period has passed.
    
    SocketListener:
    ---------------
-   Provides connection handling.
+   Provides connection handling, on a TCP port or on a local path.  A
+   socket file left by a listener which is gone is removed before the
+   path is bound, and stop() removes it.
+   Any number of threads may wait in waitForConnect() on one listener,
+   each accepting its own connections.  Accept errors a busy server
+   sees, a client which reset before it was accepted or a brief lack of
+   sockets or buffers, are retried and never end the wait; only 20
+   other errors in a row make it throw.  A backlog of SOMAXCONN keeps a
+   burst of connects from being refused before they are accepted.
    
    Public Interface:
    =================
    SocketListener listener(2048);             // create listener
+   SocketListener busy(2048, SOMAXCONN);      // with a long backlog
    Socket recvr = listener.waitForConnect();  // start listener listening
+   SocketSystem().setResolverTTL(60000,5000); // cache names 60 s, failures 5 s
    Socket sendr;                              // create sending socket
    sender.connect("\\localhost",2048);        // request a connection
+   sender.connectPolicy().maxTries = 3;       // tune retries and timeouts
+   sender.options() = SocketOptions::latency(); // applied on connect
+   SocketListener fast(2048, 10, SocketOptions::bulk());
+   sender.cork(true);                         // hold partial segments, if supported
+   SocketListener local("C:\\run\\comm.sock"); // listen on a local path
+   Socket side;
+   side.connectLocal("C:\\run\\comm.sock");   // connect to it
+   HANDLE file = recvr.take(h);               // peer's handle h, now ours
    const char* msg = "this is a message"; 
    sender.sendAll(msg,strlen(msg)+1);         // send msg and terminating null
    sender.sendAll("quit",strlen("quit")+1);   // send another msg
+   IoBuffer parts[] = { { head, n }, { body, m } };
+   sender.sendAll(parts, 2);                  // gather send
 
    char* buffer[1024];                        // receive buffer
    recvr.recvAll(buffer,strlen(msg)+1);       // copy data when available
@@ -60,14 +114,49 @@
    Build Process:
    ==============
    Required Files:
-     Sockets.h, Sockets.cpp
+     Sockets.h, Sockets.cpp, IoEngine.h, IoEngine.cpp, mstcpip.h (SDK)
 
    Compile Command:
    ================
-   cl /EHsc /DTEST_SOCKETS Sockets.cpp wsock32.lib user32.lib
+   cl /EHsc /DTEST_SOCKETS Sockets.cpp ../IoEngine/IoEngine.cpp ../Threads/Locks.cpp
+      wsock32.lib ws2_32.lib user32.lib
 
    Maintenance History:
    ====================
+   ver 3.8 : 19 Oct 2026
+   - backoff jitter comes from a generator per thread, seeded from the
+     time and the thread id, instead of unseeded rand()
+   - take replaces handOver and revoke: the receiver duplicates a
+     handle out of its peer, instead of trusting a value the peer
+     claims to have duplicated into it
+   ver 3.7 : 19 Oct 2026
+   - added SocketOptions, applied by connect and by SocketListener
+   - added cork
+   ver 3.6 : 19 Oct 2026
+   - waitForConnect retries transient accept errors, may be called
+     from several threads at once
+   - added backlog argument to SocketListener
+   ver 3.5 : 19 Oct 2026
+   - sends and receives go through IoEngine once it is started
+   - added sendAll of several buffers, one gather send
+   - readLine reads ahead, bytesLeft counts the bytes read ahead
+   ver 3.4 : 19 Oct 2026
+   - added AF_UNIX local path endpoints: connectLocal, SocketListener
+     on a path, getLocalPath
+   - added peerProcessId, handOver and revoke, passing handles to the
+     peer of a local socket
+   - waitForConnect no longer writes the client address into the
+     listener's own address
+   ver 3.3 : 19 Oct 2026
+   - waitForConnect returns INVALID_SOCKET once the listener is stopped
+   - added getEndpoints, fetching remote and local addresses together
+   - added cached resolve(), used by connect, with TTL, negative
+     caching and background refresh
+   ver 3.2 : 19 Oct 2026
+   - connect is now non-blocking with a per-attempt timeout
+   - replaced fixed 100 ms retry sleep with jittered exponential backoff
+   - added ConnectPolicy and per-endpoint CircuitBreaker
+   - MaxTries defaults to 0, meaning use connectPolicy().maxTries
    ver 3.1 : 29 Mar 2013
    - changed ReadLine to readLine   -- breaking change
    - changed WriteLine to writeLine -- breaking change
@@ -122,7 +211,21 @@
 */
 
 #include <string>
+#include <vector>
 #include <winsock2.h>
+#include <mstcpip.h>
+#include "../IoEngine/IoEngine.h"
+
+// afunix.h ships with the Windows 10 SDK, older SDKs get the same layout
+#ifndef UNIX_PATH_MAX
+#define UNIX_PATH_MAX 108
+typedef struct sockaddr_un
+{
+  ADDRESS_FAMILY sun_family;
+  char sun_path[UNIX_PATH_MAX];
+} SOCKADDR_UN, *PSOCKADDR_UN;
+#define SIO_AF_UNIX_GETPEERPID _WSAIOR(IOC_VENDOR, 256)
+#endif
 
 /////////////////////////////////////////////////////////////////////
 // SocketSystem class loads and unloads WinSock library
@@ -130,6 +233,53 @@
 
 class Socket;
 
+/////////////////////////////////////////////////////////////////////
+// ConnectPolicy holds retry, timeout and circuit breaker settings
+// used by Socket::connect
+
+struct ConnectPolicy
+{
+  ConnectPolicy();
+  size_t maxTries;          // connect attempts before giving up
+  DWORD attemptTimeout;     // millisecs to wait on a single attempt
+  DWORD backoffBase;        // millisecs to wait after the first failure
+  DWORD backoffMax;         // upper bound on wait between attempts
+  size_t breakerThreshold;  // failed connects that open a circuit
+  DWORD breakerCooldown;    // millisecs an open circuit refuses connects
+};
+
+/////////////////////////////////////////////////////////////////////
+// SocketOptions holds TCP settings applied to a socket, zero and
+// false leave the system default
+
+struct SocketOptions
+{
+  SocketOptions();
+  static SocketOptions latency();   // small messages, answered at once
+  static SocketOptions bulk();      // large transfers, long fat links
+  bool noDelay;             // TCP_NODELAY, small writes are not delayed
+  int sendBuffer;           // SO_SNDBUF bytes
+  int recvBuffer;           // SO_RCVBUF bytes
+  DWORD keepAliveTime;      // millisecs idle before the first keepalive probe
+  DWORD keepAliveInterval;  // millisecs between unanswered probes
+  bool quickAck;            // ACK each segment, no delayed ACK
+  bool cork;                // cork() a connection while a batch is written
+  int busyPoll;             // microsecs to busy poll for data, SO_BUSY_POLL
+};
+
+/////////////////////////////////////////////////////////////////////
+// CircuitBreaker remembers connect failures per remote endpoint,
+// e.g., "127.0.0.1:8080", shared by all sockets in the process
+
+class CircuitBreaker
+{
+public:
+  static bool allow(const std::string& endpoint, const ConnectPolicy& policy);
+  static void succeeded(const std::string& endpoint);
+  static void failed(const std::string& endpoint, const ConnectPolicy& policy);
+  static bool isOpen(const std::string& endpoint, const ConnectPolicy& policy);
+};
+
 class SocketSystem
 {
 public:
@@ -138,10 +288,15 @@ public:
   std::string getHostName();
   std::string getNameFromIp(const std::string& ip);
   std::string getIpFromName(const std::string& name);
+  std::string resolve(const std::string& name);
+  void setResolverTTL(DWORD positiveTTL, DWORD negativeTTL);
+  void flushResolverCache();
   std::string getRemoteIP(Socket* pSock);
   int getRemotePort(Socket* pSock);
   std::string getLocalIP();
   int getLocalPort(Socket* pSock);
+  bool getEndpoints(Socket* pSock, SOCKADDR_IN& remote, SOCKADDR_IN& local);
+  std::string getLocalPath(Socket* pSock);
   std::string GetLastMsg(bool WantSocketMsg=true);
 private:
   static long count;
@@ -160,21 +315,41 @@ public:
   Socket& operator=(const Socket& sock);
   Socket& operator=(SOCKET sock);
   operator SOCKET ();
-  bool connect(std::string url, int port, bool throwError=false, size_t MaxTries=50);
+  bool connect(std::string url, int port, bool throwError=false, size_t MaxTries=0);
+  bool connectLocal(const std::string& path, bool throwError=false, size_t MaxTries=0);
   void disconnect();
   bool error() { return (s_ == SOCKET_ERROR); }
   int send(const char* block, size_t len);
   int recv(char* block, size_t len);
   int bytesLeft();
   bool sendAll(const char* block, size_t len, bool throwError=false);
+  bool sendAll(const IoBuffer* pieces, size_t count, bool throwError=false);
   bool recvAll(char* block, size_t len, bool throwError=false);
   bool writeLine(const std::string& str);
   std::string readLine();
+  DWORD peerProcessId();
+  HANDLE take(unsigned long long handle);
   HANDLE getHandle() { return (HANDLE)s_; }
   SocketSystem& System() { return ss_; }
+  ConnectPolicy& connectPolicy() { return policy_; }
+  SocketOptions& options() { return options_; }
+  bool cork(bool on);
+  static bool apply(SOCKET s, const SocketOptions& options);
 private:
+  bool connectOnce(const sockaddr* addr, int len, DWORD timeout);
+  DWORD backoff(size_t tryCount);
+  bool overlapped();
+  bool readAhead();
+  void reset();
   SOCKET s_;
+  bool attached_;             // s_ is attached to IoEngine's port
+  IoBatch* io_;               // created on first overlapped use
+  std::vector<char> ahead_;   // bytes read ahead of readLine and recvAll
+  size_t aheadPos_;
+  size_t aheadEnd_;
   SocketSystem ss_;
+  ConnectPolicy policy_;
+  SocketOptions options_;
 };
 
 /////////////////////////////////////////////////////////////////////
@@ -184,16 +359,22 @@ private:
 class SocketListener
 {
 public:
-  SocketListener(int port);
+  SocketListener(int port, int backLog=10, const SocketOptions& options=SocketOptions());
+  explicit SocketListener(const std::string& path, int backLog=10);
   ~SocketListener();
   SOCKET waitForConnect();
   void stop();
   long getInvalidSocketCount();
+  bool isStopped();
 private:
+  static bool transient(int error);
   SOCKADDR_IN tcpAddr;
+  std::string path_;    // local path listened on, empty for TCP
+  SocketOptions options_;  // given to every accepted socket
   Socket s_;
   SocketSystem ss_;
-  volatile long InvalidSocketCount;
+  volatile long InvalidSocketCount;   // failed accepts, all threads
+  volatile bool Stopped;
 };
 
 inline long SocketListener::getInvalidSocketCount() 
@@ -201,4 +382,9 @@ inline long SocketListener::getInvalidSocketCount()
   return InvalidSocketCount; 
 }
 
+inline bool SocketListener::isStopped()
+{
+  return Stopped;
+}
+
 #endif
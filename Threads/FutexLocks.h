@@ -0,0 +1,661 @@
+#ifndef FUTEXLOCKS_H
+#define FUTEXLOCKS_H
+///////////////////////////////////////////////////////////////
+// FutexLocks.h - Lock classes for Linux based on futexes    //
+// ver 1.1                                                   //
+// Language: standard C++                                    //
+// Platform: Linux, gcc 4.8 or later                         //
+// Application: Resource for DO projects                     //
+///////////////////////////////////////////////////////////////
+/*
+ * Package Operations:
+ * ===================
+ * Locks.h includes this file on platforms other than Windows.  It
+ * provides CSLock, gCSLock, MLock, gMLock, SRWLock, gSRWLock,
+ * CSConditionVariable and SRWConditionVariable with the same
+ * interfaces as the Win32 versions, built on Linux futexes.
+ *
+ * Each lock is a few words of user memory and makes no system call
+ * unless it is contended.  A thread that finds a lock held spins
+ * for a while, then parks on the futex until the holder releases
+ * it.  The spin limit adapts to how many spins recent acquisitions
+ * needed, so short critical sections are waited out in user mode
+ * and long ones park almost at once.
+ *
+ * Like CRITICAL_SECTIONs and Win32 mutexes, CSLock and MLock are
+ * recursive.  A Win32 mutex is a kernel object, but a futex lock
+ * needs no kernel object, so MLock is the same lock as CSLock here.
+ * SRWLocks are not recursive, and readers hold off while a writer
+ * is waiting so writers are not starved.
+ *
+ * Condition variables wait on a sequence number that every wake
+ * advances, so a wake between releasing the lock and parking is
+ * not lost.  As on Windows, sleep may return spuriously, so callers
+ * recheck their condition in a loop.
+ */
+/*
+ * Public Interface:
+ * =================
+ * same as Locks.h, see there
+ *
+ * Required Files:
+ * ---------------
+ * Locks.h, FutexLocks.h, Locks.cpp
+ *
+ * Build Process:
+ * --------------
+ * g++ -std=c++11 -pthread -DTEST_LOCKS Locks.cpp Threads.cpp
+ *
+ * Maintenance History:
+ * --------------------
+ * ver 1.1 : 19 Oct 2026
+ * - optional lock profiling, locks can be named
+ * ver 1.0 : 19 Oct 2026
+ * - first release
+ */
+
+#include <atomic>
+#include <stdexcept>
+#include <climits>
+#include <cerrno>
+#include <ctime>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+typedef unsigned long DWORD;  // timeouts keep their Win32 type
+
+#ifndef INFINITE
+#define INFINITE 0xFFFFFFFF
+#endif
+
+///////////////////////////////////////////////////////////////
+// Futex - thin wrapper around the futex system call
+
+class Futex
+{
+public:
+  static bool wait(std::atomic<int>& word, int expected, DWORD milliseconds = INFINITE);
+  static void wake(std::atomic<int>& word, int count);
+  static void relax();
+  static int spinLimit(std::atomic<int>& estimate);
+  static void spun(std::atomic<int>& estimate, int spins, bool acquired);
+  static const void* self();
+private:
+  enum { MinSpin = 10, MaxSpin = 200 };
+};
+
+//----< park while word == expected, returns false on timeout >---
+
+inline bool Futex::wait(std::atomic<int>& word, int expected, DWORD milliseconds)
+{
+  timespec ts;
+  timespec* pTimeout = 0;
+  if(milliseconds != INFINITE)
+  {
+    ts.tv_sec = milliseconds / 1000;
+    ts.tv_nsec = (milliseconds % 1000) * 1000000;
+    pTimeout = &ts;
+  }
+  long rc = ::syscall(
+    SYS_futex, reinterpret_cast<int*>(&word), FUTEX_WAIT_PRIVATE, expected, pTimeout, 0, 0
+  );
+  if(rc == 0 || errno == EAGAIN || errno == EINTR)
+    return true;
+  if(errno == ETIMEDOUT)
+    return false;
+  throw std::runtime_error("futex wait failed");
+}
+//----< unpark up to count threads waiting on word >---------------
+
+inline void Futex::wake(std::atomic<int>& word, int count)
+{
+  ::syscall(SYS_futex, reinterpret_cast<int*>(&word), FUTEX_WAKE_PRIVATE, count, 0, 0, 0);
+}
+//----< tell the cpu we are spinning >-----------------------------
+
+inline void Futex::relax()
+{
+#if defined(__i386__) || defined(__x86_64__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield" ::: "memory");
+#endif
+}
+//----< spins to try before parking >------------------------------
+
+inline int Futex::spinLimit(std::atomic<int>& estimate)
+{
+  int limit = 2 * estimate.load(std::memory_order_relaxed) + MinSpin;
+  return limit < MaxSpin ? limit : MaxSpin;
+}
+//----< move the estimate toward what the last wait needed >-------
+/*
+ * An acquisition that succeeded while spinning pulls the estimate
+ * toward the spins it took.  One that had to park pulls it toward
+ * zero, since spinning did not pay off for this lock.
+ */
+inline void Futex::spun(std::atomic<int>& estimate, int spins, bool acquired)
+{
+  int old = estimate.load(std::memory_order_relaxed);
+  int target = acquired ? spins : 0;
+  estimate.store(old + (target - old) / 8, std::memory_order_relaxed);
+}
+//----< unique id of the calling thread >--------------------------
+
+inline const void* Futex::self()
+{
+  static thread_local char tag;
+  return &tag;
+}
+
+///////////////////////////////////////////////////////////////
+// FutexMutex - non-recursive adaptive mutex
+/*
+ * state is 0 when unlocked, 1 when locked, 2 when locked and some
+ * thread may be parked.  Unlock only makes a system call in state 2.
+ */
+
+class FutexMutex
+{
+public:
+  constexpr FutexMutex();
+  void lock();
+  bool tryLock();
+  void unlock();
+private:
+  enum { Unlocked = 0, Locked = 1, Contended = 2 };
+  std::atomic<int> state;
+  std::atomic<int> spins;
+};
+
+constexpr FutexMutex::FutexMutex() : state(Unlocked), spins(0) {}
+
+inline bool FutexMutex::tryLock()
+{
+  int expected = Unlocked;
+  return state.compare_exchange_strong(expected, Locked);
+}
+
+inline void FutexMutex::lock()
+{
+  if(tryLock())
+    return;
+  int limit = Futex::spinLimit(spins);
+  for(int n = 0; n < limit; ++n)
+  {
+    Futex::relax();
+    if(state.load(std::memory_order_relaxed) == Unlocked && tryLock())
+    {
+      Futex::spun(spins, n, true);
+      return;
+    }
+  }
+  Futex::spun(spins, limit, false);
+  while(state.exchange(Contended) != Unlocked)
+    Futex::wait(state, Contended);
+}
+
+inline void FutexMutex::unlock()
+{
+  if(state.exchange(Unlocked) == Contended)
+    Futex::wake(state, 1);
+}
+
+///////////////////////////////////////////////////////////////
+// CSLock - local recursive lock, stands in for CRITICAL_SECTION
+
+class CSLock
+{
+public:
+  constexpr CSLock();
+  explicit CSLock(const char* name);
+  ~CSLock();
+  void lock();
+  void unlock();
+  void name(const char* name);  // tag shown by LockProfile::dump
+private:
+  friend class CSConditionVariable;
+  FutexMutex m;
+  std::atomic<const void*> owner;
+  unsigned int depth;
+  LOCK_PROFILE(LockProbe probe;)
+};
+
+constexpr CSLock::CSLock() : owner(0), depth(0) {}
+
+inline CSLock::CSLock(const char* name) : owner(0), depth(0)
+{
+  (void)name;                         // unused unless LOCK_PROFILING
+  LOCK_PROFILE(probe.init(name);)
+}
+
+inline CSLock::~CSLock() {}
+
+inline void CSLock::lock()
+{
+  const void* me = Futex::self();
+  if(owner.load(std::memory_order_relaxed) == me)
+  {
+    ++depth;
+    LOCK_PROFILE(probe.reenter("CSLock");)
+    return;
+  }
+#ifdef LOCK_PROFILING
+  probe.acquire([&]() { return m.tryLock(); }, [&]() { m.lock(); }, "CSLock");
+#else
+  m.lock();
+#endif
+  owner.store(me, std::memory_order_relaxed);
+  depth = 1;
+}
+
+inline void CSLock::unlock()
+{
+  LOCK_PROFILE(probe.release();)
+  if(--depth == 0)
+  {
+    owner.store(0, std::memory_order_relaxed);
+    m.unlock();
+  }
+}
+
+inline void CSLock::name(const char* name)
+{
+  (void)name;
+  LOCK_PROFILE(probe.name(name);)
+}
+
+///////////////////////////////////////////////////////////////
+// gCSLock - global lock class, all instances share one CSLock
+/*
+ * The shared CSLock is constant initialized, so it is ready before
+ * any constructor runs and needs no reference count.
+ */
+
+template<int i>
+class gCSLock
+{
+public:
+  void lock();
+  void unlock();
+  void name(const char* name) { cs.name(name); }
+private:
+  static CSLock cs;
+};
+
+template<int i>
+CSLock gCSLock<i>::cs;
+
+template<int i>
+void gCSLock<i>::lock() { cs.lock(); }
+
+template<int i>
+void gCSLock<i>::unlock() { cs.unlock(); }
+
+///////////////////////////////////////////////////////////////
+// MLock, gMLock - mutex locks, same as CSLock on Linux
+
+class MLock : public CSLock
+{
+public:
+  constexpr MLock() {}
+  explicit MLock(const char* name) : CSLock(name) {}
+};
+
+template<int i>
+class gMLock
+{
+public:
+  void lock();
+  void unlock();
+  void name(const char* name) { m.name(name); }
+private:
+  static MLock m;
+};
+
+template<int i>
+MLock gMLock<i>::m;
+
+template<int i>
+void gMLock<i>::lock() { m.lock(); }
+
+template<int i>
+void gMLock<i>::unlock() { m.unlock(); }
+
+///////////////////////////////////////////////////////////////
+// SRWLock - local reader/writer lock
+/*
+ * state holds the reader count, or Writer while a writer owns the
+ * lock.  Blocked threads park on seq, which every release that may
+ * unblock someone advances when parked is non-zero.
+ */
+
+class SRWLock
+{
+public:
+  constexpr SRWLock();
+  explicit SRWLock(const char* name);
+  ~SRWLock();
+  void lockExclusive();
+  void lockShared();
+  void unlockExclusive();
+  void unlockShared();
+  void name(const char* name);  // tag shown by LockProfile::dump
+private:
+  enum { Writer = 1 << 30 };
+  bool tryShared();
+  bool tryExclusive();
+  void lockSharedImpl();
+  void lockExclusiveImpl();
+  void released();
+  std::atomic<int> state;
+  std::atomic<int> writers;  // writers waiting
+  std::atomic<int> parked;
+  std::atomic<int> seq;
+  std::atomic<int> spins;
+  LOCK_PROFILE(LockProbe probe;)
+};
+
+constexpr SRWLock::SRWLock() : state(0), writers(0), parked(0), seq(0), spins(0) {}
+
+inline SRWLock::SRWLock(const char* name) : state(0), writers(0), parked(0), seq(0), spins(0)
+{
+  (void)name;
+  LOCK_PROFILE(probe.init(name);)
+}
+
+inline void SRWLock::name(const char* name)
+{
+  (void)name;
+  LOCK_PROFILE(probe.name(name);)
+}
+
+inline SRWLock::~SRWLock() {}
+
+inline bool SRWLock::tryShared()
+{
+  int s = state.load();
+  return (s & Writer) == 0 && writers.load() == 0 && state.compare_exchange_weak(s, s + 1);
+}
+
+inline bool SRWLock::tryExclusive()
+{
+  int s = 0;
+  return state.compare_exchange_strong(s, Writer);
+}
+
+inline void SRWLock::lockShared()
+{
+#ifdef LOCK_PROFILING
+  probe.acquireShared([&]() { return tryShared(); }, [&]() { lockSharedImpl(); }, "SRWLock");
+#else
+  lockSharedImpl();
+#endif
+}
+
+inline void SRWLock::lockSharedImpl()
+{
+  if(tryShared())
+    return;
+  int limit = Futex::spinLimit(spins);
+  for(int n = 0; n < limit; ++n)
+  {
+    Futex::relax();
+    if(tryShared())
+    {
+      Futex::spun(spins, n, true);
+      return;
+    }
+  }
+  Futex::spun(spins, limit, false);
+  while(true)
+  {
+    parked.fetch_add(1);
+    int ticket = seq.load();
+    bool acquired = tryShared();
+    if(!acquired)
+      Futex::wait(seq, ticket);
+    parked.fetch_sub(1);
+    if(acquired)
+      return;
+  }
+}
+
+inline void SRWLock::lockExclusive()
+{
+#ifdef LOCK_PROFILING
+  probe.acquire([&]() { return tryExclusive(); }, [&]() { lockExclusiveImpl(); }, "SRWLock");
+#else
+  lockExclusiveImpl();
+#endif
+}
+
+inline void SRWLock::lockExclusiveImpl()
+{
+  if(tryExclusive())
+    return;
+  writers.fetch_add(1);
+  int limit = Futex::spinLimit(spins);
+  for(int n = 0; n < limit; ++n)
+  {
+    Futex::relax();
+    if(tryExclusive())
+    {
+      writers.fetch_sub(1);
+      Futex::spun(spins, n, true);
+      return;
+    }
+  }
+  Futex::spun(spins, limit, false);
+  while(true)
+  {
+    parked.fetch_add(1);
+    int ticket = seq.load();
+    bool acquired = tryExclusive();
+    if(!acquired)
+      Futex::wait(seq, ticket);
+    parked.fetch_sub(1);
+    if(acquired)
+      break;
+  }
+  writers.fetch_sub(1);
+}
+
+//----< wake parked threads so they can retry >--------------------
+
+inline void SRWLock::released()
+{
+  if(parked.load() > 0)
+  {
+    seq.fetch_add(1);
+    Futex::wake(seq, INT_MAX);
+  }
+}
+
+inline void SRWLock::unlockShared()
+{
+  if(state.fetch_sub(1) == 1)
+    released();
+}
+
+inline void SRWLock::unlockExclusive()
+{
+  LOCK_PROFILE(probe.release();)
+  state.store(0);
+  released();
+}
+
+///////////////////////////////////////////////////////////////
+// gSRWLock - global reader/writer lock class
+
+template<int i>
+class gSRWLock
+{
+public:
+  void lockExclusive();
+  void lockShared();
+  void unlockExclusive();
+  void unlockShared();
+  void name(const char* name) { srw.name(name); }
+private:
+  static SRWLock srw;
+};
+
+template<int i>
+SRWLock gSRWLock<i>::srw;
+
+template<int i>
+void gSRWLock<i>::lockExclusive() { srw.lockExclusive(); }
+
+template<int i>
+void gSRWLock<i>::lockShared() { srw.lockShared(); }
+
+template<int i>
+void gSRWLock<i>::unlockExclusive() { srw.unlockExclusive(); }
+
+template<int i>
+void gSRWLock<i>::unlockShared() { srw.unlockShared(); }
+
+///////////////////////////////////////////////////////////////
+// CSConditionVariable - ConditionVariable used with CSLock
+/*
+ * sleep releases the lock completely, even if the caller holds it
+ * recursively, and restores the recursion depth when it wakes.
+ */
+
+class CSConditionVariable
+{
+public:
+  CSConditionVariable();
+  ~CSConditionVariable();
+  void sleep(CSLock& csl);
+  bool sleep(CSLock& csl, DWORD milliseconds);
+  void wake();
+  void wakeAll();
+private:
+  std::atomic<int> seq;
+  std::atomic<int> waiters;
+};
+
+inline CSConditionVariable::CSConditionVariable() : seq(0), waiters(0) {}
+
+inline CSConditionVariable::~CSConditionVariable() {}
+
+inline void CSConditionVariable::sleep(CSLock& lock)
+{
+  sleep(lock, INFINITE);
+}
+
+//----< sleep with timeout, returns false if timed out >-----------
+
+inline bool CSConditionVariable::sleep(CSLock& lock, DWORD milliseconds)
+{
+  waiters.fetch_add(1);
+  int ticket = seq.load();
+  LOCK_PROFILE(unsigned int held = lock.probe.suspend();)
+  unsigned int depth = lock.depth;
+  lock.depth = 1;
+  lock.unlock();
+  bool woken = Futex::wait(seq, ticket, milliseconds);
+  waiters.fetch_sub(1);
+  lock.lock();
+  lock.depth = depth;
+  LOCK_PROFILE(lock.probe.resume(held);)
+  return woken;
+}
+
+inline void CSConditionVariable::wake()
+{
+  seq.fetch_add(1);
+  if(waiters.load() > 0)
+    Futex::wake(seq, 1);
+}
+
+inline void CSConditionVariable::wakeAll()
+{
+  seq.fetch_add(1);
+  if(waiters.load() > 0)
+    Futex::wake(seq, INT_MAX);
+}
+
+///////////////////////////////////////////////////////////////
+// SRWConditionVariable - ConditionVariable used with SRWLock
+
+class SRWConditionVariable
+{
+public:
+  SRWConditionVariable();
+  ~SRWConditionVariable();
+  void sleep(SRWLock& srwl);
+  bool sleep(SRWLock& srwl, DWORD milliseconds);
+  void sleepShared(SRWLock& srwl);
+  bool sleepShared(SRWLock& srwl, DWORD milliseconds);
+  void wake();
+  void wakeAll();
+private:
+  bool park(int ticket, DWORD milliseconds);
+  std::atomic<int> seq;
+  std::atomic<int> waiters;
+};
+
+inline SRWConditionVariable::SRWConditionVariable() : seq(0), waiters(0) {}
+
+inline SRWConditionVariable::~SRWConditionVariable() {}
+
+inline bool SRWConditionVariable::park(int ticket, DWORD milliseconds)
+{
+  bool woken = Futex::wait(seq, ticket, milliseconds);
+  waiters.fetch_sub(1);
+  return woken;
+}
+
+//----< sleep holding the lock exclusively >-----------------------
+
+inline void SRWConditionVariable::sleep(SRWLock& lock)
+{
+  sleep(lock, INFINITE);
+}
+
+inline bool SRWConditionVariable::sleep(SRWLock& lock, DWORD milliseconds)
+{
+  waiters.fetch_add(1);
+  int ticket = seq.load();
+  lock.unlockExclusive();
+  bool woken = park(ticket, milliseconds);
+  lock.lockExclusive();
+  return woken;
+}
+
+//----< sleep holding the lock shared >----------------------------
+
+inline void SRWConditionVariable::sleepShared(SRWLock& lock)
+{
+  sleepShared(lock, INFINITE);
+}
+
+inline bool SRWConditionVariable::sleepShared(SRWLock& lock, DWORD milliseconds)
+{
+  waiters.fetch_add(1);
+  int ticket = seq.load();
+  lock.unlockShared();
+  bool woken = park(ticket, milliseconds);
+  lock.lockShared();
+  return woken;
+}
+
+inline void SRWConditionVariable::wake()
+{
+  seq.fetch_add(1);
+  if(waiters.load() > 0)
+    Futex::wake(seq, 1);
+}
+
+inline void SRWConditionVariable::wakeAll()
+{
+  seq.fetch_add(1);
+  if(waiters.load() > 0)
+    Futex::wake(seq, INT_MAX);
+}
+
+#endif
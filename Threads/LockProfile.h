@@ -0,0 +1,402 @@
+#ifndef LOCKPROFILE_H
+#define LOCKPROFILE_H
+///////////////////////////////////////////////////////////////
+// LockProfile.h - Contention statistics for Locks.h         //
+// ver 1.0                                                   //
+// Language: standard C++                                    //
+// Platform: Dell Dimension T7400, Windows 7, SP #1          //
+// Application: Resource for DO projects                     //
+///////////////////////////////////////////////////////////////
+/*
+ * Package Operations:
+ * ===================
+ * When built with LOCK_PROFILING defined, every lock in Locks.h
+ * carries a LockProbe that records, for that lock:
+ *   - acquisitions, and how many of them had to wait
+ *   - total and maximum wait time, with a log2 histogram
+ *   - total and maximum hold time, with a log2 histogram
+ * Hold times are recorded for exclusive acquisitions only, since
+ * shared holders overlap.  A condition variable sleep ends the hold
+ * and the wake starts a new one.
+ *
+ * Locks are tagged with a name, given to the constructor or set
+ * with name().  Unnamed locks show their class name.  Statistics
+ * outlive their lock, so a dump at exit still shows locks that
+ * belonged to short-lived objects.
+ *
+ * Without LOCK_PROFILING the probes are not compiled in, naming a
+ * lock does nothing, and dump() just says profiling is off.
+ */
+/*
+ * Public Interface:
+ * =================
+ * CSLock l("sendQ");               // named lock
+ * gCSLock<1>().name("console");    // name a global lock
+ * LockProfile::dump(std::cout);    // table of all locks seen so far
+ * LockProfile::reset();            // zero all statistics
+ *
+ * Required Files:
+ * ---------------
+ * LockProfile.h, Locks.h, HiResTimer.h
+ *
+ * Build Process:
+ * --------------
+ * cl /EHa /DLOCK_PROFILING /DTEST_LOCKS Locks.cpp
+ *
+ * Maintenance History:
+ * --------------------
+ * ver 1.0 : 19 Oct 2026
+ * - first release
+ */
+
+#include <iostream>
+
+#ifdef LOCK_PROFILING
+
+#include <atomic>
+#include <cstring>
+#include <iomanip>
+#include "../HiResTimer/HiResTimer.h"
+
+#define LOCK_PROFILE(statement) statement
+
+///////////////////////////////////////////////////////////////
+// LockStats - counters and histograms for one lock
+
+class LockStats
+{
+public:
+  enum { Buckets = 32, NameSize = 48 };
+  LockStats(const char* name);
+  void name(const char* name);
+  void acquired(long long waitNs, bool contended);
+  void held(long long holdNs);
+  void reset();
+  void dump(std::ostream& out);
+  LockStats* next;
+private:
+  static size_t bucket(long long ns);
+  static long long percentile(std::atomic<long long>* hist, double fraction);
+  static void raise(std::atomic<long long>& max, long long value);
+  char _name[NameSize];
+  std::atomic<long long> _acquisitions;
+  std::atomic<long long> _contended;
+  std::atomic<long long> _waitNs;
+  std::atomic<long long> _maxWait;
+  std::atomic<long long> _holds;
+  std::atomic<long long> _holdNs;
+  std::atomic<long long> _maxHold;
+  std::atomic<long long> _waitHist[Buckets];
+  std::atomic<long long> _holdHist[Buckets];
+};
+
+//----< constructor >------------------------------------------
+
+inline LockStats::LockStats(const char* name) : next(0)
+{
+  this->name(name);
+  reset();
+}
+//----< set the name shown by dump >---------------------------
+
+inline void LockStats::name(const char* name)
+{
+  ::strncpy(_name, name, NameSize - 1);
+  _name[NameSize - 1] = '\0';
+}
+//----< zero all statistics >----------------------------------
+
+inline void LockStats::reset()
+{
+  _acquisitions = 0;
+  _contended = 0;
+  _waitNs = 0;
+  _maxWait = 0;
+  _holds = 0;
+  _holdNs = 0;
+  _maxHold = 0;
+  for(size_t i=0; i<Buckets; ++i)
+  {
+    _waitHist[i] = 0;
+    _holdHist[i] = 0;
+  }
+}
+//----< histogram bucket b counts times below 2^b ns >---------
+
+inline size_t LockStats::bucket(long long ns)
+{
+  size_t b = 0;
+  while(ns > 0 && b < Buckets - 1)
+  {
+    ns >>= 1;
+    ++b;
+  }
+  return b;
+}
+//----< keep the larger of max and value >---------------------
+
+inline void LockStats::raise(std::atomic<long long>& max, long long value)
+{
+  long long old = max.load(std::memory_order_relaxed);
+  while(value > old && !max.compare_exchange_weak(old, value, std::memory_order_relaxed))
+    ;
+}
+//----< record one acquisition >-------------------------------
+
+inline void LockStats::acquired(long long waitNs, bool contended)
+{
+  _acquisitions.fetch_add(1, std::memory_order_relaxed);
+  _waitHist[bucket(waitNs)].fetch_add(1, std::memory_order_relaxed);
+  if(!contended)
+    return;
+  _contended.fetch_add(1, std::memory_order_relaxed);
+  _waitNs.fetch_add(waitNs, std::memory_order_relaxed);
+  raise(_maxWait, waitNs);
+}
+//----< record one exclusive hold >----------------------------
+
+inline void LockStats::held(long long holdNs)
+{
+  _holds.fetch_add(1, std::memory_order_relaxed);
+  _holdNs.fetch_add(holdNs, std::memory_order_relaxed);
+  _holdHist[bucket(holdNs)].fetch_add(1, std::memory_order_relaxed);
+  raise(_maxHold, holdNs);
+}
+//----< upper bound, in ns, of the bucket holding the fraction >
+
+inline long long LockStats::percentile(std::atomic<long long>* hist, double fraction)
+{
+  long long total = 0;
+  for(size_t i=0; i<Buckets; ++i)
+    total += hist[i].load(std::memory_order_relaxed);
+  if(total == 0)
+    return 0;
+  long long seen = 0;
+  for(size_t i=0; i<Buckets; ++i)
+  {
+    seen += hist[i].load(std::memory_order_relaxed);
+    if(seen >= total * fraction)
+      return i == 0 ? 0 : 1LL << i;
+  }
+  return 1LL << (Buckets - 1);
+}
+//----< write one table row >----------------------------------
+
+inline void LockStats::dump(std::ostream& out)
+{
+  long long acquisitions = _acquisitions.load();
+  long long contended = _contended.load();
+  long long holds = _holds.load();
+  out << "\n  " << std::left << std::setw(20) << _name << std::right
+      << std::setw(12) << acquisitions
+      << std::setw(11) << contended
+      << std::setw(11) << (contended ? _waitNs.load() / contended : 0)
+      << std::setw(11) << percentile(_waitHist, 0.99)
+      << std::setw(11) << _maxWait.load()
+      << std::setw(11) << (holds ? _holdNs.load() / holds : 0)
+      << std::setw(11) << percentile(_holdHist, 0.99)
+      << std::setw(11) << _maxHold.load();
+}
+
+///////////////////////////////////////////////////////////////
+// LockProfile - registry of every LockStats created
+
+class LockProfile
+{
+public:
+  static LockStats* enlist(LockStats* pStats);
+  static void dump(std::ostream& out);
+  static void reset();
+private:
+  static std::atomic<LockStats*>& head();
+};
+
+//----< list head, zero initialized before any lock is built >-
+
+inline std::atomic<LockStats*>& LockProfile::head()
+{
+  static std::atomic<LockStats*> first;
+  return first;
+}
+//----< register statistics of a new lock >--------------------
+
+inline LockStats* LockProfile::enlist(LockStats* pStats)
+{
+  LockStats* old = head().load();
+  do {
+    pStats->next = old;
+  } while(!head().compare_exchange_weak(old, pStats));
+  return pStats;
+}
+//----< write a table of all locks >---------------------------
+
+inline void LockProfile::dump(std::ostream& out)
+{
+  out << "\n  " << std::left << std::setw(20) << "lock" << std::right
+      << std::setw(12) << "acquired" << std::setw(11) << "contended"
+      << std::setw(11) << "wait avg" << std::setw(11) << "wait p99"
+      << std::setw(11) << "wait max" << std::setw(11) << "hold avg"
+      << std::setw(11) << "hold p99" << std::setw(11) << "hold max";
+  out << "\n  " << std::string(109, '-');
+  for(LockStats* pStats = head().load(); pStats != 0; pStats = pStats->next)
+    pStats->dump(out);
+  out << "\n  (times in nanoseconds, p99 is a power of two upper bound)\n";
+  out.flush();
+}
+//----< zero statistics of all locks >-------------------------
+
+inline void LockProfile::reset()
+{
+  for(LockStats* pStats = head().load(); pStats != 0; pStats = pStats->next)
+    pStats->reset();
+}
+
+///////////////////////////////////////////////////////////////
+// LockProbe - per lock hook called by the lock classes
+/*
+ * A probe is all zero until first used, so it works in global locks
+ * whose statics may be used before their constructors run.  The
+ * owner of the lock is the only thread touching heldSince and depth.
+ */
+
+class LockProbe
+{
+public:
+#ifndef _WIN32
+  constexpr LockProbe() : pStats(nullptr), heldSince(0), depth(0) {}
+#endif
+  void init(const char* name);
+  void name(const char* name);
+  template <typename TryF, typename WaitF>
+  void acquire(TryF tryLock, WaitF waitLock, const char* fallback);
+  template <typename TryF, typename WaitF>
+  void acquireShared(TryF tryLock, WaitF waitLock, const char* fallback);
+  void reenter(const char* fallback);
+  void release();
+  unsigned int suspend();
+  void resume(unsigned int savedDepth);
+private:
+  LockStats* stats(const char* fallback);
+  long long waitFor(bool& contended);
+  std::atomic<LockStats*> pStats;
+  long long heldSince;
+  unsigned int depth;
+};
+
+//----< called by lock constructors, name may be null >--------
+
+inline void LockProbe::init(const char* name)
+{
+  pStats = name ? LockProfile::enlist(new LockStats(name)) : 0;
+  heldSince = 0;
+  depth = 0;
+}
+//----< rename, registering the lock if not seen before >------
+
+inline void LockProbe::name(const char* name)
+{
+  stats(name)->name(name);
+}
+//----< statistics, registered on first use >------------------
+
+inline LockStats* LockProbe::stats(const char* fallback)
+{
+  LockStats* pOld = pStats.load();
+  if(pOld != 0)
+    return pOld;
+  LockStats* pNew = new LockStats(fallback);
+  if(pStats.compare_exchange_strong(pOld, pNew))
+    return LockProfile::enlist(pNew);
+  delete pNew;  // another thread registered this lock first
+  return pOld;
+}
+//----< take the lock, recording how long we waited >----------
+
+template <typename TryF, typename WaitF>
+void LockProbe::acquire(TryF tryLock, WaitF waitLock, const char* fallback)
+{
+  LockStats* pS = stats(fallback);
+  if(tryLock())
+  {
+    pS->acquired(0, false);
+  }
+  else
+  {
+    long long start = HRTimer::HiResTimer::Now();
+    waitLock();
+    pS->acquired(HRTimer::HiResTimer::ToNanoseconds(HRTimer::HiResTimer::Now() - start), true);
+  }
+  if(depth++ == 0)
+    heldSince = HRTimer::HiResTimer::Now();
+}
+//----< take a shared lock, holds are not timed >--------------
+
+template <typename TryF, typename WaitF>
+void LockProbe::acquireShared(TryF tryLock, WaitF waitLock, const char* fallback)
+{
+  LockStats* pS = stats(fallback);
+  if(tryLock())
+  {
+    pS->acquired(0, false);
+    return;
+  }
+  long long start = HRTimer::HiResTimer::Now();
+  waitLock();
+  pS->acquired(HRTimer::HiResTimer::ToNanoseconds(HRTimer::HiResTimer::Now() - start), true);
+}
+//----< recursive acquisition by the owner >-------------------
+
+inline void LockProbe::reenter(const char* fallback)
+{
+  stats(fallback)->acquired(0, false);
+  ++depth;
+}
+//----< called before the lock is released >-------------------
+
+inline void LockProbe::release()
+{
+  if(depth == 0 || --depth > 0)
+    return;
+  LockStats* pS = pStats.load();
+  if(pS != 0)
+    pS->held(HRTimer::HiResTimer::ToNanoseconds(HRTimer::HiResTimer::Now() - heldSince));
+}
+//----< end the hold before a condition variable sleep >-------
+
+inline unsigned int LockProbe::suspend()
+{
+  unsigned int saved = depth;
+  depth = 1;
+  release();
+  return saved;
+}
+//----< start a new hold after a condition variable wake >-----
+
+inline void LockProbe::resume(unsigned int savedDepth)
+{
+  depth = savedDepth;
+  heldSince = HRTimer::HiResTimer::Now();
+}
+
+#else
+
+#define LOCK_PROFILE(statement)
+
+///////////////////////////////////////////////////////////////
+// LockProfile - stand-in when profiling is compiled out
+
+class LockProfile
+{
+public:
+  static void dump(std::ostream& out);
+  static void reset() {}
+};
+
+inline void LockProfile::dump(std::ostream& out)
+{
+  out << "\n  lock profiling is off, build with LOCK_PROFILING defined\n";
+}
+
+#endif
+
+#endif
@@ -1,7 +1,7 @@
 ///////////////////////////////////////////////////////////////
 // Locks.h - Define Lock classes based on:                   //
 //             CriticalSection, SlimReaderWriter, Mutex      // 
-// ver 1.1                                                   //
+// ver 1.3                                                   //
 // Language: standard C++                                    //
 // Platform: Dell Dimension T7400, Windows 7, SP #1          //
 // Application: Resource for DO projects                     //
@@ -20,7 +20,9 @@ syncOut sout(std::cout);  // globally available sout object
 #ifdef TEST_LOCKS
 
 #include "Threads.h"
-#include "../NewThreadsAndLocks/HiResTimer.h"
+#include "../HiResTimer/HiResTimer.h"
+#include <chrono>
+#include <thread>
 
 ///////////////////////////////////////////////////////////////
 // test derived class
@@ -55,7 +57,7 @@ void TestThread::run()
     tLock.lock();
     Msg += '0';
     tLock.unlock();
-    ::Sleep(2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
   }
   doLog("child exiting");
 }
@@ -79,16 +81,148 @@ int main()
       pLock.lock();
       Message += '1';
       pLock.unlock();
-      ::Sleep(1);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
     td.join();
     timer.Stop();
   }
   std::cout << "\n  This string was shared and concurrently modified:";
   std::cout << "\n  " << Message.c_str();
-  std::cout << "\n  Elapsed time = " << timer.ElapsedMicroseconds() << " microsecs";
+  std::cout << "\n  Elapsed time = " << timer.ElapsedMicroseconds() << " microsecs\n";
+  LockProfile::dump(std::cout);
   std::cout.flush();
   std::cout << "\n  parent exiting\n\n";
 }
 
 #endif
+
+#ifdef BENCH_LOCKS
+
+///////////////////////////////////////////////////////////////
+// Contention benchmark
+/*
+ * Each run starts some threads that all take the same lock, spin
+ * for a critical section of csLen iterations, release the lock and
+ * spin for csLen more outside it.  The time per acquisition, over
+ * all threads, is reported for each lock type, thread count and
+ * critical section length.  A shared counter incremented under the
+ * lock checks that no acquisition was lost.
+ *
+ *   cl /EHa /O2 /DBENCH_LOCKS Locks.cpp
+ *   g++ -O2 -std=c++11 -pthread -DBENCH_LOCKS Locks.cpp
+ */
+
+#include "Threads.h"
+#include "../HiResTimer/HiResTimer.h"
+#include <vector>
+#include <iomanip>
+
+//----< lock adapters giving every lock type lock/unlock >-----
+
+class ExclusiveSRW
+{
+public:
+  void lock() { l.lockExclusive(); }
+  void unlock() { l.unlockExclusive(); }
+private:
+  SRWLock l;
+};
+
+//----< burn a fixed amount of cpu >---------------------------
+
+inline void work(size_t n)
+{
+  volatile size_t sink = 0;
+  for(size_t i=0; i<n; ++i)
+    sink += i;
+}
+
+///////////////////////////////////////////////////////////////
+// thread hammering one lock
+
+template <typename Lock>
+class ContendThread : public ThreadBase<DefaultTerminate>
+{
+public:
+  ContendThread(Lock& l, volatile size_t& count, size_t iters, size_t csLen)
+    : _l(l), _count(count), _iters(iters), _csLen(csLen) {}
+private:
+  virtual void run()
+  {
+    for(size_t i=0; i<_iters; ++i)
+    {
+      _l.lock();
+      work(_csLen);
+      _count = _count + 1;
+      _l.unlock();
+      work(_csLen);
+    }
+  }
+  Lock& _l;
+  volatile size_t& _count;
+  size_t _iters;
+  size_t _csLen;
+};
+
+//----< nanosecs per acquisition, 0 if the count came out wrong >
+
+template <typename Lock>
+double contend(size_t threads, size_t iters, size_t csLen)
+{
+  Lock l;
+  volatile size_t count = 0;
+  std::vector<ContendThread<Lock>*> pool;
+  for(size_t i=0; i<threads; ++i)
+    pool.push_back(new ContendThread<Lock>(l, count, iters, csLen));
+  HRTimer::HiResTimer timer;
+  timer.Start();
+  for(size_t i=0; i<threads; ++i)
+    pool[i]->start();
+  for(size_t i=0; i<threads; ++i)
+    pool[i]->join();
+  timer.Stop();
+  for(size_t i=0; i<threads; ++i)
+    delete pool[i];
+  if(count != threads * iters)
+    return 0;
+  return double(timer.ElapsedNanoseconds()) / (threads * iters);
+}
+
+//----< one table row per critical section length >-----------
+
+template <typename Lock>
+void table(const char* name)
+{
+  const size_t threadCounts[] = { 1, 2, 4, 8 };
+  const size_t csLens[] = { 0, 10, 100, 1000 };
+  const size_t iters = 100000;
+  std::cout << "\n  " << name << " - nanosecs per acquisition";
+  std::cout << "\n    csLen";
+  for(size_t t=0; t<4; ++t)
+    std::cout << std::setw(9) << threadCounts[t] << "T";
+  for(size_t c=0; c<4; ++c)
+  {
+    std::cout << "\n  " << std::setw(7) << csLens[c];
+    for(size_t t=0; t<4; ++t)
+    {
+      double ns = contend<Lock>(threadCounts[t], iters / threadCounts[t], csLens[c]);
+      if(ns == 0)
+        std::cout << std::setw(10) << "LOST";
+      else
+        std::cout << std::setw(10) << std::fixed << std::setprecision(1) << ns;
+    }
+  }
+  std::cout << "\n";
+}
+
+int main()
+{
+  std::cout << "\n  Lock Contention Benchmark";
+  std::cout << "\n ===========================\n";
+  table<CSLock>("CSLock");
+  table<MLock>("MLock");
+  table<ExclusiveSRW>("SRWLock exclusive");
+  std::cout << "\n\n";
+}
+
+#endif
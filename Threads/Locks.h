@@ -3,7 +3,7 @@
 ///////////////////////////////////////////////////////////////
 // Locks.h - Define Lock classes based on:                   //
 //             CriticalSection, SlimReaderWriter, Mutex      // 
-// ver 1.1                                                   //
+// ver 1.4                                                   //
 // Language: standard C++                                    //
 // Platform: Dell Dimension T7400, Windows 7, SP #1          //
 // Application: Resource for DO projects                     //
@@ -23,9 +23,16 @@
  *
  * A SRWLock class is defined, but hasn't been tested yet.
  *
- * Also, you will find a ConditionVariable class implementation,
+ * Also, you will find ConditionVariable class implementations,
  * used to build a blocking queue.  See the note where the
  * ConditionVariable is defined, at the end of this file.
+ *
+ * On Windows these classes wrap Win32 primitives.  Elsewhere
+ * FutexLocks.h supplies the same classes built on Linux futexes.
+ *
+ * Building with LOCK_PROFILING defined records acquisitions, waits
+ * and hold times for every lock, see LockProfile.h.  Locks can be
+ * given a name for the profile, which costs nothing otherwise.
  */
 /*
  * Public Interface:
@@ -33,28 +40,55 @@
  * CSLock l;
  * l.lock();	// lock
  * l.unlock();	// unlock
+ * CSLock q("sendQ");	// named for LockProfile::dump
+ *
+ * CSConditionVariable cv;
+ * cv.sleep(l);	// wait inside lock l until woken
+ * cv.wake();	// wake one sleeper, wakeAll() wakes every sleeper
+ *
+ * SRWLock srw;
+ * SRWConditionVariable srwcv;
+ * srwcv.sleep(srw);	// caller holds srw exclusively
+ * srwcv.sleepShared(srw);	// caller holds srw shared
  *
  * Required Files:
  * ---------------
- * Locks.h, Locks.cpp
+ * Locks.h, Locks.cpp, LockProfile.h, FutexLocks.h (Linux only)
  * (Thread.h, Thread.cpp are needed to run the test stub)
  *
  * Build Process:
  * --------------
  * cl /EHa /DTEST_THREAD Locks.cpp Thread.cpp
+ * cl /EHa /O2 /DBENCH_LOCKS Locks.cpp         (contention benchmark)
+ * g++ -O2 -std=c++11 -pthread -DBENCH_LOCKS Locks.cpp
  *
  * Maintenance History:
  * --------------------
+ * ver 1.4 : 19 Oct 2026
+ * - optional lock profiling, locks can be named
+ * ver 1.3 : 19 Oct 2026
+ * - futex based lock family for Linux in FutexLocks.h
+ * - added SRWConditionVariable, fixed gSRWLock acquire calls
+ * - added lock contention benchmark
+ * ver 1.2 : 19 Oct 2026
+ * - added CSConditionVariable::sleep with timeout
  * ver 1.1 : 24 Mar 2013
  * - added sout, moved doLog here, uses latest threadBase
  * ver 1.0 : 20 Feb 2012
  * - first release
  */
 
-#include <Windows.h>
 #include <exception>
 #include <iostream>
 
+inline void doLog(const char* pChar);
+
+#include "LockProfile.h"
+
+#ifdef _WIN32
+
+#include <Windows.h>
+
 ///////////////////////////////////////////////////////////////
 // CSLock - local lock class based on Win32 CRITICAL_SECTION
 
@@ -62,17 +96,28 @@ class CSLock
 {
 public:
   CSLock();
+  explicit CSLock(const char* name);
   ~CSLock();
   void lock();
   void unlock();
+  void name(const char* name);  // tag shown by LockProfile::dump
   operator ::CRITICAL_SECTION* ();  // cast operator used with CV
 private:
+  friend class CSConditionVariable;
   ::CRITICAL_SECTION cs;
+  LOCK_PROFILE(LockProbe probe;)
 };
 
 inline CSLock::CSLock()
 {
   ::InitializeCriticalSection(&cs);
+  LOCK_PROFILE(probe.init(0);)
+}
+
+inline CSLock::CSLock(const char* name)
+{
+  ::InitializeCriticalSection(&cs);
+  LOCK_PROFILE(probe.init(name);)
 }
 
 inline CSLock::~CSLock() 
@@ -82,14 +127,28 @@ inline CSLock::~CSLock()
 
 inline void CSLock::lock() 
 { 
+#ifdef LOCK_PROFILING
+  probe.acquire(
+    [&]() { return ::TryEnterCriticalSection(&cs) != 0; },
+    [&]() { ::EnterCriticalSection(&cs); },
+    "CSLock"
+  );
+#else
   ::EnterCriticalSection(&cs);
+#endif
 }
 
 inline void CSLock::unlock()
 {
+  LOCK_PROFILE(probe.release();)
   ::LeaveCriticalSection(&cs);
 }
 
+inline void CSLock::name(const char* name)
+{
+  LOCK_PROFILE(probe.name(name);)
+}
+
 inline CSLock::operator ::CRITICAL_SECTION* () { return &cs; }
 
 ///////////////////////////////////////////////////////////////
@@ -103,10 +162,12 @@ public:
   ~gCSLock();
   void lock();
   void unlock();
+  void name(const char* name);  // tag shown by LockProfile::dump
   operator ::CRITICAL_SECTION* ();  // cast operator used with CV
 private:
   static ::CRITICAL_SECTION cs;
   static unsigned int refCount;
+  LOCK_PROFILE(static LockProbe probe;)
 };
 
 //----< statics are only initialized by first caller >---------
@@ -115,6 +176,10 @@ template<int i>
 ::CRITICAL_SECTION gCSLock<i>::cs;
 template<int i>
 unsigned int gCSLock<i>::refCount = 0;
+#ifdef LOCK_PROFILING
+template<int i>
+LockProbe gCSLock<i>::probe;
+#endif
 
 template<int i>
 gCSLock<i>::gCSLock()
@@ -142,15 +207,30 @@ gCSLock<i>::~gCSLock()
 template<int i>
 void gCSLock<i>::lock() 
 { 
+#ifdef LOCK_PROFILING
+  probe.acquire(
+    [&]() { return ::TryEnterCriticalSection(&cs) != 0; },
+    [&]() { ::EnterCriticalSection(&cs); },
+    "gCSLock"
+  );
+#else
   ::EnterCriticalSection(&cs);
+#endif
 }
 
 template<int i>
 void gCSLock<i>::unlock()
 {
+  LOCK_PROFILE(probe.release();)
   ::LeaveCriticalSection(&cs);
 }
 
+template<int i>
+void gCSLock<i>::name(const char* name)
+{
+  LOCK_PROFILE(probe.name(name);)
+}
+
 template<int i>
 inline gCSLock<i>::operator ::CRITICAL_SECTION* () { return &cs; }
 
@@ -161,14 +241,18 @@ class MLock
 {
 public:
   MLock();
+  explicit MLock(const char* name);
   ~MLock();
   void lock();
   void unlock();
+  void name(const char* name);  // tag shown by LockProfile::dump
 private:
+  void create();
   ::HANDLE hMutex;
+  LOCK_PROFILE(LockProbe probe;)
 };
 
-inline MLock::MLock()
+inline void MLock::create()
 {
   hMutex = CreateMutexA
            (
@@ -180,18 +264,44 @@ inline MLock::MLock()
     throw std::exception("mutex creation failed");
 }
 
+inline MLock::MLock()
+{
+  create();
+  LOCK_PROFILE(probe.init(0);)
+}
+
+inline MLock::MLock(const char* name)
+{
+  create();
+  LOCK_PROFILE(probe.init(name);)
+}
+
 inline MLock::~MLock() { CloseHandle(hMutex); }
 
 inline void MLock::lock() 
 { 
+#ifdef LOCK_PROFILING
+  probe.acquire(
+    [&]() { return ::WaitForSingleObject(hMutex, 0) == WAIT_OBJECT_0; },
+    [&]() { ::WaitForSingleObject(hMutex, INFINITE); },
+    "MLock"
+  );
+#else
   ::WaitForSingleObject(hMutex, INFINITE);
+#endif
 }
 
 inline void MLock::unlock()
 {
+  LOCK_PROFILE(probe.release();)
   ReleaseMutex(hMutex);
 }
 
+inline void MLock::name(const char* name)
+{
+  LOCK_PROFILE(probe.name(name);)
+}
+
 ///////////////////////////////////////////////////////////////
 // gMLock - global lock class based on Win32 Mutex
 
@@ -203,9 +313,11 @@ public:
   ~gMLock();
   void lock();
   void unlock();
+  void name(const char* name);  // tag shown by LockProfile::dump
 private:
   static ::HANDLE hMutex;
   static unsigned int refCount;
+  LOCK_PROFILE(static LockProbe probe;)
 };
 
 //----< statics are only initialized by first caller >---------
@@ -214,6 +326,10 @@ template<int i>
 ::HANDLE gMLock<i>::hMutex;
 template<int i>
 unsigned int gMLock<i>::refCount = 0;
+#ifdef LOCK_PROFILING
+template<int i>
+LockProbe gMLock<i>::probe;
+#endif
 
 template<int i>
 gMLock<i>::gMLock()
@@ -246,15 +362,30 @@ gMLock<i>::~gMLock()
 template<int i>
 void gMLock<i>::lock() 
 { 
+#ifdef LOCK_PROFILING
+  probe.acquire(
+    [&]() { return ::WaitForSingleObject(hMutex, 0) == WAIT_OBJECT_0; },
+    [&]() { ::WaitForSingleObject(hMutex, INFINITE); },
+    "gMLock"
+  );
+#else
   ::WaitForSingleObject(hMutex, INFINITE);
+#endif
 }
 
 template<int i>
 void gMLock<i>::unlock()
 {
+  LOCK_PROFILE(probe.release();)
   ::ReleaseMutex(hMutex);
 }
 
+template<int i>
+void gMLock<i>::name(const char* name)
+{
+  LOCK_PROFILE(probe.name(name);)
+}
+
 ///////////////////////////////////////////////////////////////
 // SRWLock - local lock class based on Win32 SRWLock
 
@@ -262,18 +393,30 @@ class SRWLock
 {
 public:
   SRWLock();
+  explicit SRWLock(const char* name);
   ~SRWLock();
   void lockExclusive();
   void lockShared();
   void unlockExclusive();
   void unlockShared();
+  void name(const char* name);  // tag shown by LockProfile::dump
+  operator ::SRWLOCK* ();  // cast operator used with CV
 private:
+  friend class SRWConditionVariable;
   ::SRWLOCK srw;
+  LOCK_PROFILE(LockProbe probe;)
 };
 
 inline SRWLock::SRWLock()
 {
   ::InitializeSRWLock(&srw);
+  LOCK_PROFILE(probe.init(0);)
+}
+
+inline SRWLock::SRWLock(const char* name)
+{
+  ::InitializeSRWLock(&srw);
+  LOCK_PROFILE(probe.init(name);)
 }
 
 inline SRWLock::~SRWLock() 
@@ -284,16 +427,33 @@ inline SRWLock::~SRWLock()
 
 inline void SRWLock::lockExclusive() 
 { 
+#ifdef LOCK_PROFILING
+  probe.acquire(
+    [&]() { return ::TryAcquireSRWLockExclusive(&srw) != 0; },
+    [&]() { ::AcquireSRWLockExclusive(&srw); },
+    "SRWLock"
+  );
+#else
   ::AcquireSRWLockExclusive(&srw);
+#endif
 }
 
 inline void SRWLock::lockShared()
 {
+#ifdef LOCK_PROFILING
+  probe.acquireShared(
+    [&]() { return ::TryAcquireSRWLockShared(&srw) != 0; },
+    [&]() { ::AcquireSRWLockShared(&srw); },
+    "SRWLock"
+  );
+#else
   ::AcquireSRWLockShared(&srw);
+#endif
 }
 
 inline void SRWLock::unlockExclusive()
 {
+  LOCK_PROFILE(probe.release();)
   ::ReleaseSRWLockExclusive(&srw);
 }
 
@@ -302,6 +462,13 @@ inline void SRWLock::unlockShared()
   ::ReleaseSRWLockShared(&srw);
 }
 
+inline void SRWLock::name(const char* name)
+{
+  LOCK_PROFILE(probe.name(name);)
+}
+
+inline SRWLock::operator ::SRWLOCK* () { return &srw; }
+
 ///////////////////////////////////////////////////////////////
 // gSRWLock - global lock class based on Win32 SRWLock
 
@@ -315,9 +482,11 @@ public:
   void lockShared();
   void unlockExclusive();
   void unlockShared();
+  void name(const char* name);  // tag shown by LockProfile::dump
 private:
   static ::SRWLOCK srw;
   static unsigned int refCount;
+  LOCK_PROFILE(static LockProbe probe;)
 };
 
 //----< statics are only initialized by first caller >---------
@@ -326,6 +495,10 @@ template<int i>
 ::SRWLOCK gSRWLock<i>::srw;
 template<int i>
 unsigned int gSRWLock<i>::refCount = 0;
+#ifdef LOCK_PROFILING
+template<int i>
+LockProbe gSRWLock<i>::probe;
+#endif
 
 template<int i>
 gSRWLock<i>::gSRWLock()
@@ -351,18 +524,35 @@ gSRWLock<i>::~gSRWLock()
 template<int i>
 void gSRWLock<i>::lockExclusive() 
 { 
-  ::AquireSRWLockExclusive(&srw);
+#ifdef LOCK_PROFILING
+  probe.acquire(
+    [&]() { return ::TryAcquireSRWLockExclusive(&srw) != 0; },
+    [&]() { ::AcquireSRWLockExclusive(&srw); },
+    "gSRWLock"
+  );
+#else
+  ::AcquireSRWLockExclusive(&srw);
+#endif
 }
 
 template<int i>
 void gSRWLock<i>::lockShared() 
 { 
-  ::AquireSRWLockShared(&srw);
+#ifdef LOCK_PROFILING
+  probe.acquireShared(
+    [&]() { return ::TryAcquireSRWLockShared(&srw) != 0; },
+    [&]() { ::AcquireSRWLockShared(&srw); },
+    "gSRWLock"
+  );
+#else
+  ::AcquireSRWLockShared(&srw);
+#endif
 }
 
 template<int i>
 void gSRWLock<i>::unlockExclusive()
 {
+  LOCK_PROFILE(probe.release();)
   ::ReleaseSRWLockExclusive(&srw);
 }
 
@@ -372,6 +562,12 @@ void gSRWLock<i>::unlockShared()
   ::ReleaseSRWLockShared(&srw);
 }
 
+template<int i>
+void gSRWLock<i>::name(const char* name)
+{
+  LOCK_PROFILE(probe.name(name);)
+}
+
 ///////////////////////////////////////////////////////////////////////////
 // CSConditionVariable - local ConditionVariable based on CriticalSection
 /*
@@ -396,6 +592,7 @@ public:
   CSConditionVariable();
   ~CSConditionVariable();
   void sleep(CSLock& csl);
+  bool sleep(CSLock& csl, DWORD milliseconds);
   void wake();
   void wakeAll();
 private:
@@ -414,7 +611,17 @@ inline CSConditionVariable::~CSConditionVariable()
 
 inline void CSConditionVariable::sleep(CSLock& lock)
 {
-  ::SleepConditionVariableCS(&cv, (::CRITICAL_SECTION*)lock, INFINITE);
+  sleep(lock, INFINITE);
+}
+
+//----< sleep with timeout, returns false if timed out >------------------
+
+inline bool CSConditionVariable::sleep(CSLock& lock, DWORD milliseconds)
+{
+  LOCK_PROFILE(unsigned int depth = lock.probe.suspend();)
+  BOOL woken = ::SleepConditionVariableCS(&cv, (::CRITICAL_SECTION*)lock, milliseconds);
+  LOCK_PROFILE(lock.probe.resume(depth);)
+  return woken != 0;
 }
 
 inline void CSConditionVariable::wake()
@@ -429,8 +636,79 @@ inline void CSConditionVariable::wakeAll()
 
 ///////////////////////////////////////////////////////////////////////////
 // SRWConditionVariable - local ConditionVariable based on SRWLock
+/*
+ * Works like CSConditionVariable, but with an SRWLock.  Use sleep when
+ * the lock is held exclusively and sleepShared when it is held shared.
+ * The lock is reacquired in the same mode before sleep returns.
+ */
+
+class SRWConditionVariable
+{
+public:
+  SRWConditionVariable();
+  ~SRWConditionVariable();
+  void sleep(SRWLock& srwl);
+  bool sleep(SRWLock& srwl, DWORD milliseconds);
+  void sleepShared(SRWLock& srwl);
+  bool sleepShared(SRWLock& srwl, DWORD milliseconds);
+  void wake();
+  void wakeAll();
+private:
+  ::CONDITION_VARIABLE cv;
+};
 
-// todo: define SRWConditionVariable
+inline SRWConditionVariable::SRWConditionVariable()
+{
+  ::InitializeConditionVariable(&cv);
+}
+
+inline SRWConditionVariable::~SRWConditionVariable()
+{
+  // nothing to do for ConditionVariable
+}
+
+inline void SRWConditionVariable::sleep(SRWLock& lock)
+{
+  sleep(lock, INFINITE);
+}
+
+//----< sleep with timeout, returns false if timed out >------------------
+
+inline bool SRWConditionVariable::sleep(SRWLock& lock, DWORD milliseconds)
+{
+  LOCK_PROFILE(unsigned int depth = lock.probe.suspend();)
+  BOOL woken = ::SleepConditionVariableSRW(&cv, (::SRWLOCK*)lock, milliseconds, 0);
+  LOCK_PROFILE(lock.probe.resume(depth);)
+  return woken != 0;
+}
+
+inline void SRWConditionVariable::sleepShared(SRWLock& lock)
+{
+  sleepShared(lock, INFINITE);
+}
+
+inline bool SRWConditionVariable::sleepShared(SRWLock& lock, DWORD milliseconds)
+{
+  return ::SleepConditionVariableSRW(
+    &cv, (::SRWLOCK*)lock, milliseconds, CONDITION_VARIABLE_LOCKMODE_SHARED
+  ) != 0;
+}
+
+inline void SRWConditionVariable::wake()
+{
+  ::WakeConditionVariable(&cv);
+}
+
+inline void SRWConditionVariable::wakeAll()
+{
+  ::WakeAllConditionVariable(&cv);
+}
+
+#else
+
+#include "FutexLocks.h"
+
+#endif
 
 /////////////////////////////////////////////////////////////////////
 // syncOut class
@@ -452,7 +730,7 @@ private:
 };
 //----< constructor >------------------------------------------------
 
-inline syncOut::syncOut(std::ostream& out) : _out(out) {}
+inline syncOut::syncOut(std::ostream& out) : _out(out) { _l.name("syncOut"); }
 
 //----< insertion >--------------------------------------------------
 
@@ -510,6 +788,8 @@ inline void doLog(const char* pChar)
 {
 #ifdef DOLOG
   sout << locker << "\n  " << pChar << unlocker;
+#else
+  (void)pChar;
 #endif
 }
 
@@ -1,6 +1,6 @@
 ///////////////////////////////////////////////////////////////
 // Threads.cpp - Create and run threads                      //
-// ver 1.1                                                   //
+// ver 1.2                                                   //
 // Language: standard C++                                    //
 // Platform: Dell Dimension T7400, Windows 7, SP #1          //
 // Application: Resource for DO projects                     //
@@ -10,6 +10,8 @@
 
 #include <iostream>
 #include <string>
+#include <chrono>
+#include <thread>
 #include "Threads.h"
 
 //----< test stub >--------------------------------------------
@@ -42,7 +44,7 @@ void ThreadDemo::run()
     tLock.lock();
     Msg += '0';
     tLock.unlock();
-    ::Sleep(2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
   }
   sout << "\n  child exiting";
 }
@@ -70,7 +72,7 @@ void TThreadDemo::run()
     tLock.lock();
     Msg += '0';
     tLock.unlock();
-    ::Sleep(2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
   }
   sout << "\n  child exiting";
 }
@@ -85,6 +87,9 @@ int main()
 
   {
     ThreadDemo td(Shared);
+    td.name() = "ThreadDemo";      // visible in debugger, perf and top
+    td.stackSize() = 64*1024;
+    td.affinity().push_back(0);    // pin to first CPU
     td.start();
     gCSLock<1> pLock;
     for(size_t i=0; i<25; ++i)
@@ -92,7 +97,7 @@ int main()
       pLock.lock();
       Shared += '1';
       pLock.unlock();
-      ::Sleep(1);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
     td.join();
   }
@@ -109,7 +114,7 @@ int main()
       pLock.lock();
       Shared += '1';
       pLock.unlock();
-      ::Sleep(1);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
     pTD->join();
     // note: don't call pTD->delete();
@@ -2,7 +2,7 @@
 #define THREADS_H
 ///////////////////////////////////////////////////////////////
 // Threads.h - Create and run threads                        //
-// ver 1.1                                                   //
+// ver 1.2                                                   //
 // Language: standard C++                                    //
 // Platform: Dell Dimension T7400, Windows 7, SP #1          //
 // Application: Resource for DO projects                     //
@@ -16,13 +16,22 @@
  * and a demonstraton derived class ThreadDemo.  If a the child thread
  * fails to start, a std::exception object will be thrown, which client
  * code should be prepared to catch.
+ *
+ * ThreadBase runs on Win32 threads or POSIX threads.  Before start()
+ * a thread can be given a name, shown by debuggers, perf and top, a
+ * stack size, and a set of CPUs to pin it to, e.g., to keep network
+ * threads apart from task workers.  std::thread is not used as it has
+ * no way to choose the stack size.
  */
 /*
  * Public Interface:
  * =================
  * ThreadBase* th = new someThreadClass;
- * th.start();	// start thread
- * th.join();	// join thread
+ * th->name() = "sender";	// optional, set before start
+ * th->stackSize() = 256*1024;	// optional, bytes
+ * th->affinity().push_back(2);	// optional, pin to CPU 2
+ * th->start();	// start thread
+ * th->join();	// join thread
  *
  * Required Files:
  * ---------------
@@ -34,15 +43,30 @@
  *
  * Maintenance History:
  * --------------------
+ * ver 1.2 : 19 Oct 2026
+ * - thread is created by start() instead of the constructor
+ * - runs on POSIX threads as well as Win32 threads
+ * - added name, stackSize and affinity
+ * - new thread waits until start() has recorded it, so a self
+ *   terminating thread cannot delete itself first
  * ver 1.1 : 24 Mar 13
  * - removed locks code, now using locks package
  * ver 1.0 : 19 Feb 12
  * - first release
  */
 
+#ifdef _WIN32
 #include <Windows.h>
 #include <process.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <limits.h>
+#include <stdexcept>
+#endif
 #include <exception>
+#include <string>
+#include <vector>
 #include "Locks.h"
 
 struct DefaultTerminate
@@ -81,56 +105,180 @@ public:
   virtual ~ThreadBase();
   void start();
   void join();
+  std::string& name();
+  size_t& stackSize();
+  std::vector<size_t>& affinity();
 protected:
+#ifdef _WIN32
   ::HANDLE hThread;
   unsigned int _threadID;
+#else
+  pthread_t hThread;
+#endif
 private:
   virtual void run()=0;
+  void configure();
+#ifdef _WIN32
   static unsigned int __stdcall threadOps(void* pArg);
+#else
+  static void* threadOps(void* pArg);
+#endif
+  std::string _name;          // shown by debuggers, perf and top
+  size_t _stackSize;          // bytes, zero for platform default
+  std::vector<size_t> _cpus;  // CPUs thread may run on, empty for any
+  bool _started;
+  bool _joined;
+#ifndef _WIN32
+  pthread_mutex_t _gate;      // held by start() until hThread and _started are set
+#endif
 };
 
 typedef ThreadBase<DefaultTerminate> threadBase;
 typedef ThreadBase<SelfTerminate> tthreadBase;
 
+//----< ThreadBase constructor >-------------------------------
+/*
+ * the OS thread is created by start(), so name, stack size
+ * and affinity can be set first
+ */
+template <typename TerminatePolicy>
+ThreadBase<TerminatePolicy>::ThreadBase()
+  : hThread(), _stackSize(0), _started(false), _joined(false)
+{
+  doLog("constructing ThreadBase");
+#ifndef _WIN32
+  pthread_mutex_init(&_gate, NULL);
+#endif
+}
+//----< destructor releases OS thread >------------------------
+
 template <typename TerminatePolicy>
 inline ThreadBase<TerminatePolicy>::~ThreadBase() 
 {
   doLog("destroying ThreadBase");
+  if(!_started)
+    return;
+#ifdef _WIN32
   CloseHandle(hThread); 
+#else
+  if(!_joined)
+    pthread_detach(hThread);
+  pthread_mutex_destroy(&_gate);
+#endif
 }
+//----< thread name, set before start >------------------------
 
-//----< ThreadBase constructor >-------------------------------
+template <typename TerminatePolicy>
+std::string& ThreadBase<TerminatePolicy>::name() { return _name; }
+
+//----< stack size in bytes, set before start >----------------
 
 template <typename TerminatePolicy>
-ThreadBase<TerminatePolicy>::ThreadBase()
+size_t& ThreadBase<TerminatePolicy>::stackSize() { return _stackSize; }
+
+//----< CPUs to pin thread to, set before start >--------------
+
+template <typename TerminatePolicy>
+std::vector<size_t>& ThreadBase<TerminatePolicy>::affinity() { return _cpus; }
+
+//----< create thread and start it running >-------------------
+/*
+ * a self-terminating thread may delete itself as soon as it runs,
+ * so hThread and _started are written before it is let go, and
+ * nothing is touched after
+ */
+template <typename TerminatePolicy>
+void ThreadBase<TerminatePolicy>::start()
 {
-  doLog("constructing ThreadBase");
+  doLog("starting child thread");
+#ifdef _WIN32
+  const unsigned int STACK_IS_RESERVATION = 0x00010000;  // STACK_SIZE_PARAM_IS_A_RESERVATION
   hThread = (HANDLE)_beginthreadex
             (
-              NULL,             // default security properties
-              0,                // default stack size
-              threadOps,        // function that thread runs
-              (void*)this,      // static function can access thread members
-              CREATE_SUSPENDED, // start thread suspended, call start() to run
-              &_threadID        // OS thread identifier
-              );
+              NULL,                         // default security properties
+              (unsigned)_stackSize,         // zero for default stack size
+              threadOps,                    // function that thread runs
+              (void*)this,                  // static function can access thread members
+              CREATE_SUSPENDED | (_stackSize ? STACK_IS_RESERVATION : 0),
+              &_threadID                    // OS thread identifier
+            );
   if(hThread == 0)
     throw std::exception("\n  failed to create thread");
+  _started = true;
+  ::ResumeThread(hThread);
+#else
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  if(_stackSize > 0)
+    pthread_attr_setstacksize(&attr, _stackSize < (size_t)PTHREAD_STACK_MIN ? (size_t)PTHREAD_STACK_MIN : _stackSize);
+  pthread_mutex_lock(&_gate);
+  int err = pthread_create(&hThread, &attr, threadOps, (void*)this);
+  pthread_attr_destroy(&attr);
+  if(err != 0)
+  {
+    pthread_mutex_unlock(&_gate);
+    throw std::runtime_error("\n  failed to create thread");
+  }
+  _started = true;
+  pthread_mutex_unlock(&_gate);  // new thread waits for this
+#endif
 }
-//----< start thread running >---------------------------------
+//----< apply name and affinity, runs on the new thread >------
 
 template <typename TerminatePolicy>
-void ThreadBase<TerminatePolicy>::start()
+void ThreadBase<TerminatePolicy>::configure()
 {
-  doLog("starting child thread");
-  ResumeThread(hThread);
+#ifdef _WIN32
+  if(_cpus.size() > 0)
+  {
+    // a thread runs in one processor group of up to 64 CPUs,
+    // the group of the first listed CPU is used
+    ::GROUP_AFFINITY ga = {};
+    ga.Group = (WORD)(_cpus[0] / 64);
+    for(size_t i=0; i<_cpus.size(); ++i)
+      if(_cpus[i] / 64 == ga.Group)
+        ga.Mask |= (ULONG_PTR)1 << (_cpus[i] % 64);
+    if(!::SetThreadGroupAffinity(::GetCurrentThread(), &ga, NULL))
+      doLog("failed to set thread affinity");
+  }
+  if(_name.size() > 0)
+  {
+    // SetThreadDescription is only present from Windows 10 1607
+    typedef HRESULT (WINAPI *SetDescription)(HANDLE, PCWSTR);
+    SetDescription setDescription = (SetDescription)::GetProcAddress(
+      ::GetModuleHandleA("kernel32.dll"), "SetThreadDescription");
+    if(setDescription)
+      setDescription(::GetCurrentThread(), std::wstring(_name.begin(), _name.end()).c_str());
+  }
+#else
+  if(_cpus.size() > 0)
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(size_t i=0; i<_cpus.size(); ++i)
+      CPU_SET(_cpus[i], &set);
+    if(pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+      doLog("failed to set thread affinity");
+  }
+  if(_name.size() > 0)
+    pthread_setname_np(pthread_self(), _name.substr(0, 15).c_str());  // kernel limit
+#endif
 }
 //----< this is where the derived processing gets to run >-----
 
 template <typename TerminatePolicy>
+#ifdef _WIN32
 unsigned int ThreadBase<TerminatePolicy>::threadOps(void* pThis)
+#else
+void* ThreadBase<TerminatePolicy>::threadOps(void* pThis)
+#endif
 {
   doLog("in threadOps");
+#ifndef _WIN32
+  pthread_mutex_lock(&((ThreadBase<TerminatePolicy>*)pThis)->_gate);  // wait for start()
+  pthread_mutex_unlock(&((ThreadBase<TerminatePolicy>*)pThis)->_gate);
+#endif
+  ((ThreadBase<TerminatePolicy>*)pThis)->configure();
   ((ThreadBase<TerminatePolicy>*)pThis)->run();
   if(((ThreadBase<TerminatePolicy>*)pThis)->selfTerminate())
     delete static_cast<TerminatePolicy*>(pThis);
@@ -141,8 +289,15 @@ unsigned int ThreadBase<TerminatePolicy>::threadOps(void* pThis)
 template <typename TerminatePolicy>
 void ThreadBase<TerminatePolicy>::join()
 {
+  if(!_started || _joined)
+    return;
   doLog("waiting for thread exit");
+#ifdef _WIN32
   ::WaitForSingleObject(hThread,INFINITE);
+#else
+  pthread_join(hThread, NULL);
+#endif
+  _joined = true;
   doLog("wait over - thread exited");
 }
 
@@ -0,0 +1,344 @@
+///////////////////////////////////////////////////////////////
+// Trace.cpp - Per-stage timestamps of traced messages       //
+// ver 1.0                                                   //
+// Language: standard C++                                    //
+// Platform: Dell Dimension T7400, Windows 7, SP #1          //
+// Application: Resource for DO projects                     //
+///////////////////////////////////////////////////////////////
+
+#include "Trace.h"
+#include "../HiResTimer/HiResTimer.h"
+#include "../Threads/Locks.h"
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+
+namespace
+{
+  const size_t RecordSize = 17;
+  const size_t FlushSize = 64 * 1024;  // bytes buffered before a write
+  const char Magic[] = "COMMTRC1";
+
+  //----< wall clock in nanoseconds since 1970 >-----------------
+
+  long long wallClock()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+  }
+
+  const long long epochTime = wallClock();           // wall clock and timer
+  const __int64 epochTicks = HRTimer::HiResTimer::Now();  // read together
+  // high half of every id, differs between processes started apart
+  const unsigned long long idBase = (((unsigned long long)epochTime * 0x9E3779B97F4A7C15ULL) >> 32) | 1;
+
+  std::atomic<bool> recording;          // static storage, false until open()
+  std::atomic<unsigned int> nextId;
+  CSLock traceLock("Trace");
+  std::ofstream traceFile;
+  std::string buffer;                   // records not yet written
+
+  //----< write buffered records, traceLock held >---------------
+
+  void flush()
+  {
+    if(!buffer.empty() && traceFile.is_open())
+      traceFile.write(buffer.data(), buffer.size());
+    buffer.clear();
+  }
+  //----< append an integer, little endian >---------------------
+
+  void put(std::string& s, unsigned long long v, size_t bytes)
+  {
+    for(size_t i=0; i<bytes; ++i, v >>= 8)
+      s.push_back((char)(v & 0xff));
+  }
+
+  unsigned long long get(const unsigned char* p, size_t bytes)
+  {
+    unsigned long long v = 0;
+    for(size_t i=bytes; i>0; --i)
+      v = (v << 8) | p[i - 1];
+    return v;
+  }
+}
+//----< start recording to a new file >------------------------
+
+bool Trace::open(const std::string& path)
+{
+  close();
+  traceLock.lock();
+  traceFile.clear();
+  traceFile.open(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  bool ok = traceFile.good();
+  if(ok)
+  {
+    traceFile.write(Magic, sizeof(Magic) - 1);
+    buffer.reserve(FlushSize + RecordSize);
+  }
+  recording.store(ok);
+  traceLock.unlock();
+  return ok;
+}
+//----< stop recording, writing what is buffered >-------------
+
+void Trace::close()
+{
+  recording.store(false);
+  traceLock.lock();
+  flush();
+  if(traceFile.is_open())
+    traceFile.close();
+  traceLock.unlock();
+}
+
+bool Trace::isOpen()
+{
+  return recording.load(std::memory_order_relaxed);
+}
+//----< new trace id, unique with high probability >-----------
+
+unsigned long long Trace::newId()
+{
+  return (idBase << 32) | (unsigned long long)(nextId.fetch_add(1, std::memory_order_relaxed) + 1);
+}
+//----< nanoseconds since 1970, at timer resolution >----------
+
+long long Trace::now()
+{
+  return epochTime + HRTimer::HiResTimer::ToNanoseconds(HRTimer::HiResTimer::Now() - epochTicks);
+}
+//----< stamp the time a traced message reached a stage >------
+
+void Trace::record(unsigned long long id, Stage stage)
+{
+  if(id == 0 || !recording.load(std::memory_order_relaxed))
+    return;
+  long long time = now();
+  traceLock.lock();
+  if(traceFile.is_open())
+  {
+    put(buffer, id, 8);
+    put(buffer, (unsigned long long)time, 8);
+    put(buffer, (unsigned long long)stage, 1);
+    if(buffer.size() >= FlushSize)
+      flush();
+  }
+  traceLock.unlock();
+}
+//----< name of a stage >--------------------------------------
+
+const char* Trace::stageName(int stage)
+{
+  static const char* names[] = {
+    "?", "queued", "dequeued", "connected", "sending",
+    "received", "reassembled", "delivered", "handled"
+  };
+  return stage > 0 && stage < STAGES ? names[stage] : names[0];
+}
+//----< append the records of a trace file >-------------------
+/*
+ * A record cut short, as when the writer did not close the file,
+ * ends the file.
+ */
+bool Trace::read(const std::string& path, std::vector<Record>& records)
+{
+  std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+  char magic[sizeof(Magic) - 1];
+  if(!in.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), Magic))
+    return false;
+  unsigned char raw[RecordSize];
+  while(in.read((char*)raw, RecordSize))
+  {
+    Record r;
+    r.id = get(raw, 8);
+    r.time = (long long)get(raw + 8, 8);
+    r.stage = raw[16];
+    records.push_back(r);
+  }
+  return true;
+}
+
+namespace
+{
+  // what the time from the stage before a stage was spent on
+  const char* intervalName(int stage)
+  {
+    static const char* names[] = {
+      "", "", "send queue", "connect", "batch wait",
+      "wire", "reassembly", "receive queue", "callback"
+    };
+    return names[stage];
+  }
+
+  bool byIdThenTime(const Trace::Record& a, const Trace::Record& b)
+  {
+    return a.id < b.id || (a.id == b.id && a.time < b.time);
+  }
+
+  //----< value at fraction of sorted values >-----------------
+
+  long long at(const std::vector<long long>& sorted, double fraction)
+  {
+    size_t i = (size_t)(fraction * sorted.size());
+    return sorted[i < sorted.size() ? i : sorted.size() - 1];
+  }
+
+  void micros(std::ostream& out, long long ns, int width)
+  {
+    out << std::setw(width) << std::fixed << std::setprecision(1) << ns / 1000.0;
+  }
+}
+//----< per-stage latency breakdown of all traces >------------
+/*
+ * Sorts records.  With each set, prints one line per trace as well,
+ * microseconds from the stage before, "-" where a stage is missing.
+ */
+void Trace::report(std::vector<Record>& records, std::ostream& out, bool each)
+{
+  std::sort(records.begin(), records.end(), byIdThenTime);
+  std::vector<std::vector<long long> > spans(STAGES + 1);  // last one is the total
+  if(each)
+  {
+    out << "\n  " << std::left << std::setw(18) << "trace id" << std::right;
+    for(int s=QUEUED+1; s<STAGES; ++s)
+      out << std::setw(14) << intervalName(s);
+    out << std::setw(14) << "total";
+  }
+  size_t traces = 0;
+  for(size_t i=0; i<records.size(); )
+  {
+    long long stamp[STAGES];
+    bool has[STAGES] = { false };
+    size_t j = i;
+    for(; j<records.size() && records[j].id == records[i].id; ++j)
+    {
+      if(records[j].stage > 0 && records[j].stage < STAGES)
+      {
+        stamp[records[j].stage] = records[j].time;  // sorted by time, so the last counts
+        has[records[j].stage] = true;
+      }
+    }
+    ++traces;
+    long long span[STAGES];
+    bool hasSpan[STAGES] = { false };
+    int first = 0, prev = 0;
+    for(int s=QUEUED; s<STAGES; ++s)
+    {
+      if(!has[s])
+        continue;
+      if(prev)
+      {
+        span[s] = stamp[s] - stamp[prev];
+        hasSpan[s] = true;
+        spans[s].push_back(span[s]);
+      }
+      else
+        first = s;
+      prev = s;
+    }
+    bool whole = first && prev != first;
+    if(whole)
+      spans[STAGES].push_back(stamp[prev] - stamp[first]);
+    if(each)
+    {
+      out << "\n  " << std::hex << std::setw(16) << std::setfill('0') << records[i].id
+          << std::dec << std::setfill(' ') << "  ";
+      for(int s=QUEUED+1; s<STAGES; ++s)
+      {
+        if(hasSpan[s])
+          micros(out, span[s], 14);
+        else
+          out << std::setw(14) << "-";
+      }
+      if(whole)
+        micros(out, stamp[prev] - stamp[first], 14);
+      else
+        out << std::setw(14) << "-";
+    }
+    i = j;
+  }
+
+  out << "\n\n  " << traces << " trace(s), microseconds from the stage before\n";
+  out << "\n  " << std::left << std::setw(14) << "stage" << std::setw(16) << "time in"
+      << std::right << std::setw(10) << "count" << std::setw(12) << "mean"
+      << std::setw(12) << "p50" << std::setw(12) << "p99" << std::setw(12) << "max";
+  for(int s=QUEUED+1; s<=STAGES; ++s)
+  {
+    std::vector<long long>& v = spans[s];
+    out << "\n  " << std::left << std::setw(14) << (s < STAGES ? stageName(s) : "total")
+        << std::setw(16) << (s < STAGES ? intervalName(s) : "first to last") << std::right
+        << std::setw(10) << v.size();
+    if(v.empty())
+    {
+      out << std::setw(12) << "-" << std::setw(12) << "-" << std::setw(12) << "-" << std::setw(12) << "-";
+      continue;
+    }
+    std::sort(v.begin(), v.end());
+    long long sum = 0;
+    for(size_t k=0; k<v.size(); ++k)
+      sum += v[k];
+    micros(out, sum / (long long)v.size(), 12);
+    micros(out, at(v, 0.50), 12);
+    micros(out, at(v, 0.99), 12);
+    micros(out, v.back(), 12);
+  }
+  out << "\n";
+}
+
+#ifdef TEST_TRACE
+
+#include <cstdio>
+
+//----< spin for about ns nanoseconds >------------------------
+
+void spin(long long ns)
+{
+  long long end = Trace::now() + ns;
+  while(Trace::now() < end)
+    ;
+}
+
+//----< test stub >--------------------------------------------
+
+int main()
+{
+  std::cout << "\n  Demonstrating Trace";
+  std::cout << "\n =====================\n";
+
+  const char* path = "test.trace";
+  if(!Trace::open(path))
+  {
+    std::cout << "\n  can't open " << path << "\n\n";
+    return 1;
+  }
+  Trace::record(0, Trace::QUEUED);  // untraced, dropped
+  for(size_t i=0; i<100; ++i)
+  {
+    unsigned long long id = Trace::newId();
+    for(int s=Trace::QUEUED; s<Trace::STAGES; ++s)
+    {
+      if(s == Trace::CONNECTED && i % 10 == 0)
+        continue;                   // a stage left out
+      Trace::record(id, (Trace::Stage)s);
+      spin(s == Trace::RECEIVED ? 20000 : 2000);  // reassembly takes longer
+    }
+  }
+  Trace::close();
+
+  std::vector<Trace::Record> records;
+  if(!Trace::read(path, records))
+  {
+    std::cout << "\n  " << path << " is not a trace file\n\n";
+    return 1;
+  }
+  std::cout << "\n  read " << records.size() << " records, expected " << 100 * (Trace::STAGES - 1) - 10;
+  Trace::report(records, std::cout, false);
+  std::cout << "\n  reassembly should take about 20 us, other stages 2 us\n\n";
+  std::remove(path);
+  return 0;
+}
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef TRACE_H
+#define TRACE_H
+///////////////////////////////////////////////////////////////
+// Trace.h - Per-stage timestamps of traced messages         //
+// ver 1.0                                                   //
+// Language: standard C++                                    //
+// Platform: Dell Dimension T7400, Windows 7, SP #1          //
+// Application: Resource for DO projects                     //
+///////////////////////////////////////////////////////////////
+/*
+ * Package Operations:
+ * ===================
+ * Trace records when a message reaches each stage of its trip from
+ * one program to another, and reports how long it spent between
+ * stages.  A message is traced when it carries a nonzero trace id.
+ *
+ * record() appends a 17 byte record, trace id, time and stage, to a
+ * buffer that is written to the trace file opened by open() when it
+ * fills and on close().  Records made while no file is open are
+ * dropped after one atomic load, so untraced runs pay nothing else.
+ *
+ * Times are nanoseconds since 1 Jan 1970: the wall clock when the
+ * package started, plus the high resolution timer since then.  So
+ * files written on one host compare to tens of nanoseconds, and files
+ * from two hosts only as well as their clocks agree.
+ *
+ * report() merges the records of any number of files by trace id and
+ * prints, for every stage, how long messages took to reach it from
+ * the stage before: count, mean, 50th, 99th percentile and largest.
+ * A stage without a record in a trace is left out of that trace's
+ * breakdown; when a stage is recorded more than once, as for a
+ * resent message, the last record counts.
+ *
+ * File format: the 8 bytes "COMMTRC1", then records of an 8 byte id,
+ * an 8 byte time and a 1 byte stage, integers little endian.
+ */
+/*
+ * Public Interface:
+ * =================
+ * Trace::open("sender.trace");                 // start recording
+ * unsigned long long id = Trace::newId();      // unique, never 0
+ * Trace::record(id, Trace::QUEUED);            // stamp a stage
+ * Trace::close();                              // write what is buffered
+ * std::vector<Trace::Record> r;
+ * bool ok = Trace::read("sender.trace", r);    // append a file's records
+ * Trace::report(r, std::cout, false);          // per-stage breakdown
+ *
+ * Required Files:
+ * ---------------
+ * Trace.h, Trace.cpp, HiResTimer.h, Locks.h, Locks.cpp
+ *
+ * Build Process:
+ * --------------
+ * cl /EHa /DTEST_TRACE Trace.cpp ../Threads/Locks.cpp
+ *
+ * Maintenance History:
+ * --------------------
+ * ver 1.0 : 19 Oct 2026
+ * - first release
+ */
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+class Trace
+{
+public:
+  // in the order a message passes them
+  enum Stage
+  {
+    QUEUED = 1,      // sender: handed to send(), enters the send queue
+    DEQUEUED,        // sender: taken from the send queue by the send thread
+    CONNECTED,       // sender: its connection is open
+    SENDING,         // sender: its first block is being written
+    RECEIVED,        // receiver: its first block header has been read
+    REASSEMBLED,     // receiver: last block in, enters the receive queue
+    DELIVERED,       // receiver: taken from the receive queue, callback called
+    HANDLED,         // receiver: callback returned
+    STAGES
+  };
+  struct Record
+  {
+    unsigned long long id;
+    long long time;            // nanoseconds since 1970
+    unsigned char stage;
+  };
+  static bool open(const std::string& path);
+  static void close();
+  static bool isOpen();
+  static unsigned long long newId();
+  static void record(unsigned long long id, Stage stage);
+  static long long now();
+  static const char* stageName(int stage);
+  static bool read(const std::string& path, std::vector<Record>& records);
+  static void report(std::vector<Record>& records, std::ostream& out, bool each);
+};
+
+#endif
@@ -0,0 +1,72 @@
+/////////////////////////////////////////////////////////////////////
+// TraceReport.cpp - Per-stage latency of traced messages          //
+// ver 1.0                                                         //
+// Language:      Visual C++, 2011                                 //
+// Platform:      Studio 1558, Windows 7 Pro SP1                   //
+// Application:   CIS 687 / Project 3, Sp13                        //
+/////////////////////////////////////////////////////////////////////
+/*
+
+Module Operations:
+==================
+TraceReport reads the trace files written by Trace::open() in channels
+with enableTrace() set, and prints how long traced messages spent
+between stages: in the send queue, connecting, waiting behind earlier
+messages of a batch, on the wire, in reassembly, in the receive queue and
+in the listen callback.
+
+Give it the sender's and the receiver's files together, records of a
+message are matched by trace id across them.  Times from two hosts are
+only as close as the hosts' clocks, so wire time between hosts can be off
+or negative, while stages on one host are exact.
+
+Usage:
+======
+TraceReport [--each] file...
+
+--each prints one line per message before the summary.
+
+Build Process:
+==============
+Required Files:
+Trace.h, Trace.cpp, HiResTimer.h, Locks.h, Locks.cpp
+
+Maintenance History:
+====================
+- Oct 19, 2026 : initial version
+
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../Trace/Trace.h"
+
+int main(int argc, char* argv[]) {
+	bool each = false;
+	std::vector<std::string> files;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--each")
+			each = true;
+		else
+			files.push_back(arg);
+	}
+	if (files.empty()) {
+		std::cout << "\n  usage: TraceReport [--each] file...\n\n";
+		return 1;
+	}
+	std::vector<Trace::Record> records;
+	for (auto it = files.begin(); it != files.end(); it++) {
+		size_t before = records.size();
+		if (!Trace::read(*it, records)) {
+			std::cout << "\n  " << *it << " is not a trace file\n\n";
+			return 1;
+		}
+		std::cout << "\n  " << *it << ": " << records.size() - before << " records";
+	}
+	std::cout << "\n";
+	Trace::report(records, std::cout, each);
+	std::cout << "\n";
+	return 0;
+}